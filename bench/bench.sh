@@ -0,0 +1,167 @@
+#!/bin/sh
+#
+# bench.sh - used to compare transports of all tasks. Starts every
+# server, drives it with the same closed-loop workload (client -n) at
+# every message size and concurrency level, and writes results as one
+# CSV table. Long messages are echoed by task3 with plain sends, splice
+# relay and zerocopy sends. UDP is also driven with window of datagrams
+# in flight, and in reliable mode under injected loss, where stop-and-wait
+# is compared against window. Every row reports CPU time server spent per
+# GiB of replies.
+# Throughput of every row is then checked against stored baseline.
+#
+# Environment:
+#   BENCH_MESSAGES    - messages sent by every connection (5000)
+#   BENCH_REPEAT      - runs of every workload, best one is kept (3)
+#   BENCH_SIZES       - message sizes in bytes ("16 64 127")
+#   BENCH_CONNECTIONS - concurrency levels ("1 4 16")
+#   BENCH_REACTORS    - task3 reactor counts ("1 2 4 8")
+#   BENCH_BULK_SIZES  - sizes of long messages ("65536 1048576")
+#   BENCH_BULK_CONNECTIONS - concurrency levels of long messages ("1 4")
+#   BENCH_BULK_MESSAGES    - long messages sent by every connection (200)
+#   BENCH_RESULTS     - results table (bench/results.csv)
+#   BENCH_BASELINE    - baseline table, empty to skip check (bench/baseline.csv)
+#   BENCH_TOLERANCE   - allowed throughput drop against baseline (0.3)
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+MESSAGES=${BENCH_MESSAGES:-5000}
+REPEAT=${BENCH_REPEAT:-3}
+SIZES=${BENCH_SIZES:-"16 64 127"}
+CONNECTIONS=${BENCH_CONNECTIONS:-"1 4 16"}
+REACTORS=${BENCH_REACTORS:-"1 2 4 8"}
+BULK_SIZES=${BENCH_BULK_SIZES:-"65536 1048576"}
+BULK_CONNECTIONS=${BENCH_BULK_CONNECTIONS:-"1 4"}
+BULK_MESSAGES=${BENCH_BULK_MESSAGES:-200}
+RESULTS=${BENCH_RESULTS:-$ROOT/bench/results.csv}
+BASELINE=${BENCH_BASELINE-$ROOT/bench/baseline.csv}
+TOLERANCE=${BENCH_TOLERANCE:-0.3}
+
+# Sizes are limited by datagram servers (BUFFER_SIZE - 1), so all
+# transports run the same workloads
+HEADER="transport,server,connections,messages,min_size,max_size,window,sent,received,errors,seconds,msg_per_s,mb_per_s,p50_us,p99_us,p999_us,max_us,cpu_s_per_gib"
+TICKS=$(getconf CLK_TCK)
+
+# server_cpu - used to print CPU time (clock ticks) server and its
+# worker processes used so far.
+# $1 - pid of server
+server_cpu() {
+  for process in $1 $(pgrep -P "$1"); do
+    cut -d' ' -f14,15 "/proc/$process/stat" 2> /dev/null
+  done | awk '{ ticks += $1 + $2 } END { print ticks + 0 }'
+}
+
+# run_transport - used to start server of task with given options,
+# run all workloads against it and append rows to results.
+# $1 - task directory
+# $2 - transport name
+# $3 - server options
+# $4 - max connections server accepts
+# $5 - extra client options (optional)
+run_transport() {
+  dir=$1
+  transport=$2
+  options=$3
+  max_connections=$4
+  client_options=$5
+
+  cd "$ROOT/$dir" || exit 1
+  rm -f sock server_sock admin_sock admin_sock.*
+
+  ./bin/server $options > /dev/null 2>&1 &
+  pid=$!
+  sleep 0.5
+
+  for connections in $CONNECTIONS; do
+    # Thread per client server refuses connections above its limit
+    if [ "$connections" -gt "$max_connections" ]; then
+      continue
+    fi
+
+    for size in $SIZES; do
+      # Keep run with best throughput to filter out scheduling noise
+      best=
+      run=0
+      while [ "$run" -lt "$REPEAT" ]; do
+        cpu=$(server_cpu "$pid")
+        row=$(./bin/client -c -n "$connections" -m "$MESSAGES" -s "$size" $client_options)
+        row=$(echo "$row" | awk -F, -v ticks=$(($(server_cpu "$pid") - cpu)) -v hz="$TICKS" \
+          'NF { gib = $11 * $9 * 1e6 / 1073741824; printf "%s,%.2f\n", $0, (gib > 0 ? ticks / hz / gib : 0) }')
+        best=$(printf '%s\n%s\n' "$best" "$row" | awk -F, 'NF && $10 + 0 >= max { max = $10 + 0; best = $0 } END { print best }')
+        run=$((run + 1))
+      done
+      echo "$transport,$options,$best" | tee -a "$RESULTS"
+    done
+  done
+
+  kill "$pid"
+  wait "$pid" 2> /dev/null
+  rm -f sock server_sock client_sock.* admin_sock admin_sock.*
+
+  # Let the kernel release address of the server
+  sleep 1
+}
+
+echo "$HEADER" > "$RESULTS"
+echo "$HEADER"
+
+run_transport task1 local-stream "-b threads" 5
+run_transport task1 local-stream "-b uring" 1000000
+run_transport task1 local-shm "-b threads" 5 "-t shm"
+run_transport task2 local-dgram "" 1000000
+for reactors in $REACTORS; do
+  run_transport task3 inet-tcp "-b epoll -r $reactors" 1000000
+done
+run_transport task3 inet-tcp "-b uring" 1000000
+run_transport task3 inet-tcp "-b epoll -w 2" 1000000
+run_transport task4 inet-udp "" 1000000
+run_transport task4 inet-udp "" 1000000 "-w 16"
+
+# Reliable UDP loses 2% of datagrams sent by either side, goodput of
+# stop-and-wait is compared with window of 32 datagrams
+run_transport task4 inet-rudp "-r -l 2" 1000000 "-r -l 2 -w 1"
+run_transport task4 inet-rudp "-r -l 2" 1000000 "-r -l 2 -w 32"
+
+# Long messages are echoed by TCP only, payload is copied through
+# user space, relayed by splice or sent by MSG_ZEROCOPY (loopback
+# copies zerocopy sends anyway, server falls back to plain sends)
+SIZES=$BULK_SIZES
+CONNECTIONS=$BULK_CONNECTIONS
+MESSAGES=$BULK_MESSAGES
+run_transport task3 inet-tcp-bulk "-b epoll" 1000000
+run_transport task3 inet-tcp-bulk "-b epoll -s" 1000000
+run_transport task3 inet-tcp-bulk "-b epoll -z" 1000000
+
+echo "Results written to $RESULTS"
+
+if [ -z "$BASELINE" ]; then
+  exit 0
+fi
+
+if [ ! -f "$BASELINE" ]; then
+  echo "No baseline $BASELINE, regression check skipped"
+  exit 0
+fi
+
+# Rows are matched by transport, server options and workload, rows
+# missing from baseline fail the check until it is regenerated
+awk -F, -v tolerance="$TOLERANCE" '
+  FNR == 1 { next }
+  { key = $1 "," $2 "," $3 "," $5 "," $6 "," $7 }
+  NR == FNR { baseline[key] = $12; next }
+  !(key in baseline) {
+    printf "NO BASELINE: %s: %.0f msg/s\n", key, $12
+    missing = 1
+    next
+  }
+  $12 < baseline[key] * (1 - tolerance) {
+    printf "REGRESSION: %s: %.0f msg/s, baseline %.0f msg/s\n", key, $12, baseline[key]
+    failed = 1
+  }
+  END {
+    if (missing)
+      print "Baseline lacks rows, regenerate it with make bench-baseline"
+    if (failed || missing)
+      exit 1
+    print "No regressions against baseline"
+  }
+' "$BASELINE" "$RESULTS"
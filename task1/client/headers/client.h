@@ -2,6 +2,9 @@
 #define CLIENT_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/decoder.h"
+#include "../../common/headers/shm.h"
 
 /*
  * Used as client for connection to local address
@@ -13,17 +16,35 @@ struct client {
 
   /* Server file descriptor*/
   int sfd;
+
+  /* Received bytes and messages that were not taken yet */
+  struct decoder decoder;
+
+  /* Amount of messages sent before waiting for responses */
+  int window;
+
+  /* Messages go through shared memory rings after handshake */
+  int shm;
+  struct shm_channel channel;
 };
 
-struct client* create_client(const char* path);
+struct client* create_client(const char* path, int window, int shm);
+
+void connect_client(struct client* client);
 
 void run_client(struct client* client);
 
 void process_input(struct client* client);
 
-void send_message(struct client* client, const char* buffer);
+void send_messages(struct client* client, const char** messages, int count);
+
+void advance_frames(struct msghdr* msg, size_t bytes_sent);
+
+int send_frames(struct client* client, struct iovec* iov, int count);
+
+struct msgbuf* recv_message(struct client* client);
 
-char* recv_message(struct client* client);
+struct msgbuf* recv_shm_message(struct client* client);
 
 void shutdown_connection(struct client* client);
 
@@ -0,0 +1,290 @@
+#include "../headers/bench.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+
+/*
+ * run_bench - used to run closed-loop load generation.
+ * Connects all connections, starts them at once, waits
+ * until every connection has sent its messages and
+ * prints report.
+ * @bench - pointer to an object of bench struct
+ */
+void run_bench(struct bench* bench) {
+  struct bench_worker* workers = (struct bench_worker*) calloc(bench->connections, sizeof(struct bench_worker));
+  pthread_barrier_t start;
+  uint64_t started;
+
+  if (!workers)
+    print_error("calloc");
+
+  if (pthread_barrier_init(&start, NULL, bench->connections + 1) != 0)
+    print_error("pthread_barrier_init");
+
+  for (int i = 0; i < bench->connections; i++) {
+    struct bench_worker* worker = &workers[i];
+
+    worker->bench = bench;
+    worker->start = &start;
+    worker->seed = time(NULL) + i;
+    worker->client = create_client(SOCK_PATH, bench->window, bench->shm);
+    init_histogram(&worker->histogram);
+
+    if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0)
+      print_error("pthread_create");
+  }
+
+  /* Start measuring once all connections are established */
+  pthread_barrier_wait(&start);
+  started = now_ns();
+
+  for (int i = 0; i < bench->connections; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  report_bench(bench, workers, now_ns() - started);
+
+  for (int i = 0; i < bench->connections; i++) {
+    shutdown_connection(workers[i].client);
+    free_client(workers[i].client);
+  }
+
+  pthread_barrier_destroy(&start);
+  free(workers);
+}
+
+/*
+ * take_responses - used to take responses to messages of
+ * the window without logging. Responses come in order of
+ * messages, so their sizes are checked by position. Stream
+ * socket is non-blocking, it is polled only if worker waits.
+ * Shared memory connections take responses from ring of
+ * replies and always wait.
+ * @worker - pointer to an object of bench_worker struct
+ * @sizes - payload sizes of messages of the window
+ * @count - amount of messages of the window
+ * @sent_at - time the window was sent
+ * @taken - amount of responses taken before, updated
+ * @wait - wait until all responses come
+ *
+ * Return: 0 on success, -1 if connection failed
+ */
+static int take_responses(struct bench_worker* worker, uint32_t* sizes, int count, uint64_t sent_at,
+                          int* taken, int wait) {
+  struct client* client = worker->client;
+  struct pollfd pfd = {client->sfd, POLLIN, 0};
+
+  while (*taken < count) {
+    struct msgbuf* frame = NULL;
+    uint32_t frame_len;
+
+    if (client->shm) {
+      frame = recv_shm_message(client);
+      if (!frame)
+        return -1;
+    } else {
+      switch (decoder_next(&client->decoder, 0, &frame)) {
+        case FRAME_OK:
+          break;
+
+        case FRAME_TOO_BIG:
+          return -1;
+
+        case FRAME_PARTIAL: {
+          ssize_t bytes_read = decoder_fill(&client->decoder, client->sfd);
+
+          if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!wait)
+              return 0;
+            if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+              return -1;
+          } else if (bytes_read <= 0)
+            return -1;
+          continue;
+        }
+      }
+    }
+
+    histogram_record(&worker->histogram, now_ns() - sent_at);
+    frame_len = frame->len;
+    msgbuf_free(frame);
+
+    if (frame_len != sizes[*taken] + PREFIX_LEN)
+      return -1;
+    (*taken)++;
+    worker->received++;
+  }
+
+  return 0;
+}
+
+/*
+ * send_window - used to send gathered messages of the
+ * window. Stream socket is non-blocking: while it can't
+ * take more bytes, responses that already came are taken,
+ * so server that stops reading until its replies are read
+ * never waits for worker that waits for it. Shared memory
+ * window is limited by main to what ring of replies holds.
+ * @worker - pointer to an object of bench_worker struct
+ * @iov - length headers and payloads, modified
+ * @sizes - payload sizes of messages of the window
+ * @count - amount of messages of the window
+ * @sent_at - time the window was sent
+ * @taken - amount of responses taken while sending
+ *
+ * Return: 0 if all messages sent, -1 if connection failed
+ */
+static int send_window(struct bench_worker* worker, struct iovec* iov, uint32_t* sizes, int count,
+                       uint64_t sent_at, int* taken) {
+  struct client* client = worker->client;
+  struct pollfd pfd = {client->sfd, POLLIN | POLLOUT, 0};
+  struct msghdr msg;
+
+  if (client->shm)
+    return send_frames(client, iov, count * 2);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count * 2;
+
+  while (msg.msg_iovlen > 0) {
+    ssize_t bytes_sent = sendmsg(client->sfd, &msg, MSG_NOSIGNAL);
+
+    if (bytes_sent >= 0) {
+      advance_frames(&msg, bytes_sent);
+      continue;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      return -1;
+
+    if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+      return -1;
+    if ((pfd.revents & POLLIN) && take_responses(worker, sizes, count, sent_at, taken, 0) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * run_worker - used in thread to drive one connection.
+ * Sends window messages of random sizes in one gathered
+ * send and measures time until response to each of them.
+ * Responses are taken while sending too, so window may be
+ * larger than socket buffers.
+ * @arg - pointer to an object of bench_worker struct
+ */
+void* run_worker(void* arg) {
+  struct bench_worker* worker = (struct bench_worker*) arg;
+  struct bench* bench = worker->bench;
+  struct client* client = worker->client;
+  struct iovec iov[REPLIES_AMOUNT * 2];
+  uint32_t net_lens[REPLIES_AMOUNT];
+  uint32_t sizes[REPLIES_AMOUNT];
+  uint32_t range = bench->max_size - bench->min_size + 1;
+  int left = bench->messages;
+
+  /* Payload of every message is part of the same buffer */
+  char* payload = (char*) malloc(bench->max_size);
+  if (!payload)
+    print_error("malloc");
+  memset(payload, 'x', bench->max_size);
+
+  connect_client(client);
+  if (!client->shm && fcntl(client->sfd, F_SETFL, fcntl(client->sfd, F_GETFL) | O_NONBLOCK) == -1)
+    print_error("fcntl");
+  pthread_barrier_wait(worker->start);
+
+  while (left > 0 && !worker->failed) {
+    int count = left < bench->window ? left : bench->window;
+
+    for (int i = 0; i < count; i++) {
+      sizes[i] = bench->min_size + rand_r(&worker->seed) % range;
+      net_lens[i] = htonl(sizes[i]);
+
+      iov[i * 2].iov_base = &net_lens[i];
+      iov[i * 2].iov_len = sizeof(net_lens[i]);
+      iov[i * 2 + 1].iov_base = payload;
+      iov[i * 2 + 1].iov_len = sizes[i];
+      worker->bytes += sizes[i];
+    }
+
+    uint64_t sent_at = now_ns();
+    int taken = 0;
+
+    if (send_window(worker, iov, sizes, count, sent_at, &taken) == -1) {
+      worker->failed = 1;
+      break;
+    }
+    worker->sent += count;
+    left -= count;
+
+    if (take_responses(worker, sizes, count, sent_at, &taken, 1) == -1)
+      worker->failed = 1;
+  }
+
+  free(payload);
+
+  return NULL;
+}
+
+/*
+ * report_bench - used to merge results of all connections
+ * and print throughput and latency percentiles, as text
+ * or as one comma separated row.
+ * @bench - pointer to an object of bench struct
+ * @workers - array of finished workers
+ * @elapsed - duration of load in nanoseconds
+ */
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed) {
+  struct histogram histogram;
+  struct pool_stats stats;
+  unsigned long sent = 0, received = 0;
+  uint64_t bytes = 0;
+  int failed = 0;
+  double seconds = elapsed / 1e9;
+
+  init_histogram(&histogram);
+  for (int i = 0; i < bench->connections; i++) {
+    histogram_merge(&histogram, &workers[i].histogram);
+    sent += workers[i].sent;
+    received += workers[i].received;
+    bytes += workers[i].bytes;
+    failed += workers[i].failed;
+  }
+
+  /* One row of results table */
+  if (bench->csv) {
+    printf("%d,%d,%u,%u,%d,%lu,%lu,%d,%.3f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+           bench->connections, bench->messages, bench->min_size, bench->max_size, bench->window,
+           sent, received, failed, seconds, received / seconds, bytes / seconds / 1e6,
+           histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+           histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+    return;
+  }
+
+  printf("BENCH: %d connections, %d messages each, %u-%u bytes, window %d\n",
+         bench->connections, bench->messages, bench->min_size, bench->max_size, bench->window);
+  printf("BENCH: %lu sent, %lu received in %.3f s, %d connections failed\n", sent, received, seconds, failed);
+  printf("BENCH: throughput %.0f msg/s, %.2f MB/s\n", received / seconds, bytes / seconds / 1e6);
+  printf("BENCH: latency us: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+         histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+         histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+
+  pool_get_stats(&stats);
+  printf("BENCH: pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+}
+
+/*
+ * now_ns - used to read monotonic clock.
+ *
+ * Return: current time in nanoseconds
+ */
+uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -4,10 +4,12 @@
  * create_client - used to create an object of
  * client struct. 
  * @path - path to socket file
+ * @window - amount of messages sent before waiting for responses
+ * @shm - use shared memory transport after connection
  *
  * Return: pointer to an object of client struct
  */
-struct client* create_client(const char* path) {
+struct client* create_client(const char* path, int window, int shm) {
   struct client* client = (struct client*) malloc(sizeof(struct client));
   if (!client)
     print_error("malloc");
@@ -20,131 +22,264 @@ struct client* create_client(const char* path) {
   if (client->sfd == -1)
     print_error("socket");
 
+  init_decoder(&client->decoder, MAX_FRAME_SIZE, 0);
+  client->window = window;
+  client->shm = shm;
+  memset(&client->channel, 0, sizeof(client->channel));
+  client->channel.efd = -1;
+  client->channel.peer_efd = -1;
+
   return client;
 }
 
-/* run_client - used to conenct to server
- * specified int client->serv.
+/*
+ * connect_client - used to connect to server
+ * specified in client->serv and switch to shared
+ * memory transport if client uses it.
  * @client - pointer to an object of client struct
  */
-void run_client(struct client* client) {
+void connect_client(struct client* client) {
   socklen_t serv_size = sizeof(client->serv);   
   
   /* Connect to server */
   if (connect(client->sfd, (struct sockaddr*) &client->serv, serv_size) == -1)
     print_error("connect");
-  
+
+  if (client->shm && shm_connect(&client->channel, client->sfd) == -1)
+    print_error("shm_connect");
+}
+
+/* run_client - used to conenct to server
+ * specified int client->serv and process user input.
+ * @client - pointer to an object of client struct
+ */
+void run_client(struct client* client) {
+  connect_client(client);
+
   /* Process user input */
   process_input(client);
 }
 
 /*
  * process_input - used to receive user input
- * from stdin. Terminates received string, calls
- * send_message and waits for server response.
+ * from stdin. Reads up to window lines, sends them
+ * together and waits for server responses in the same
+ * order. Stops when stdin is closed.
  * @client - pointer to an object of client struct
  */
 void process_input(struct client* client) {
-  char buffer[BUFFER_SIZE];
-  
+  char buffers[REPLIES_AMOUNT][BUFFER_SIZE];
+  const char* messages[REPLIES_AMOUNT];
+  int count;
+
   /* Wait for user input */
-  while (1) {
-    printf("Enter message: ");
-    
+  do {
     /* Read user input */
-    if (fgets(buffer, sizeof(buffer), stdin) == NULL)
-      print_error("fgets");
-    buffer[strlen(buffer) - 1] = '\0';
-
-    /* Send user message */
-    send_message(client, buffer);
-
-    /* Receive answer */
-    char* message = recv_message(client);
-    if (message == NULL) {
-      close_connection(client);
-      break;
+    for (count = 0; count < client->window; count++) {
+      log_flush();
+      printf("Enter message: ");
+      if (fgets(buffers[count], sizeof(buffers[count]), stdin) == NULL)
+        break;
+      buffers[count][strcspn(buffers[count], "\n")] = '\0';
+      messages[count] = buffers[count];
     }
 
-    printf("SERVER: Server %s send response: %s\n", client->serv.sun_path, message);
-    free(message);
+    /* Send user messages */
+    if (count > 0)
+      send_messages(client, messages, count);
+
+    /* Receive answers */
+    for (int i = 0; i < count; i++) {
+      struct msgbuf* message = recv_message(client);
+      if (message == NULL) {
+        close_connection(client);
+        return;
+      }
+
+      log_info("SERVER: Server %s send response: %s\n", client->serv.sun_path, message->data);
+      msgbuf_free(message);
+    }
+  } while (count == client->window);
+}
+
+/*
+ * send_messages - used to send messages to server. Length
+ * of every message, converted to Big Endian, and message
+ * itself are gathered into one sendmsg call.
+ * @client - pointer to an object of client struct
+ * @messages - strings that need to be sent
+ * @count - amount of messages (up to REPLIES_AMOUNT)
+ */
+void send_messages(struct client* client, const char** messages, int count) {
+  struct iovec iov[REPLIES_AMOUNT * 2];
+  uint32_t net_lens[REPLIES_AMOUNT];
+
+  for (int i = 0; i < count; i++) {
+    uint32_t message_len = strlen(messages[i]);
+    net_lens[i] = htonl(message_len);
+
+    iov[i * 2].iov_base = &net_lens[i];
+    iov[i * 2].iov_len = sizeof(net_lens[i]);
+    iov[i * 2 + 1].iov_base = (char*) messages[i];
+    iov[i * 2 + 1].iov_len = message_len;
+
+    /* Log message */
+    log_debug("CLIENT: Send message len: %d\n", message_len);
+    log_debug("CLIENT: Send message: %s\n", messages[i]);
   }
+
+  if (send_frames(client, iov, count * 2) == -1)
+    print_error("sendmsg");
 }
 
 /*
- * send_message - used to send message to server. Sends
- * buffer length first, converted to Big Endian, then sends
- * message itself.
+ * send_shm_frames - used to put frames into ring of
+ * requests. Buffers come in pairs of length header and
+ * payload, ring records keep length by themselves, so
+ * only payloads are copied.
  * @client - pointer to an object of client struct
- * @buffer - string that needs to be sent
+ * @iov - length headers and payloads
+ * @count - amount of buffers
+ *
+ * Return: 0 if all frames written, -1 if server is gone
  */
-void send_message(struct client* client, const char* buffer) {
-  uint32_t buffer_len = strlen(buffer);
-  uint32_t net_len = htonl(buffer_len);
-  
-  /* Send message length */
-  if (send(client->sfd, &net_len, sizeof(net_len), 0) == -1)
-    print_error("send");
-  
-  /* Log message len */
-  printf("CLIENT: Send message len: %d\n", buffer_len);
-  
-  /* Send message */
-  if (send(client->sfd, buffer, buffer_len, 0) == -1)
-    print_error("send");
-  
-  /* Log message*/
-  printf("CLIENT: Send message: %s\n", buffer);
+static int send_shm_frames(struct client* client, struct iovec* iov, int count) {
+  for (int i = 0; i + 1 < count; i += 2) {
+    uint32_t len = iov[i + 1].iov_len;
+
+    if (len > SHM_MAX_MESSAGE - PREFIX_LEN) {
+      errno = EMSGSIZE;
+      return -1;
+    }
+
+    char* data = shm_reserve(&client->channel, len);
+    if (data == NULL) {
+      errno = EPIPE;
+      return -1;
+    }
+
+    memcpy(data, iov[i + 1].iov_base, len);
+    shm_commit(&client->channel, len);
+  }
+
+  return 0;
+}
+
+/*
+ * advance_frames - used to skip bytes that were sent by
+ * partial send. Iovecs are modified.
+ * @msg - pointer to message of gathered buffers
+ * @bytes_sent - amount of sent bytes
+ */
+void advance_frames(struct msghdr* msg, size_t bytes_sent) {
+  while (msg->msg_iovlen > 0 && bytes_sent >= msg->msg_iov->iov_len) {
+    bytes_sent -= msg->msg_iov->iov_len;
+    msg->msg_iov++;
+    msg->msg_iovlen--;
+  }
+  if (msg->msg_iovlen > 0) {
+    msg->msg_iov->iov_base = (char*) msg->msg_iov->iov_base + bytes_sent;
+    msg->msg_iov->iov_len -= bytes_sent;
+  }
+}
+
+/*
+ * send_frames - used to send gathered buffers to server,
+ * continuing after partial sends. Iovecs are modified.
+ * @client - pointer to an object of client struct
+ * @iov - buffers that need to be sent
+ * @count - amount of buffers
+ *
+ * Return: 0 if all bytes sent, -1 on error
+ */
+int send_frames(struct client* client, struct iovec* iov, int count) {
+  struct msghdr msg;
+  ssize_t bytes_sent;
+
+  if (client->shm)
+    return send_shm_frames(client, iov, count);
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+
+  /* Send buffers, continue after partial send */
+  while (msg.msg_iovlen > 0) {
+    bytes_sent = sendmsg(client->sfd, &msg, MSG_NOSIGNAL);
+    if (bytes_sent == -1) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+
+    advance_frames(&msg, bytes_sent);
+  }
+
+  return 0;
 }
 
 /*
  * recv_message - used to receive message from server.
- * Receives message length first, converts to Little Endian,
- * allocates memory for message, then receives it all. Allocated
- * buffer must be freed manually.
+ * Takes next message from decoder, receiving more bytes
+ * only when decoder doesn't hold complete message. Allocated
+ * buffer must be freed by msgbuf_free.
+ * @client - pointer to an object of client struct
  *
- * Return: string (message) if successful, NULL if connection terminated
+ * Return: message buffer if successful, NULL if connection terminated
  */
-char* recv_message(struct client* client) {
-  uint32_t net_len;
-  uint32_t message_len;
+struct msgbuf* recv_message(struct client* client) {
   ssize_t bytes_read;
-  ssize_t total_received;
-  char* message;
-  
-  /* Receive message length */
-  bytes_read = recv(client->sfd, &net_len, sizeof(net_len), 0);
-  /* Error occured*/
-  if (bytes_read < 0) {
-    print_error("recv");
-  } 
-  /* Connection closed */
-  else if (bytes_read == 0) {
-    return NULL;
-  }
-  
-  /* Convert message length to Little Endian */
-  message_len = ntohl(net_len);
-  
-  printf("CLIENT: Received message length: %d\n", message_len);
+  struct msgbuf* message;
 
-  /* Allocate memory for message */
-  message = (char*) malloc(message_len + 1);
-  if (!message)
-    print_error("malloc");
-  
-  /* Read all message */
-  while (total_received < message_len) {
-    bytes_read = recv(client->sfd, message + total_received, message_len - total_received, 0);
+  if (client->shm)
+    return recv_shm_message(client);
+
+  while (1) {
+    switch (decoder_next(&client->decoder, 0, &message)) {
+      case FRAME_OK:
+        log_debug("CLIENT: Received message length: %d\n", message->len);
+        return message;
+
+      case FRAME_TOO_BIG:
+        log_warn("CLIENT: Server sent message longer than %u bytes\n", client->decoder.max_frame);
+        return NULL;
+
+      case FRAME_PARTIAL:
+        break;
+    }
+
+    bytes_read = decoder_fill(&client->decoder, client->sfd);
+    /* Error occured*/
     if (bytes_read < 0) {
-      free(message);
       print_error("recv");
     }
-    total_received += bytes_read;
+    /* Connection closed */
+    else if (bytes_read == 0) {
+      return NULL;
+    }
   }
-  
-  /* Terminate message */
-  message[message_len] = '\0';
+}
+
+/*
+ * recv_shm_message - used to take next reply from ring of
+ * replies. Reply is copied out, so ring space is freed at once.
+ * Allocated buffer must be freed by msgbuf_free.
+ * @client - pointer to an object of client struct
+ *
+ * Return: message buffer if successful, NULL if server is gone
+ */
+struct msgbuf* recv_shm_message(struct client* client) {
+  uint32_t len;
+  char* data = shm_peek(&client->channel, &len);
+
+  if (data == NULL)
+    return NULL;
+
+  struct msgbuf* message = msgbuf_alloc(0, len + 1);
+  memcpy(message->data, data, len);
+  message->data[len] = '\0';
+  message->len = len;
+  shm_release(&client->channel);
 
   return message;
 }
@@ -174,5 +309,7 @@ void close_connection(struct client* client) {
  * @client - pointer to an object of client struct
  */
 void free_client(struct client* client) {
+  shm_close(&client->channel);
+  free_decoder(&client->decoder);
   free(client);
 }
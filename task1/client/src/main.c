@@ -1,12 +1,93 @@
 #include "../headers/client.h"
+#include "../headers/bench.h"
 #include <sys/socket.h>
 
 struct client* client;
 
 void cleanup();
 
-int main(void) {
-  client = create_client(SOCK_PATH);
+/*
+ * Usage: client [-w window] [-n connections] [-m messages] [-s size[:max_size]] [-c] [-t transport]
+ * -w - amount of messages sent before waiting
+ *      for responses (1 by default)
+ * -n - run load generator with given amount of
+ *      connections instead of reading stdin
+ * -m - amount of messages sent by every connection
+ * -s - size of messages in bytes, or range of
+ *      uniformly distributed sizes
+ * -c - print results of load generator as one
+ *      comma separated row
+ * -t - transport: stream (default) or shm, which
+ *      passes messages through shared memory rings
+ *      (threads backend of server only)
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  struct bench bench = {0, 10000, 1, 64, 64, 0, 0};
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w:n:m:s:ct:")) != -1) {
+    switch (opt) {
+      case 'w':
+        bench.window = atoi(optarg);
+        break;
+      case 'n':
+        bench.connections = atoi(optarg);
+        break;
+      case 'm':
+        bench.messages = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%u:%u", &bench.min_size, &bench.max_size) == 1)
+          bench.max_size = bench.min_size;
+        break;
+      case 'c':
+        bench.csv = 1;
+        break;
+      case 't':
+        if (strcmp(optarg, "shm") == 0)
+          bench.shm = 1;
+        else if (strcmp(optarg, "stream") != 0) {
+          fprintf(stderr, "Unknown transport: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-w window] [-n connections] [-m messages] [-s size[:max_size]] [-c] [-t transport]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  if (bench.window < 1 || bench.window > REPLIES_AMOUNT) {
+    fprintf(stderr, "Window must be in range 1..%d\n", REPLIES_AMOUNT);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Run load generator */
+  if (bench.connections > 0) {
+    uint64_t max_size = bench.shm ? SHM_MAX_MESSAGE - PREFIX_LEN : MAX_FRAME_SIZE - PREFIX_LEN;
+
+    if (bench.min_size < 1 || bench.min_size > bench.max_size || bench.max_size > max_size) {
+      fprintf(stderr, "Size must be in range 1..%lu\n", max_size);
+      exit(EXIT_FAILURE);
+    }
+
+    /* Replies are read once window is sent, ring of replies has to hold them
+       and record skipped at ring end */
+    if (bench.shm && (bench.window + 1) * SHM_RECORD_SIZE(bench.max_size + PREFIX_LEN) > SHM_RING_SIZE) {
+      fprintf(stderr, "Window of %u byte messages must be in range 1..%llu for shm transport\n", bench.max_size,
+              SHM_RING_SIZE / SHM_RECORD_SIZE(bench.max_size + PREFIX_LEN) - 1);
+      exit(EXIT_FAILURE);
+    }
+
+    run_bench(&bench);
+    exit(EXIT_SUCCESS);
+  }
+
+  client = create_client(SOCK_PATH, bench.window, bench.shm);
   atexit(cleanup);
   run_client(client);
   exit(EXIT_SUCCESS);
@@ -0,0 +1,69 @@
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include "common.h"
+#include "log.h"
+#include "metrics.h"
+#include "pool.h"
+#include <sys/un.h>
+
+#define ADMIN_COMMAND_SIZE 64
+#define ADMIN_ENDPOINT_SIZE 108
+
+/**
+ * Used as row of client table returned by admin socket.
+ */
+struct admin_client {
+  /* Address of the client */
+  char endpoint[ADMIN_ENDPOINT_SIZE];
+
+  /* Bytes received from and sent to client */
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+
+  /* Time of connection (metrics_now) */
+  uint64_t connected_at;
+};
+
+/**
+ * Used to build client table when amount of clients
+ * is not known in advance.
+ */
+struct admin_table {
+  struct admin_client* rows;
+  int amount;
+  int capacity;
+};
+
+/**
+ * Used as admin socket (AF_LOCAL) of the server. Separate
+ * thread answers commands with snapshot of metrics:
+ * "stats" (or empty line) - text, "json" - JSON,
+ * "level <name>" - change log level.
+ */
+struct admin {
+  /* Address and passive socket */
+  struct sockaddr_un addr;
+  int sfd;
+
+  /* Thread that answers commands */
+  pthread_t thread;
+
+  /* Time server started, counters and time of previous snapshot */
+  uint64_t started;
+  uint64_t last_counters[METRIC_COUNTERS];
+  uint64_t last_time;
+
+  /* Fills client table, NULL for servers without connections */
+  int (*collect_clients)(void* arg, struct admin_client** clients);
+  void* arg;
+};
+
+struct admin_client* admin_table_add(struct admin_table* table);
+
+void start_admin(struct admin* admin, const char* path,
+                 int (*collect_clients)(void* arg, struct admin_client** clients), void* arg);
+
+void stop_admin(struct admin* admin);
+
+#endif // !ADMIN_H
@@ -10,10 +10,31 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 
 #define CLIENTS_AMOUNT 5
 #define BUFFER_SIZE 128
+#define CACHE_LINE_SIZE 64
+#define PREFIX "Server "
+#define PREFIX_LEN (sizeof(PREFIX) - 1)
+#define REPLY_HEADROOM (sizeof(uint32_t) + PREFIX_LEN)
+#define REPLIES_AMOUNT 64
+#define DECODER_SIZE 4096
+#define DECODER_BLOCK_MAX (64 * 1024)
+#define MAX_FRAME_SIZE (16 * 1024 * 1024)
+#define STREAM_CHUNK_SIZE (64 * 1024)
+#define SEND_QUEUE_HIGH (1024 * 1024)
+#define SEND_QUEUE_LOW (256 * 1024)
+#define SEND_QUEUE_TIMEOUT 5
+#define READ_TIMEOUT 10
+#define IDLE_TIMEOUT 60
+#define URING_ENTRIES 1024
+#define URING_BUFFERS 1024
+#define URING_BUFFER_SIZE 4096
+#define URING_CLIENT_BUFFERS (URING_BUFFERS / 8)
 #define SOCK_PATH "./sock"
+#define ADMIN_SOCK_PATH "./admin_sock"
 #define print_error(msg) do {perror(msg); \
   exit(EXIT_FAILURE);} while(0)
 
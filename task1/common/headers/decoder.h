@@ -0,0 +1,76 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include "common.h"
+#include "msgbuf.h"
+#include "rxbuf.h"
+#include <sys/uio.h>
+
+/**
+ * Used as result of taking next frame from decoder.
+ */
+enum frame_status {
+  /* Complete frame was taken */
+  FRAME_OK,
+
+  /* Buffer holds only part of the frame */
+  FRAME_PARTIAL,
+
+  /* Length header exceeds max frame size */
+  FRAME_TOO_BIG
+};
+
+/**
+ * Used as incremental decoder of length-prefixed frames
+ * (4 bytes length, Big Endian, followed by payload). Bytes
+ * are received into queue of blocks and as many frames as
+ * they hold are taken out without more system calls.
+ * Frames are either copied out whole (or in pieces of chunk
+ * bytes if longer) or borrowed: message buffer then points
+ * at payload inside the block, so it is never copied, and
+ * frame spread over several blocks is taken in pieces.
+ */
+struct decoder {
+  /* Blocks holding unread bytes, oldest first */
+  struct rxbuf* first;
+  struct rxbuf* last;
+
+  /* Position of first unread byte in first block */
+  uint32_t offset;
+
+  /* Amount of unread bytes in all blocks */
+  size_t pending;
+
+  /* Max allowed length of frame payload */
+  uint32_t max_frame;
+
+  /* Max length of frame taken whole, 0 if no frame is streamed */
+  uint32_t chunk;
+
+  /* Payload bytes of frame being taken that were not taken
+     yet and length of whole frame */
+  uint32_t left;
+  uint32_t frame_len;
+};
+
+void init_decoder(struct decoder* decoder, uint32_t max_frame, uint32_t chunk);
+
+size_t decoder_space(struct decoder* decoder);
+
+ssize_t decoder_fill(struct decoder* decoder, int fd);
+
+void decoder_append(struct decoder* decoder, struct rxbuf* rxbuf);
+
+int decoder_ready(struct decoder* decoder);
+
+size_t decoder_pending(struct decoder* decoder);
+
+enum frame_status decoder_next(struct decoder* decoder, uint32_t headroom, struct msgbuf** frame);
+
+enum frame_status decoder_borrow(struct decoder* decoder, uint32_t headroom, struct msgbuf** frame);
+
+uint32_t decoder_detach(struct decoder* decoder);
+
+void free_decoder(struct decoder* decoder);
+
+#endif // !DECODER_H
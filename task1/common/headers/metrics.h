@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+#include "histogram.h"
+
+/**
+ * Used as counters kept by every thread.
+ */
+enum metric_counter {
+  /* Connections accepted and closed */
+  METRIC_ACCEPTED,
+  METRIC_CLOSED,
+
+  /* Messages received from clients and replies sent */
+  METRIC_MESSAGES_IN,
+  METRIC_MESSAGES_OUT,
+
+  /* Bytes received and sent */
+  METRIC_BYTES_IN,
+  METRIC_BYTES_OUT,
+
+  METRIC_COUNTERS
+};
+
+/**
+ * Used as stages of request handling with their own
+ * latency histograms.
+ */
+enum metric_stage {
+  STAGE_ACCEPT,
+  STAGE_RECV,
+  STAGE_TRANSFORM,
+  STAGE_SEND,
+
+  METRIC_STAGES
+};
+
+/**
+ * Used as metrics of one thread. Only owner thread writes
+ * them (relaxed atomic stores, no locks), snapshots read
+ * them from other threads. Every thread has its own cache
+ * lines, so counters of different threads never share one.
+ * Metrics are linked to be summed by snapshots.
+ */
+struct metrics {
+  uint64_t counters[METRIC_COUNTERS];
+
+  /* Latencies of stages in nanoseconds */
+  struct histogram latency[METRIC_STAGES];
+
+  /* Neighbours in list of all metrics */
+  struct metrics* prev;
+  struct metrics* next;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * Used as sum of metrics of all threads, including
+ * finished ones.
+ */
+struct metrics_snapshot {
+  uint64_t counters[METRIC_COUNTERS];
+  struct histogram latency[METRIC_STAGES];
+};
+
+extern const char* metric_counter_names[METRIC_COUNTERS];
+
+extern const char* metric_stage_names[METRIC_STAGES];
+
+uint64_t metrics_now(void);
+
+void metrics_add(enum metric_counter counter, uint64_t value);
+
+void metrics_add_bytes(enum metric_counter counter, uint64_t* client_bytes, uint64_t value);
+
+uint64_t metrics_record(enum metric_stage stage, uint64_t start);
+
+void metrics_get_snapshot(struct metrics_snapshot* snapshot);
+
+#endif // !METRICS_H
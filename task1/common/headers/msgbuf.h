@@ -0,0 +1,56 @@
+#ifndef MSGBUF_H
+#define MSGBUF_H
+
+#include "common.h"
+#include "pool.h"
+#include "rxbuf.h"
+#include <sys/uio.h>
+
+/**
+ * Used as message buffer with headroom. Payload is either
+ * copied behind reserved space or left in block it was
+ * received into, then data holds only bytes written in front
+ * of it. Prefix and length header of reply are written in
+ * place into headroom, so payload is never copied before
+ * send. Struct and its storage are one pool buffer.
+ */
+struct msgbuf {
+  /* First byte of data, headroom lies in front of it */
+  char* data;
+
+  /* Length of data */
+  uint32_t len;
+
+  /* Length of whole frame data starts, larger than len if
+     rest of frame follows in next buffers (streamed frame) */
+  uint32_t frame_len;
+
+  /* 1 if data continues frame started by previous buffer */
+  uint32_t continued;
+
+  /* Free bytes in front of data */
+  uint32_t headroom;
+
+  /* Block holding payload that follows data, NULL if
+     payload is part of data */
+  struct rxbuf* rx;
+  char* payload;
+  uint32_t payload_len;
+
+  /* Headroom followed by space for data */
+  char storage[];
+};
+
+struct msgbuf* msgbuf_alloc(uint32_t headroom, uint32_t size);
+
+char* msgbuf_push(struct msgbuf* msgbuf, const void* bytes, uint32_t len);
+
+void msgbuf_attach(struct msgbuf* msgbuf, struct rxbuf* rx, char* payload, uint32_t len);
+
+uint32_t msgbuf_length(struct msgbuf* msgbuf);
+
+int msgbuf_iov(struct msgbuf* msgbuf, uint32_t skip, struct iovec* iov);
+
+void msgbuf_free(struct msgbuf* msgbuf);
+
+#endif // !MSGBUF_H
@@ -0,0 +1,66 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "common.h"
+
+#define REGISTRY_CHUNK_SHIFT 12
+#define REGISTRY_CHUNK_SIZE (1 << REGISTRY_CHUNK_SHIFT)
+#define REGISTRY_MAX_CHUNKS 1024
+#define REGISTRY_NONE UINT32_MAX
+
+/**
+ * Used as slot of registry. Generation is changed every
+ * time slot is freed, so ids of removed items never match
+ * items that reuse their slot.
+ */
+struct registry_slot {
+  /* Registered item, NULL if slot is free */
+  void* item;
+
+  /* Generation of current item */
+  uint32_t generation;
+
+  /* Index of next free slot */
+  uint32_t next_free;
+};
+
+/**
+ * Used as growable generation-tagged slot map. Item id
+ * keeps index of its slot and generation of the slot,
+ * so insert, lookup and remove cost the same whatever
+ * amount of items. Slots are allocated by chunks that
+ * never move, free slots are linked into list. All
+ * operations take lock, it is held for a few instructions
+ * (iteration holds it until callback returns).
+ */
+struct registry {
+  /* Chunks of REGISTRY_CHUNK_SIZE slots */
+  struct registry_slot* chunks[REGISTRY_MAX_CHUNKS];
+  uint32_t chunks_amount;
+
+  /* Head of free slots list */
+  uint32_t free_head;
+
+  /* Amount of registered items */
+  uint32_t amount;
+
+  pthread_mutex_t lock;
+};
+
+void init_registry(struct registry* registry);
+
+uint64_t registry_insert(struct registry* registry, void* item);
+
+void* registry_get(struct registry* registry, uint64_t id);
+
+void registry_remove(struct registry* registry, uint64_t id);
+
+uint32_t registry_size(struct registry* registry);
+
+void* registry_next(struct registry* registry, uint32_t* index);
+
+void registry_foreach(struct registry* registry, void (*callback)(void* item, void* arg), void* arg);
+
+void free_registry(struct registry* registry);
+
+#endif // !REGISTRY_H
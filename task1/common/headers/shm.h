@@ -0,0 +1,95 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include "common.h"
+
+/* Length header that asks server for shared memory transport */
+#define SHM_HANDSHAKE 0xFFFFFFFFu
+
+/* Size of data area of every ring (power of two) */
+#define SHM_RING_SIZE (1 << 20)
+
+/* Longest message, so any record fits into ring */
+#define SHM_MAX_MESSAGE (SHM_RING_SIZE / 4)
+
+/* Space taken by record: length header and payload, padded to 8 bytes */
+#define SHM_RECORD_SIZE(len) (((uint64_t) sizeof(uint32_t) + (len) + 7) & ~7ull)
+
+/* Length of record that tells reader to wrap to ring start */
+#define SHM_WRAP 0xFFFFFFFFu
+
+/* Checks of ring before side goes to sleep on eventfd */
+#define SHM_SPINS 256
+
+/**
+ * Used as single-producer single-consumer ring of records
+ * in shared memory. Record is length followed by payload,
+ * padded to 8 bytes, and never wraps: writer puts SHM_WRAP
+ * marker and continues from ring start instead. Positions
+ * grow forever, offset is position modulo SHM_RING_SIZE.
+ * Side that waits sets its flag before sleeping, so other
+ * side signals eventfd only when somebody sleeps.
+ */
+struct shm_ring {
+  /* Read position, written by reader */
+  _Alignas(CACHE_LINE_SIZE) uint64_t head;
+
+  /* Reader sleeps until ring is not empty */
+  uint32_t reader_waiting;
+
+  /* Write position, written by writer */
+  _Alignas(CACHE_LINE_SIZE) uint64_t tail;
+
+  /* Writer sleeps until ring has space */
+  uint32_t writer_waiting;
+
+  _Alignas(CACHE_LINE_SIZE) char data[SHM_RING_SIZE];
+};
+
+/**
+ * Used as memory shared by client and server (one memfd):
+ * ring of requests and ring of replies.
+ */
+struct shm_region {
+  struct shm_ring requests;
+  struct shm_ring replies;
+};
+
+/**
+ * Used as one side of shared memory transport. Socket of
+ * handshake stays open, it is only watched to notice that
+ * other side is gone.
+ */
+struct shm_channel {
+  struct shm_region* region;
+
+  /* Ring this side reads and ring it writes */
+  struct shm_ring* in;
+  struct shm_ring* out;
+
+  /* Eventfd this side sleeps on and eventfd of other side */
+  int efd;
+  int peer_efd;
+
+  /* Socket of handshake */
+  int sfd;
+
+  /* Record taken by shm_peek, released by shm_release */
+  uint32_t peeked;
+};
+
+int shm_offer(struct shm_channel* channel, int sfd);
+
+int shm_connect(struct shm_channel* channel, int sfd);
+
+char* shm_reserve(struct shm_channel* channel, uint32_t len);
+
+void shm_commit(struct shm_channel* channel, uint32_t len);
+
+char* shm_peek(struct shm_channel* channel, uint32_t* len);
+
+void shm_release(struct shm_channel* channel);
+
+void shm_close(struct shm_channel* channel);
+
+#endif // !SHM_H
@@ -0,0 +1,116 @@
+#include "../headers/histogram.h"
+
+/*
+ * histogram_index - used to find bucket of value. Values
+ * below HISTOGRAM_SUB_BUCKETS get their own buckets, others
+ * are placed by position of highest bit and next
+ * HISTOGRAM_SUB_BITS bits.
+ * @value - recorded value
+ *
+ * Return: index of bucket
+ */
+static int histogram_index(uint64_t value) {
+  if (value < HISTOGRAM_SUB_BUCKETS)
+    return value;
+
+  int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+
+  return ((shift + 1) << HISTOGRAM_SUB_BITS) + ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/*
+ * histogram_value - used to find largest value that
+ * falls into bucket.
+ * @index - index of bucket
+ *
+ * Return: upper bound of bucket
+ */
+static uint64_t histogram_value(int index) {
+  if (index < HISTOGRAM_SUB_BUCKETS)
+    return index;
+
+  int shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+  uint64_t sub = index & (HISTOGRAM_SUB_BUCKETS - 1);
+
+  return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/*
+ * init_histogram - used to initialize empty histogram.
+ * @histogram - pointer to an object of histogram struct
+ */
+void init_histogram(struct histogram* histogram) {
+  memset(histogram, 0, sizeof(struct histogram));
+  histogram->min = UINT64_MAX;
+}
+
+/*
+ * histogram_record - used to add value to histogram.
+ * Histogram has one writer, but other threads may merge
+ * it while values are recorded, so fields are stored
+ * atomically (plain stores on x86).
+ * @histogram - pointer to an object of histogram struct
+ * @value - recorded value
+ */
+void histogram_record(struct histogram* histogram, uint64_t value) {
+  int index = histogram_index(value);
+
+  __atomic_store_n(&histogram->counts[index], histogram->counts[index] + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&histogram->total, histogram->total + 1, __ATOMIC_RELAXED);
+
+  if (value < histogram->min)
+    __atomic_store_n(&histogram->min, value, __ATOMIC_RELAXED);
+  if (value > histogram->max)
+    __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+}
+
+/*
+ * histogram_merge - used to add values of other histogram,
+ * e.g. to combine histograms recorded by several threads.
+ * @histogram - pointer to destination histogram
+ * @other - pointer to merged histogram
+ */
+void histogram_merge(struct histogram* histogram, const struct histogram* other) {
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    histogram->counts[i] += __atomic_load_n(&other->counts[i], __ATOMIC_RELAXED);
+
+  histogram->total += __atomic_load_n(&other->total, __ATOMIC_RELAXED);
+
+  uint64_t min = __atomic_load_n(&other->min, __ATOMIC_RELAXED);
+  uint64_t max = __atomic_load_n(&other->max, __ATOMIC_RELAXED);
+
+  if (min < histogram->min)
+    histogram->min = min;
+  if (max > histogram->max)
+    histogram->max = max;
+}
+
+/*
+ * histogram_percentile - used to find value that given
+ * percent of recorded values don't exceed. Result is upper
+ * bound of the bucket, clamped by largest recorded value.
+ * @histogram - pointer to an object of histogram struct
+ * @percentile - percent of values (0 - 100)
+ *
+ * Return: value at percentile, 0 if histogram is empty
+ */
+uint64_t histogram_percentile(const struct histogram* histogram, double percentile) {
+  if (histogram->total == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t) (percentile / 100.0 * histogram->total + 0.5);
+  uint64_t seen = 0;
+
+  if (rank < 1)
+    rank = 1;
+
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->counts[i];
+    if (seen >= rank) {
+      uint64_t value = histogram_value(i);
+      return value < histogram->max ? value : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
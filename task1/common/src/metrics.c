@@ -0,0 +1,166 @@
+#include "../headers/metrics.h"
+#include <time.h>
+
+const char* metric_counter_names[METRIC_COUNTERS] = {
+  "accepted", "closed", "messages_in", "messages_out", "bytes_in", "bytes_out"
+};
+
+const char* metric_stage_names[METRIC_STAGES] = {"accept", "recv", "transform", "send"};
+
+/* Metrics of current thread */
+static __thread struct metrics* metrics;
+
+/* Key that retires metrics when their thread exits */
+static pthread_key_t metrics_key;
+static pthread_once_t metrics_once = PTHREAD_ONCE_INIT;
+
+/* Metrics of running threads and sum of finished ones */
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct metrics* metrics_list;
+static struct metrics_snapshot metrics_retired;
+
+/*
+ * release_metrics - used as destructor of thread metrics.
+ * Adds them to metrics of finished threads.
+ * @arg - pointer to an object of metrics struct
+ */
+static void release_metrics(void* arg) {
+  struct metrics* thread_metrics = (struct metrics*) arg;
+
+  pthread_mutex_lock(&metrics_lock);
+  for (int i = 0; i < METRIC_COUNTERS; i++)
+    metrics_retired.counters[i] += thread_metrics->counters[i];
+  for (int i = 0; i < METRIC_STAGES; i++)
+    histogram_merge(&metrics_retired.latency[i], &thread_metrics->latency[i]);
+
+  if (thread_metrics->prev)
+    thread_metrics->prev->next = thread_metrics->next;
+  else
+    metrics_list = thread_metrics->next;
+  if (thread_metrics->next)
+    thread_metrics->next->prev = thread_metrics->prev;
+  pthread_mutex_unlock(&metrics_lock);
+
+  free(thread_metrics);
+  metrics = NULL;
+}
+
+/*
+ * create_key - used once to create key of thread metrics
+ * and initialize histograms of finished threads.
+ */
+static void create_key(void) {
+  for (int i = 0; i < METRIC_STAGES; i++)
+    init_histogram(&metrics_retired.latency[i]);
+
+  if (pthread_key_create(&metrics_key, release_metrics) != 0)
+    print_error("pthread_key_create");
+}
+
+/*
+ * get_metrics - used to get metrics of current thread,
+ * creates them on first use.
+ *
+ * Return: pointer to an object of metrics struct
+ */
+static struct metrics* get_metrics(void) {
+  if (metrics)
+    return metrics;
+
+  pthread_once(&metrics_once, create_key);
+
+  struct metrics* thread_metrics = (struct metrics*) aligned_alloc(CACHE_LINE_SIZE, sizeof(struct metrics));
+  if (!thread_metrics)
+    print_error("aligned_alloc");
+  memset(thread_metrics, 0, sizeof(struct metrics));
+  for (int i = 0; i < METRIC_STAGES; i++)
+    init_histogram(&thread_metrics->latency[i]);
+
+  pthread_mutex_lock(&metrics_lock);
+  thread_metrics->next = metrics_list;
+  if (metrics_list)
+    metrics_list->prev = thread_metrics;
+  metrics_list = thread_metrics;
+  pthread_mutex_unlock(&metrics_lock);
+
+  pthread_setspecific(metrics_key, thread_metrics);
+  metrics = thread_metrics;
+
+  return thread_metrics;
+}
+
+/*
+ * metrics_now - used to get time for latencies.
+ *
+ * Return: monotonic time in nanoseconds
+ */
+uint64_t metrics_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * metrics_add - used to increase counter of current thread.
+ * @counter - counter that needs to be increased
+ * @value - amount added to counter
+ */
+void metrics_add(enum metric_counter counter, uint64_t value) {
+  struct metrics* thread_metrics = get_metrics();
+
+  __atomic_store_n(&thread_metrics->counters[counter], thread_metrics->counters[counter] + value,
+                   __ATOMIC_RELAXED);
+}
+
+/*
+ * metrics_add_bytes - used to count bytes of connection,
+ * both in counter of current thread and in counter of
+ * client that is read by admin socket.
+ * @counter - METRIC_BYTES_IN or METRIC_BYTES_OUT
+ * @client_bytes - counter of client, written by current thread only
+ * @value - amount of bytes
+ */
+void metrics_add_bytes(enum metric_counter counter, uint64_t* client_bytes, uint64_t value) {
+  metrics_add(counter, value);
+  __atomic_store_n(client_bytes, *client_bytes + value, __ATOMIC_RELAXED);
+}
+
+/*
+ * metrics_record - used to record latency of stage that
+ * started at given time. Returned time can be used as
+ * start of next stage.
+ * @stage - stage that finished
+ * @start - time stage started (metrics_now)
+ *
+ * Return: current time
+ */
+uint64_t metrics_record(enum metric_stage stage, uint64_t start) {
+  uint64_t now = metrics_now();
+
+  histogram_record(&get_metrics()->latency[stage], now - start);
+
+  return now;
+}
+
+/*
+ * metrics_get_snapshot - used to sum metrics of all
+ * threads, including finished ones. Running threads
+ * keep updating them, so snapshot is approximate.
+ * @snapshot - pointer where sum is stored
+ */
+void metrics_get_snapshot(struct metrics_snapshot* snapshot) {
+  pthread_once(&metrics_once, create_key);
+
+  pthread_mutex_lock(&metrics_lock);
+  *snapshot = metrics_retired;
+
+  for (struct metrics* thread_metrics = metrics_list; thread_metrics; thread_metrics = thread_metrics->next) {
+    for (int i = 0; i < METRIC_COUNTERS; i++)
+      snapshot->counters[i] += __atomic_load_n(&thread_metrics->counters[i], __ATOMIC_RELAXED);
+    for (int i = 0; i < METRIC_STAGES; i++)
+      histogram_merge(&snapshot->latency[i], &thread_metrics->latency[i]);
+  }
+  pthread_mutex_unlock(&metrics_lock);
+}
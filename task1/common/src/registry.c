@@ -0,0 +1,191 @@
+#include "../headers/registry.h"
+
+/*
+ * registry_slot - used to find slot by its index.
+ * @registry - pointer to an object of registry struct
+ * @index - index of slot
+ *
+ * Return: pointer to slot
+ */
+static struct registry_slot* registry_slot(struct registry* registry, uint32_t index) {
+  return &registry->chunks[index >> REGISTRY_CHUNK_SHIFT][index & (REGISTRY_CHUNK_SIZE - 1)];
+}
+
+/*
+ * grow_registry - used to add chunk of free slots. Slots
+ * are linked in order, so lower ones are taken first.
+ * @registry - pointer to an object of registry struct
+ */
+static void grow_registry(struct registry* registry) {
+  if (registry->chunks_amount == REGISTRY_MAX_CHUNKS) {
+    fprintf(stderr, "registry: more than %d items\n", REGISTRY_MAX_CHUNKS * REGISTRY_CHUNK_SIZE);
+    exit(EXIT_FAILURE);
+  }
+
+  struct registry_slot* chunk = (struct registry_slot*) calloc(REGISTRY_CHUNK_SIZE, sizeof(struct registry_slot));
+  if (!chunk)
+    print_error("calloc");
+
+  uint32_t first = registry->chunks_amount << REGISTRY_CHUNK_SHIFT;
+
+  for (uint32_t i = 0; i < REGISTRY_CHUNK_SIZE - 1; i++)
+    chunk[i].next_free = first + i + 1;
+  chunk[REGISTRY_CHUNK_SIZE - 1].next_free = registry->free_head;
+
+  registry->chunks[registry->chunks_amount++] = chunk;
+  registry->free_head = first;
+}
+
+/*
+ * init_registry - used to initialize empty registry.
+ * Slots are allocated on first insert.
+ * @registry - pointer to an object of registry struct
+ */
+void init_registry(struct registry* registry) {
+  registry->chunks_amount = 0;
+  registry->free_head = REGISTRY_NONE;
+  registry->amount = 0;
+  pthread_mutex_init(&registry->lock, NULL);
+}
+
+/*
+ * registry_insert - used to put item into free slot.
+ * @registry - pointer to an object of registry struct
+ * @item - item that needs to be registered (not NULL)
+ *
+ * Return: id of item, generation in high half and index of slot in low half
+ */
+uint64_t registry_insert(struct registry* registry, void* item) {
+  pthread_mutex_lock(&registry->lock);
+
+  if (registry->free_head == REGISTRY_NONE)
+    grow_registry(registry);
+
+  uint32_t index = registry->free_head;
+  struct registry_slot* slot = registry_slot(registry, index);
+
+  registry->free_head = slot->next_free;
+  slot->item = item;
+  __atomic_store_n(&registry->amount, registry->amount + 1, __ATOMIC_RELAXED);
+
+  uint64_t id = ((uint64_t) slot->generation << 32) | index;
+  pthread_mutex_unlock(&registry->lock);
+
+  return id;
+}
+
+/*
+ * registry_get - used to find item by its id.
+ * @registry - pointer to an object of registry struct
+ * @id - id returned by registry_insert
+ *
+ * Return: item, NULL if it was removed
+ */
+void* registry_get(struct registry* registry, uint64_t id) {
+  uint32_t index = (uint32_t) id;
+  void* item = NULL;
+
+  pthread_mutex_lock(&registry->lock);
+  if (index < registry->chunks_amount << REGISTRY_CHUNK_SHIFT) {
+    struct registry_slot* slot = registry_slot(registry, index);
+
+    if (slot->item && slot->generation == (uint32_t) (id >> 32))
+      item = slot->item;
+  }
+  pthread_mutex_unlock(&registry->lock);
+
+  return item;
+}
+
+/*
+ * registry_remove - used to free slot of item. Stale ids
+ * are ignored.
+ * @registry - pointer to an object of registry struct
+ * @id - id returned by registry_insert
+ */
+void registry_remove(struct registry* registry, uint64_t id) {
+  uint32_t index = (uint32_t) id;
+
+  pthread_mutex_lock(&registry->lock);
+  if (index < registry->chunks_amount << REGISTRY_CHUNK_SHIFT) {
+    struct registry_slot* slot = registry_slot(registry, index);
+
+    if (slot->item && slot->generation == (uint32_t) (id >> 32)) {
+      slot->item = NULL;
+      slot->generation++;
+      slot->next_free = registry->free_head;
+      registry->free_head = index;
+      __atomic_store_n(&registry->amount, registry->amount - 1, __ATOMIC_RELAXED);
+    }
+  }
+  pthread_mutex_unlock(&registry->lock);
+}
+
+/*
+ * registry_size - used to get amount of items without
+ * taking lock.
+ * @registry - pointer to an object of registry struct
+ *
+ * Return: amount of registered items
+ */
+uint32_t registry_size(struct registry* registry) {
+  return __atomic_load_n(&registry->amount, __ATOMIC_RELAXED);
+}
+
+/*
+ * registry_next - used to walk items when they may be
+ * removed between steps, e.g. to close all of them.
+ * @registry - pointer to an object of registry struct
+ * @index - slot to start from (0 at first call), moved past found item
+ *
+ * Return: next item, NULL if there are no more
+ */
+void* registry_next(struct registry* registry, uint32_t* index) {
+  void* item = NULL;
+
+  pthread_mutex_lock(&registry->lock);
+  uint32_t capacity = registry->chunks_amount << REGISTRY_CHUNK_SHIFT;
+
+  for (; *index < capacity && !item; (*index)++)
+    item = registry_slot(registry, *index)->item;
+  pthread_mutex_unlock(&registry->lock);
+
+  return item;
+}
+
+/*
+ * registry_foreach - used to call function for every item.
+ * Lock is held during the walk, so items can't be removed
+ * (and freed by their owner) while callback reads them.
+ * Callback must not insert or remove items.
+ * @registry - pointer to an object of registry struct
+ * @callback - function called with item and arg
+ * @arg - argument of callback
+ */
+void registry_foreach(struct registry* registry, void (*callback)(void* item, void* arg), void* arg) {
+  pthread_mutex_lock(&registry->lock);
+
+  for (uint32_t i = 0; i < registry->chunks_amount; i++) {
+    for (uint32_t j = 0; j < REGISTRY_CHUNK_SIZE; j++) {
+      if (registry->chunks[i][j].item)
+        callback(registry->chunks[i][j].item, arg);
+    }
+  }
+
+  pthread_mutex_unlock(&registry->lock);
+}
+
+/*
+ * free_registry - used to free slots of registry. Items
+ * are owned by caller.
+ * @registry - pointer to an object of registry struct
+ */
+void free_registry(struct registry* registry) {
+  for (uint32_t i = 0; i < registry->chunks_amount; i++)
+    free(registry->chunks[i]);
+
+  registry->chunks_amount = 0;
+  registry->free_head = REGISTRY_NONE;
+  registry->amount = 0;
+  pthread_mutex_destroy(&registry->lock);
+}
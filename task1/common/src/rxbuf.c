@@ -0,0 +1,46 @@
+#include "../headers/rxbuf.h"
+
+/*
+ * rxbuf_alloc - used to allocate empty block from pool.
+ * Block has no references until decoder takes it.
+ * @size - amount of bytes block can receive
+ *
+ * Return: pointer to an object of rxbuf struct
+ */
+struct rxbuf* rxbuf_alloc(uint32_t size) {
+  struct rxbuf* rxbuf = (struct rxbuf*) pool_alloc(sizeof(struct rxbuf) + size);
+
+  rxbuf->data = rxbuf->storage;
+  rxbuf->len = 0;
+  rxbuf->size = size;
+  rxbuf->refs = 0;
+  rxbuf->id = 0;
+  rxbuf->owner = NULL;
+  rxbuf->release = NULL;
+  rxbuf->next = NULL;
+
+  return rxbuf;
+}
+
+/*
+ * rxbuf_get - used to take reference to block.
+ * @rxbuf - pointer to an object of rxbuf struct
+ */
+void rxbuf_get(struct rxbuf* rxbuf) {
+  rxbuf->refs++;
+}
+
+/*
+ * rxbuf_put - used to drop reference to block. Last
+ * reference frees pooled block or releases it to owner.
+ * @rxbuf - pointer to an object of rxbuf struct
+ */
+void rxbuf_put(struct rxbuf* rxbuf) {
+  if (--rxbuf->refs > 0)
+    return;
+
+  if (rxbuf->release)
+    rxbuf->release(rxbuf);
+  else
+    pool_free(rxbuf);
+}
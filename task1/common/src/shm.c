@@ -0,0 +1,312 @@
+#include "../headers/shm.h"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+/*
+ * shm_wake - used to signal other side if it sleeps on
+ * given flag. Position that other side waits for must be
+ * published before.
+ * @channel - pointer to an object of shm_channel struct
+ * @flag - flag other side sets before sleeping
+ */
+static void shm_wake(struct shm_channel* channel, uint32_t* flag) {
+  /* Pairs with fence of shm_wait: either it sees new position or we see flag */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(flag, __ATOMIC_RELAXED))
+    eventfd_write(channel->peer_efd, 1);
+}
+
+/*
+ * shm_wait - used to wait until position written by other
+ * side changes. Position is checked a few times first, then
+ * side sets its flag and sleeps on eventfd. Socket of handshake
+ * is watched too, it becomes readable when other side is gone.
+ * @channel - pointer to an object of shm_channel struct
+ * @flag - flag of this side in ring
+ * @position - position written by other side
+ * @value - last seen value of position
+ *
+ * Return: 0 when position may have changed, -1 if other side is gone
+ */
+static int shm_wait(struct shm_channel* channel, uint32_t* flag, uint64_t* position, uint64_t value) {
+  struct pollfd fds[2];
+
+  for (int i = 0; i < SHM_SPINS; i++) {
+    if (__atomic_load_n(position, __ATOMIC_ACQUIRE) != value)
+      return 0;
+  }
+
+  __atomic_store_n(flag, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(position, __ATOMIC_ACQUIRE) == value) {
+    fds[0].fd = channel->efd;
+    fds[0].events = POLLIN;
+    fds[1].fd = channel->sfd;
+    fds[1].events = POLLIN;
+
+    while (poll(fds, 2, -1) == -1) {
+      if (errno != EINTR)
+        return -1;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      eventfd_t count;
+      eventfd_read(channel->efd, &count);
+    }
+    if (fds[1].revents) {
+      __atomic_store_n(flag, 0, __ATOMIC_RELAXED);
+      return -1;
+    }
+  }
+
+  __atomic_store_n(flag, 0, __ATOMIC_RELAXED);
+
+  return 0;
+}
+
+/*
+ * shm_map - used to map shared memory of transport and
+ * set rings of the side.
+ * @channel - pointer to an object of shm_channel struct
+ * @fd - memfd of shared memory
+ * @server - 1 for server side, 0 for client side
+ *
+ * Return: 0 on success, -1 on error
+ */
+static int shm_map(struct shm_channel* channel, int fd, int server) {
+  void* region = mmap(NULL, sizeof(struct shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (region == MAP_FAILED)
+    return -1;
+
+  channel->region = (struct shm_region*) region;
+  channel->in = server ? &channel->region->requests : &channel->region->replies;
+  channel->out = server ? &channel->region->replies : &channel->region->requests;
+  channel->peeked = 0;
+
+  return 0;
+}
+
+/*
+ * shm_offer - used by server to answer handshake. Creates
+ * shared memory with both rings and eventfds of both sides
+ * and passes them to client with SCM_RIGHTS.
+ * @channel - pointer to an object of shm_channel struct
+ * @sfd - socket of the client
+ *
+ * Return: 0 on success, -1 on error
+ */
+int shm_offer(struct shm_channel* channel, int sfd) {
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  uint32_t size = sizeof(struct shm_region);
+  struct msghdr msg;
+  struct iovec iov;
+  int fds[3];
+
+  channel->sfd = sfd;
+  channel->efd = eventfd(0, EFD_CLOEXEC);
+  channel->peer_efd = eventfd(0, EFD_CLOEXEC);
+  fds[0] = memfd_create("shm_transport", MFD_CLOEXEC);
+
+  if (channel->efd == -1 || channel->peer_efd == -1 || fds[0] == -1 ||
+      ftruncate(fds[0], sizeof(struct shm_region)) == -1 || shm_map(channel, fds[0], 1) == -1) {
+    if (fds[0] != -1)
+      close(fds[0]);
+    return -1;
+  }
+
+  /* Client sleeps on peer eventfd and signals ours */
+  fds[1] = channel->peer_efd;
+  fds[2] = channel->efd;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(control, 0, sizeof(control));
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  ssize_t bytes_sent = sendmsg(sfd, &msg, MSG_NOSIGNAL);
+  close(fds[0]);
+
+  return bytes_sent == sizeof(size) ? 0 : -1;
+}
+
+/*
+ * shm_connect - used by client to ask connected server for
+ * shared memory transport and map memory it passes back.
+ * @channel - pointer to an object of shm_channel struct
+ * @sfd - socket connected to server
+ *
+ * Return: 0 on success, -1 on error (server doesn't support transport)
+ */
+int shm_connect(struct shm_channel* channel, int sfd) {
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  uint32_t handshake = htonl(SHM_HANDSHAKE);
+  uint32_t size;
+  struct msghdr msg;
+  struct iovec iov;
+  int fds[3];
+
+  if (send(sfd, &handshake, sizeof(handshake), MSG_NOSIGNAL) != sizeof(handshake))
+    return -1;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &size;
+  iov.iov_len = sizeof(size);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t bytes_read = recvmsg(sfd, &msg, MSG_CMSG_CLOEXEC);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+
+  /* Server closed connection or has other layout of memory */
+  if (bytes_read != sizeof(size) || size != sizeof(struct shm_region) || !cmsg ||
+      cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    errno = EPROTONOSUPPORT;
+    return -1;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  channel->sfd = sfd;
+  channel->efd = fds[1];
+  channel->peer_efd = fds[2];
+
+  int mapped = shm_map(channel, fds[0], 0);
+  close(fds[0]);
+
+  return mapped;
+}
+
+/*
+ * shm_reserve - used to get space for record in outgoing
+ * ring. Waits while ring is full. Record becomes visible
+ * to other side only after shm_commit.
+ * @channel - pointer to an object of shm_channel struct
+ * @len - length of payload (up to SHM_MAX_MESSAGE)
+ *
+ * Return: pointer where payload is written, NULL if other side is gone
+ */
+char* shm_reserve(struct shm_channel* channel, uint32_t len) {
+  struct shm_ring* ring = channel->out;
+  uint64_t tail = ring->tail;
+  uint64_t offset = tail & (SHM_RING_SIZE - 1);
+  uint64_t contiguous = SHM_RING_SIZE - offset;
+  uint64_t need = SHM_RECORD_SIZE(len);
+
+  /* Record doesn't fit before ring end, skip to ring start */
+  if (contiguous < need)
+    need += contiguous;
+
+  while (1) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (SHM_RING_SIZE - (tail - head) >= need)
+      break;
+    if (shm_wait(channel, &ring->writer_waiting, &ring->head, head) == -1)
+      return NULL;
+  }
+
+  if (contiguous < SHM_RECORD_SIZE(len)) {
+    *(uint32_t*) (ring->data + offset) = SHM_WRAP;
+    __atomic_store_n(&ring->tail, tail + contiguous, __ATOMIC_RELEASE);
+    offset = 0;
+  }
+
+  *(uint32_t*) (ring->data + offset) = len;
+
+  return ring->data + offset + sizeof(uint32_t);
+}
+
+/*
+ * shm_commit - used to publish record written after
+ * shm_reserve and wake other side if it sleeps.
+ * @channel - pointer to an object of shm_channel struct
+ * @len - length of payload, the same as in shm_reserve
+ */
+void shm_commit(struct shm_channel* channel, uint32_t len) {
+  struct shm_ring* ring = channel->out;
+
+  __atomic_store_n(&ring->tail, ring->tail + SHM_RECORD_SIZE(len), __ATOMIC_RELEASE);
+  shm_wake(channel, &ring->reader_waiting);
+}
+
+/*
+ * shm_peek - used to take next record of incoming ring.
+ * Waits while ring is empty. Payload stays in ring until
+ * shm_release.
+ * @channel - pointer to an object of shm_channel struct
+ * @len - pointer where length of payload is stored
+ *
+ * Return: pointer to payload, NULL if other side is gone
+ */
+char* shm_peek(struct shm_channel* channel, uint32_t* len) {
+  struct shm_ring* ring = channel->in;
+
+  while (1) {
+    uint64_t head = ring->head;
+    uint64_t offset = head & (SHM_RING_SIZE - 1);
+
+    if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head) {
+      if (shm_wait(channel, &ring->reader_waiting, &ring->tail, head) == -1)
+        return NULL;
+      continue;
+    }
+
+    uint32_t record_len = *(uint32_t*) (ring->data + offset);
+
+    /* Writer continued from ring start */
+    if (record_len == SHM_WRAP) {
+      __atomic_store_n(&ring->head, head + SHM_RING_SIZE - offset, __ATOMIC_RELEASE);
+      shm_wake(channel, &ring->writer_waiting);
+      continue;
+    }
+
+    *len = record_len;
+    channel->peeked = record_len;
+
+    return ring->data + offset + sizeof(uint32_t);
+  }
+}
+
+/*
+ * shm_release - used to free record taken by shm_peek and
+ * wake other side if it waits for space.
+ * @channel - pointer to an object of shm_channel struct
+ */
+void shm_release(struct shm_channel* channel) {
+  struct shm_ring* ring = channel->in;
+
+  __atomic_store_n(&ring->head, ring->head + SHM_RECORD_SIZE(channel->peeked), __ATOMIC_RELEASE);
+  shm_wake(channel, &ring->writer_waiting);
+}
+
+/*
+ * shm_close - used to unmap shared memory and close
+ * eventfds. Socket of handshake is closed by its owner.
+ * @channel - pointer to an object of shm_channel struct
+ */
+void shm_close(struct shm_channel* channel) {
+  if (channel->region)
+    munmap(channel->region, sizeof(struct shm_region));
+  if (channel->efd != -1)
+    close(channel->efd);
+  if (channel->peer_efd != -1)
+    close(channel->peer_efd);
+
+  channel->region = NULL;
+  channel->efd = -1;
+  channel->peer_efd = -1;
+}
@@ -0,0 +1,163 @@
+#include "../headers/timer_wheel.h"
+
+/*
+ * init_timer_wheel - used to initialize empty wheel.
+ * @wheel - pointer to an object of timer_wheel struct
+ * @now - current time (metrics_now clock)
+ */
+void init_timer_wheel(struct timer_wheel* wheel, uint64_t now) {
+  for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+    wheel->slots[i].prev = &wheel->slots[i];
+    wheel->slots[i].next = &wheel->slots[i];
+  }
+
+  wheel->tick = now / TIMER_TICK_NS;
+  wheel->amount = 0;
+}
+
+/*
+ * init_timer - used to initialize timer that isn't armed.
+ * @timer - pointer to an object of timer struct
+ * @item - owner of the timer
+ */
+void init_timer(struct timer* timer, void* item) {
+  timer->prev = NULL;
+  timer->next = NULL;
+  timer->deadline = 0;
+  timer->item = item;
+}
+
+/*
+ * timer_armed - used to check if timer is in the wheel.
+ * @timer - pointer to an object of timer struct
+ *
+ * Return: 1 if timer is armed, 0 otherwise
+ */
+int timer_armed(struct timer* timer) {
+  return timer->prev != NULL;
+}
+
+/*
+ * timer_wheel_add - used to arm timer, timer that is
+ * already armed is moved to new deadline. Deadline in the
+ * past expires on next tick.
+ * @wheel - pointer to an object of timer_wheel struct
+ * @timer - pointer to an object of timer struct
+ * @deadline - time timer expires at (metrics_now clock)
+ */
+void timer_wheel_add(struct timer_wheel* wheel, struct timer* timer, uint64_t deadline) {
+  uint64_t tick = (deadline + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+
+  if (timer_armed(timer))
+    timer_wheel_remove(wheel, timer);
+
+  if (tick <= wheel->tick)
+    tick = wheel->tick + 1;
+
+  /* Insert at head, so timer re-armed by expire callback isn't met again */
+  struct timer* slot = &wheel->slots[tick & (TIMER_WHEEL_SLOTS - 1)];
+  timer->deadline = deadline;
+  timer->prev = slot;
+  timer->next = slot->next;
+  slot->next->prev = timer;
+  slot->next = timer;
+  wheel->amount++;
+}
+
+/*
+ * timer_wheel_shorten - used to arm timer only if it isn't
+ * armed or expires later than given deadline. Owners that
+ * check their state on expiry call it when deadline gets
+ * nearer and leave timer alone when it moves away.
+ * @wheel - pointer to an object of timer_wheel struct
+ * @timer - pointer to an object of timer struct
+ * @deadline - time timer must expire at or before
+ */
+void timer_wheel_shorten(struct timer_wheel* wheel, struct timer* timer, uint64_t deadline) {
+  if (!timer_armed(timer) || deadline < timer->deadline)
+    timer_wheel_add(wheel, timer, deadline);
+}
+
+/*
+ * timer_wheel_remove - used to disarm timer. Timer that
+ * isn't armed is left as is.
+ * @wheel - pointer to an object of timer_wheel struct
+ * @timer - pointer to an object of timer struct
+ */
+void timer_wheel_remove(struct timer_wheel* wheel, struct timer* timer) {
+  if (!timer_armed(timer))
+    return;
+
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+  wheel->amount--;
+}
+
+/*
+ * timer_wheel_timeout - used to get how long event loop
+ * may sleep. Slots are checked from next tick, first slot
+ * that holds any timer ends the sleep (its timers may be
+ * due only on later turns).
+ * @wheel - pointer to an object of timer_wheel struct
+ * @now - current time (metrics_now clock)
+ *
+ * Return: milliseconds until next tick with timers, -1 if
+ * no timer is armed
+ */
+int timer_wheel_timeout(struct timer_wheel* wheel, uint64_t now) {
+  if (wheel->amount == 0)
+    return -1;
+
+  for (uint64_t tick = wheel->tick + 1; tick <= wheel->tick + TIMER_WHEEL_SLOTS; tick++) {
+    struct timer* slot = &wheel->slots[tick & (TIMER_WHEEL_SLOTS - 1)];
+
+    if (slot->next == slot)
+      continue;
+    if (tick * TIMER_TICK_NS <= now)
+      return 0;
+
+    return (tick * TIMER_TICK_NS - now + 999999) / 1000000;
+  }
+
+  return -1;
+}
+
+/*
+ * timer_wheel_advance - used to expire timers that are
+ * due. Slots of ticks passed since last call are walked
+ * once (whole wheel at most). Expired timer is disarmed
+ * before its callback, which may arm it again or free
+ * its owner.
+ * @wheel - pointer to an object of timer_wheel struct
+ * @now - current time (metrics_now clock)
+ * @expire - callback called with owner of every expired timer
+ * @arg - argument passed to callback
+ */
+void timer_wheel_advance(struct timer_wheel* wheel, uint64_t now, void (*expire)(void* item, void* arg), void* arg) {
+  uint64_t target = now / TIMER_TICK_NS;
+  uint64_t steps = target - wheel->tick;
+
+  if (target <= wheel->tick)
+    return;
+  if (steps > TIMER_WHEEL_SLOTS)
+    steps = TIMER_WHEEL_SLOTS;
+
+  for (uint64_t i = 1; i <= steps; i++) {
+    struct timer* slot = &wheel->slots[(wheel->tick + i) & (TIMER_WHEEL_SLOTS - 1)];
+    struct timer* timer = slot->next;
+
+    while (timer != slot) {
+      struct timer* next = timer->next;
+
+      if (timer->deadline <= target * TIMER_TICK_NS) {
+        timer_wheel_remove(wheel, timer);
+        expire(timer->item, arg);
+      }
+      timer = next;
+    }
+  }
+
+  wheel->tick = target;
+}
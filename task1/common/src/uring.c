@@ -0,0 +1,302 @@
+#include "../headers/uring.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * uring_init - used to create io_uring instance and map
+ * its rings. Completion queue is made four times bigger
+ * than submission queue, because multishot requests post
+ * several completions per submission.
+ * @ring - pointer to an object of uring struct
+ * @entries - size of submission queue
+ */
+void uring_init(struct uring* ring, unsigned entries) {
+  struct io_uring_params params;
+
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = entries * 4;
+
+  ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd == -1)
+    print_error("io_uring_setup");
+
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    errno = ENOSYS;
+    print_error("io_uring_setup");
+  }
+
+  /* Submission and completion rings share one mapping */
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->rings_size = sq_size > cq_size ? sq_size : cq_size;
+  ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->rings == MAP_FAILED)
+    print_error("mmap");
+
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+    print_error("mmap");
+
+  char* base = (char*) ring->rings;
+  ring->sq_entries = params.sq_entries;
+  ring->sq_head = (unsigned*) (base + params.sq_off.head);
+  ring->sq_tail = (unsigned*) (base + params.sq_off.tail);
+  ring->sq_mask = (unsigned*) (base + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*) (base + params.sq_off.array);
+  ring->sqe_tail = *ring->sq_tail;
+
+  ring->cq_head = (unsigned*) (base + params.cq_off.head);
+  ring->cq_tail = (unsigned*) (base + params.cq_off.tail);
+  ring->cq_mask = (unsigned*) (base + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*) (base + params.cq_off.cqes);
+
+  /* Entries are always taken in order, so array is identity */
+  for (unsigned i = 0; i < ring->sq_entries; i++)
+    ring->sq_array[i] = i;
+}
+
+/*
+ * uring_get_sqe - used to get next free submission entry.
+ * If submission queue is full, prepared entries are submitted
+ * first. Returned entry is zeroed.
+ * @ring - pointer to an object of uring struct
+ *
+ * Return: pointer to submission entry
+ */
+struct io_uring_sqe* uring_get_sqe(struct uring* ring) {
+  unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+  if (ring->sqe_tail - head >= ring->sq_entries) {
+    uring_submit(ring, 0);
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  }
+
+  struct io_uring_sqe* sqe = &ring->sqes[ring->sqe_tail & *ring->sq_mask];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sqe_tail++;
+
+  return sqe;
+}
+
+/*
+ * uring_submit - used to publish prepared entries and submit
+ * them with single system call. Optionally waits for completions.
+ * @ring - pointer to an object of uring struct
+ * @wait_nr - amount of completions to wait for
+ *
+ * Return: amount of submitted entries, -1 on error
+ */
+int uring_submit(struct uring* ring, unsigned wait_nr) {
+  unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+  unsigned to_submit;
+  int submitted;
+
+  __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+  to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+  do {
+    submitted = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr, flags, NULL, 0);
+  } while (submitted == -1 && errno == EINTR);
+
+  return submitted;
+}
+
+/*
+ * uring_submit_timeout - used to publish prepared entries and
+ * wait for completions at most given time, like epoll_wait.
+ * @ring - pointer to an object of uring struct
+ * @wait_nr - amount of completions to wait for
+ * @timeout - time to wait in milliseconds, -1 waits without limit
+ *
+ * Return: amount of submitted entries, -1 on error (expired
+ * wait is not an error)
+ */
+int uring_submit_timeout(struct uring* ring, unsigned wait_nr, int timeout) {
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  unsigned to_submit;
+  int submitted;
+
+  if (timeout < 0)
+    return uring_submit(ring, wait_nr);
+
+  ts.tv_sec = timeout / 1000;
+  ts.tv_nsec = (timeout % 1000) * 1000000ll;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = (uint64_t) (uintptr_t) &ts;
+
+  __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+  to_submit = ring->sqe_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+  do {
+    submitted = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr,
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+  } while (submitted == -1 && errno == EINTR);
+
+  if (submitted == -1 && errno == ETIME)
+    return 0;
+
+  return submitted;
+}
+
+/*
+ * uring_peek_cqe - used to get next completion without waiting.
+ * @ring - pointer to an object of uring struct
+ *
+ * Return: pointer to completion entry, NULL if queue is empty
+ */
+struct io_uring_cqe* uring_peek_cqe(struct uring* ring) {
+  unsigned head = *ring->cq_head;
+
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  return &ring->cqes[head & *ring->cq_mask];
+}
+
+/*
+ * uring_cqe_seen - used to return completion entry
+ * received by uring_peek_cqe to kernel.
+ * @ring - pointer to an object of uring struct
+ */
+void uring_cqe_seen(struct uring* ring) {
+  __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * uring_free - used to unmap rings and close io_uring instance.
+ * @ring - pointer to an object of uring struct
+ */
+void uring_free(struct uring* ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  munmap(ring->rings, ring->rings_size);
+  close(ring->fd);
+}
+
+/*
+ * uring_init_buffers - used to allocate buffers and register
+ * them as ring of provided buffers.
+ * @ring - pointer to an object of uring struct
+ * @buffers - pointer to an object of uring_buffers struct
+ * @entries - amount of buffers, must be power of two
+ * @buffer_size - size of each buffer
+ * @group - buffer group identifier used by requests
+ */
+void uring_init_buffers(struct uring* ring, struct uring_buffers* buffers, unsigned entries,
+                        size_t buffer_size, unsigned short group) {
+  struct io_uring_buf_reg reg;
+
+  buffers->entries = entries;
+  buffers->buffer_size = buffer_size;
+  buffers->group = group;
+
+  /* Ring must be page aligned */
+  buffers->ring_size = entries * sizeof(struct io_uring_buf);
+  buffers->ring = mmap(NULL, buffers->ring_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffers->ring == MAP_FAILED)
+    print_error("mmap");
+
+  buffers->data = (char*) malloc(entries * buffer_size);
+  if (!buffers->data)
+    print_error("malloc");
+
+  buffers->blocks = (struct rxbuf**) malloc(entries * sizeof(struct rxbuf*));
+  if (!buffers->blocks)
+    print_error("malloc");
+
+  for (unsigned i = 0; i < entries; i++) {
+    struct rxbuf* block = (struct rxbuf*) malloc(sizeof(struct rxbuf));
+    if (!block)
+      print_error("malloc");
+
+    memset(block, 0, sizeof(*block));
+    block->data = uring_buffer(buffers, i);
+    block->size = buffer_size;
+    block->id = i;
+    buffers->blocks[i] = block;
+  }
+
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t) (uintptr_t) buffers->ring;
+  reg.ring_entries = entries;
+  reg.bgid = group;
+  if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    print_error("io_uring_register");
+
+  /* Provide all buffers */
+  buffers->ring->tail = 0;
+  for (unsigned i = 0; i < entries; i++)
+    uring_recycle_buffer(buffers, i);
+}
+
+/*
+ * uring_buffer - used to get memory of buffer selected by kernel.
+ * @buffers - pointer to an object of uring_buffers struct
+ * @id - buffer identifier from completion flags
+ *
+ * Return: pointer to buffer
+ */
+char* uring_buffer(struct uring_buffers* buffers, unsigned short id) {
+  return buffers->data + (size_t) id * buffers->buffer_size;
+}
+
+/*
+ * uring_recycle_buffer - used to give buffer back to kernel
+ * after its data was processed.
+ * @buffers - pointer to an object of uring_buffers struct
+ * @id - buffer identifier
+ */
+void uring_recycle_buffer(struct uring_buffers* buffers, unsigned short id) {
+  unsigned short tail = buffers->ring->tail;
+  struct io_uring_buf* buf = &buffers->ring->bufs[tail & (buffers->entries - 1)];
+
+  buf->addr = (uint64_t) (uintptr_t) uring_buffer(buffers, id);
+  buf->len = buffers->buffer_size;
+  buf->bid = id;
+
+  __atomic_store_n(&buffers->ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * uring_take_buffer - used to get block of buffer selected
+ * by kernel. Caller sets owner and release callback of the
+ * block, which recycles buffer after last reference.
+ * @buffers - pointer to an object of uring_buffers struct
+ * @id - buffer identifier from completion flags
+ * @len - amount of received bytes
+ *
+ * Return: pointer to an object of rxbuf struct
+ */
+struct rxbuf* uring_take_buffer(struct uring_buffers* buffers, unsigned short id, uint32_t len) {
+  struct rxbuf* block = buffers->blocks[id];
+
+  block->len = len;
+  block->next = NULL;
+
+  return block;
+}
+
+/*
+ * uring_free_buffers - used to unregister ring of provided
+ * buffers and free its memory.
+ * @ring - pointer to an object of uring struct
+ * @buffers - pointer to an object of uring_buffers struct
+ */
+void uring_free_buffers(struct uring* ring, struct uring_buffers* buffers) {
+  struct io_uring_buf_reg reg;
+
+  memset(&reg, 0, sizeof(reg));
+  reg.bgid = buffers->group;
+  syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+  munmap(buffers->ring, buffers->ring_size);
+  for (unsigned i = 0; i < buffers->entries; i++)
+    free(buffers->blocks[i]);
+  free(buffers->blocks);
+  free(buffers->data);
+}
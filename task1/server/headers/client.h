@@ -2,15 +2,54 @@
 #define CLIENT_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/decoder.h"
+#include "../../common/headers/metrics.h"
+#include "../../common/headers/timer_wheel.h"
+
+/**
+ * Used as types of requests submitted to io_uring.
+ */
+enum uring_op_type {
+  OP_ACCEPT,
+  OP_RECV,
+  OP_SEND,
+  OP_CANCEL
+};
+
+/**
+ * Used as user data of io_uring requests to find
+ * request owner when its completion arrives.
+ */
+struct uring_op {
+  enum uring_op_type type;
+
+  /* Client that submitted request (NULL for accept) */
+  struct client* client;
+};
+
+/**
+ * Used as reply waiting to be sent. Queued replies of
+ * the client are sent in order by one gathered send.
+ */
+struct reply {
+  /* Length header, prefix and payload built in place */
+  struct msgbuf* message;
+
+  /* Next reply of the client */
+  struct reply* next;
+};
 
 /**
  * Used as data struct to specify clients
  * address, descriptor for communication and 
- * clients id (required for proper delete operations)
+ * clients id (key in servers clients registry)
  */
 struct client {
   /* Clients address */
-  struct sockaddr_un* addr;
+  struct sockaddr_un addr;
+
+  /* Path of the client for logs, "fd N" if its socket is unnamed */
+  char endpoint[sizeof(struct sockaddr_un)];
   
   /* Pointer to connected server */
   struct server* server;
@@ -22,7 +61,67 @@ struct client {
   int fd;
 
   /* Identifier of user */
-  int id;
+  uint64_t id;
+
+  /* Received bytes and frames that were not taken yet */
+  struct decoder decoder;
+
+  /* Replies that were not sent yet */
+  struct reply* replies;
+  struct reply* replies_tail;
+
+  /* Bytes of replies that were not sent yet */
+  size_t queued;
+
+  /* Bytes received and sent, written by clients thread only */
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+
+  /* Time bytes were last received or sent and time part of next
+     frame was received (0 if decoder holds no part of frame),
+     written by clients thread, read by timers */
+  uint64_t active_at;
+  uint64_t frame_at;
+
+  /* Expires client at nearest of its idle, read and write deadlines */
+  struct timer timer;
+
+  /* Time of connection (metrics_now) */
+  uint64_t connected_at;
+
+  /* io_uring: replies being sent, their gathered send request,
+     its length and amount of messages it completes */
+  struct reply* sending;
+  struct iovec* iov;
+  struct msghdr msg;
+  size_t sending_len;
+  int sending_count;
+  uint64_t sending_started;
+
+  /* io_uring: receive, send and cancel requests */
+  struct uring_op recv_op;
+  struct uring_op send_op;
+  struct uring_op cancel_op;
+
+  /* io_uring: multishot receive is armed */
+  int receiving;
+
+  /* io_uring: provided buffers held by decoder and replies */
+  int pinned;
+
+  /* io_uring: receive waits for provided buffers and next
+     client waiting for them */
+  int starved;
+  struct client* next_starved;
+
+  /* io_uring: receiving stopped until queued replies drain to
+     SEND_QUEUE_LOW and time of pause (metrics_now) */
+  int paused;
+  uint64_t paused_at;
+
+  /* io_uring: amount of requests in flight and close flag */
+  int inflight;
+  int closing;
 };
 
 #endif // !CLIENT_H
@@ -2,8 +2,24 @@
 #define SERVER_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/admin.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/registry.h"
+#include "../../common/headers/uring.h"
+#include "../../common/headers/timer_wheel.h"
 #include "client.h"
 
+/**
+ * Used as IO engines that server can run on.
+ */
+enum backend {
+  /* Blocking sockets, thread per client */
+  BACKEND_THREADS,
+
+  /* Multishot accept/receive and gathered sends on io_uring */
+  BACKEND_URING
+};
+
 /**
  * Used to create server on local adress family (AF_LOCAL) with
  * TCP protocol. 
@@ -12,34 +28,77 @@ struct server {
   /* Address of the server */
   struct sockaddr_un serv;
   
-  /* Array of pointers to clients */
-  struct client** clients;
-  int clients_amount;
+  /* Clients of the server, shared with their threads and admin socket */
+  struct registry clients;
 
   /* Passive socket to accept connecitons */
   int sfd;
+
+  /* IO engine of the server */
+  enum backend backend;
+
+  /* Max allowed length of message from client */
+  uint32_t max_frame;
+
+  /* io_uring instance, provided buffers and multishot accept request */
+  struct uring ring;
+  struct uring_buffers buffers;
+  struct uring_op accept_op;
+
+  /* Provided buffers held by clients and clients whose
+     receive ran out of them */
+  unsigned pinned;
+  struct client* starved;
+
+  /* Deadlines of clients and time they were last advanced to */
+  struct timer_wheel timers;
+  uint64_t now;
+
+  /* Threads: timers are shared with thread that expires them,
+     it sleeps until wake_at unless nearer deadline is armed */
+  pthread_mutex_t timers_lock;
+  pthread_cond_t timers_wake;
+  pthread_t timers_thread;
+  uint64_t wake_at;
+
+  /* Socket that answers with metrics and clients table */
+  struct admin admin;
 };
 
-struct server* create_server(const char* path);
+struct server* create_server(const char* path, enum backend backend, uint32_t max_frame);
 
 void run_server(struct server* server);
 
 void* handle_client_connection(void* arg);
 
-void add_client(struct server* server, struct sockaddr_un* client, int client_fd);
+struct client* add_client(struct server* server, struct sockaddr_un* client_addr, int client_fd);
 
 void delete_client(struct server* server, struct client* client);
 
-void send_message(struct client* client, char buffer[BUFFER_SIZE]);
+void arm_client_timer(struct client* client);
+
+void track_partial_frame(struct client* client, uint64_t now);
+
+void expire_clients(struct server* server);
+
+void* run_timers(void* arg);
 
-char* recv_message(struct client* client);
+void queue_reply(struct client* client, struct msgbuf* message);
 
-char* edit_message(char* message);
+int send_message(struct client* client);
+
+struct msgbuf* recv_message(struct client* client);
+
+void edit_message(struct msgbuf* message);
 
 void shutdown_connection(struct client* client);
 
 void close_connection(struct client *client);
 
+void free_replies(struct reply* replies);
+
+int collect_clients(void* arg, struct admin_client** clients);
+
 void free_server(struct server* server);
 
 #endif // !SERVER_H
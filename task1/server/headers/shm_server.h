@@ -0,0 +1,11 @@
+#ifndef SHM_SERVER_H
+#define SHM_SERVER_H
+
+#include "server.h"
+#include "../../common/headers/shm.h"
+
+int is_shm_handshake(struct client* client);
+
+void serve_shm_client(struct client* client);
+
+#endif // !SHM_SERVER_H
@@ -4,8 +4,49 @@ struct server* server;
 
 void cleanup();
 
-int main(void) {
-  server = create_server(SOCK_PATH);
+/*
+ * Usage: server [-b threads|uring] [-f max_frame]
+ * -b - IO engine of the server (thread per client by default)
+ * -f - max allowed length of message in bytes, messages
+ *      longer than STREAM_CHUNK_SIZE are passed through
+ *      in chunks, so limit doesn't cost memory
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  enum backend backend = BACKEND_THREADS;
+  uint32_t max_frame = MAX_FRAME_SIZE;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:f:")) != -1) {
+    switch (opt) {
+      case 'b':
+        if (strcmp(optarg, "uring") == 0)
+          backend = BACKEND_URING;
+        else if (strcmp(optarg, "threads") == 0)
+          backend = BACKEND_THREADS;
+        else {
+          fprintf(stderr, "Unknown backend: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'f':
+        /* Length header of reply holds prefix too */
+        if (strtoull(optarg, NULL, 10) > UINT32_MAX - PREFIX_LEN) {
+          fprintf(stderr, "Max frame must be in range 0..%lu\n", UINT32_MAX - PREFIX_LEN);
+          exit(EXIT_FAILURE);
+        }
+        max_frame = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-b threads|uring] [-f max_frame]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  server = create_server(SOCK_PATH, backend, max_frame);
   atexit(cleanup);
   run_server(server); 
   exit(EXIT_SUCCESS);
@@ -1,4 +1,6 @@
 #include "../headers/server.h"
+#include "../headers/uring_server.h"
+#include "../headers/shm_server.h"
 #include <netinet/in.h>
 #include <sys/socket.h>
 
@@ -6,10 +8,12 @@
  * create_server - used to create an object of server
  * struct, initializes its fields.
  * @path - path to socket file
+ * @backend - IO engine of the server
+ * @max_frame - max allowed length of message from client
  *
  * Return: pointer to an object of server struct 
  */
-struct server* create_server(const char* path) {
+struct server* create_server(const char* path, enum backend backend, uint32_t max_frame) {
   struct server* server = (struct server*) malloc(sizeof(struct server));
   if (!server)
     print_error("malloc");
@@ -18,11 +22,25 @@ struct server* create_server(const char* path) {
   server->serv.sun_family = AF_LOCAL;
   strncpy(server->serv.sun_path, path, sizeof(server->serv.sun_path) - 1);
   
-  /* Initialize clients array */
-  server->clients_amount = 0;
-  server->clients = (struct client**) malloc(CLIENTS_AMOUNT * sizeof(struct client*));
-  if (!server->clients)
-    print_error("malloc");
+  server->backend = backend;
+  server->max_frame = max_frame;
+  server->ring.fd = -1;
+  server->pinned = 0;
+  server->starved = NULL;
+
+  /* Timers thread sleeps on monotonic clock, the same as metrics_now */
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&server->timers_wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&server->timers_lock, NULL);
+  server->now = metrics_now();
+  server->wake_at = UINT64_MAX;
+  init_timer_wheel(&server->timers, server->now);
+
+  init_registry(&server->clients);
+  server->admin.sfd = -1;
 
   /* Create a socket */
   server->sfd = socket(AF_LOCAL, SOCK_STREAM, 0);
@@ -34,7 +52,9 @@ struct server* create_server(const char* path) {
 
 /*
  * run_server - used to bind server, set it
- * to passive mode and accept connections
+ * to passive mode, start admin socket and accept connections. Each
+ * connection is handled by its own thread and deadlines of all
+ * of them by timers thread, unless server runs on io_uring.
  * @server - pointer to an object of server struct
  */
 void run_server(struct server* server) {
@@ -49,7 +69,16 @@ void run_server(struct server* server) {
   if (listen(server->sfd, CLIENTS_AMOUNT) == -1)
     print_error("listen");
   
-  printf("SERVER: Server %s started\n", server->serv.sun_path);
+  log_info("SERVER: Server %s started\n", server->serv.sun_path);
+  start_admin(&server->admin, ADMIN_SOCK_PATH, collect_clients, server);
+
+  if (server->backend == BACKEND_URING) {
+    run_uring_server(server);
+    return;
+  }
+
+  if (pthread_create(&server->timers_thread, NULL, run_timers, server) != 0)
+    print_error("pthread_create");
 
   /* Accept connections */
   while (1) {
@@ -66,199 +95,466 @@ void run_server(struct server* server) {
     } 
     /* Message received */
     else {
-      printf("SERVER: Client %s connected\n", client.sun_path);
-      add_client(server, &client, client_fd);   
+      /* Check if server is full (limits threads, not registry) */
+      if (registry_size(&server->clients) == CLIENTS_AMOUNT) {
+        close(client_fd);
+        continue;
+      }
+
+      /* Blocked send fails once peer stops reading for SEND_QUEUE_TIMEOUT */
+      struct timeval timeout = {SEND_QUEUE_TIMEOUT, 0};
+      if (setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == -1)
+        log_warn("SERVER: Send timeout of fd %d not set: %s\n", client_fd, strerror(errno));
+
+      struct client* new_client = add_client(server, &client, client_fd);
+
+      /* Create thread for client */
+      if (pthread_create(&new_client->thread, NULL, handle_client_connection, (void *) new_client) != 0)
+        print_error("pthread_create");
     }
   }
 }
 
 /*
- * add_client - used to add client object to array
+ * add_client - used to add client object to registry
  * of clients.
  * @server - pointer to an object of server struct
  * @client_addr - pointer to an object of sockaddr_un struct  
  * client_fd - descriptor for communication with client
+ *
+ * Return: pointer to an object of client struct
  */
-void add_client(struct server* server, struct sockaddr_un* client_addr, int client_fd) {
-  /* Check if server is full */
-  if (server->clients_amount == CLIENTS_AMOUNT)
-    return;
-
-  struct client* client = (struct client*) malloc(sizeof(struct client));
+struct client* add_client(struct server* server, struct sockaddr_un* client_addr, int client_fd) {
+  struct client* client = (struct client*) calloc(1, sizeof(struct client));
+  if (!client)
+    print_error("calloc");
 
   /* Initialzie client struct */
-  client->addr = client_addr;
+  client->addr = *client_addr;
   client->fd = client_fd;
-  client->id = server->clients_amount;
   client->server = server;
 
-  /* Create thread for client */
-  if (pthread_create(&client->thread, NULL, handle_client_connection, (void *) client) != 0)
-    print_error("pthread_create");
+  /* Clients don't bind their sockets, name them by descriptor */
+  if (client->addr.sun_path[0])
+    snprintf(client->endpoint, sizeof(client->endpoint), "%s", client->addr.sun_path);
+  else
+    snprintf(client->endpoint, sizeof(client->endpoint), "fd %d", client->fd);
+  client->connected_at = metrics_now();
+  client->active_at = client->connected_at;
+  init_decoder(&client->decoder, server->max_frame, STREAM_CHUNK_SIZE);
+  client->id = registry_insert(&server->clients, client);
 
-  /* Add client to array*/
-  server->clients[server->clients_amount] = client;
-  server->clients_amount++;
+  /* Idle deadline starts */
+  init_timer(&client->timer, client);
+  arm_client_timer(client);
+
+  metrics_add(METRIC_ACCEPTED, 1);
+  log_info("SERVER: Client %s connected\n", client->endpoint);
+
+  /* Receive with multishot request */
+  if (server->backend == BACKEND_URING)
+    submit_recv(client);
+
+  return client;
 }
 
 /*
- * delete_client - used to delete client object from
- * array of clients.
+ * lock_timers - used to lock timers of threads backend,
+ * they are shared by clients threads and timers thread.
+ * io_uring backend drives timers from its only thread.
+ * @server - pointer to an object of server struct
+ */
+static void lock_timers(struct server* server) {
+  if (server->backend == BACKEND_THREADS)
+    pthread_mutex_lock(&server->timers_lock);
+}
+
+/*
+ * unlock_timers - used to unlock timers locked by lock_timers.
  * @server - pointer to an object of server struct
+ */
+static void unlock_timers(struct server* server) {
+  if (server->backend == BACKEND_THREADS)
+    pthread_mutex_unlock(&server->timers_lock);
+}
+
+/*
+ * client_deadline - used to find nearest deadline of the
+ * client: write deadline while it is paused, read deadline
+ * while part of frame waits for the rest, idle otherwise.
  * @client - pointer to an object of client struct
+ *
+ * Return: time client expires at (metrics_now clock)
  */
-void delete_client(struct server* server, struct client* client) {
-  int i;
-  
-  /* Find necessary client */
-  for (i = 0; i < server->clients_amount; i++) {
-    if (server->clients[i]->id == client->id) {
-      free(server->clients[i]);
-    } 
+static uint64_t client_deadline(struct client* client) {
+  uint64_t frame_at = __atomic_load_n(&client->frame_at, __ATOMIC_RELAXED);
+
+  if (client->paused)
+    return client->paused_at + SEND_QUEUE_TIMEOUT * 1000000000ull;
+  if (frame_at)
+    return frame_at + READ_TIMEOUT * 1000000000ull;
+
+  return __atomic_load_n(&client->active_at, __ATOMIC_RELAXED) + IDLE_TIMEOUT * 1000000000ull;
+}
+
+/*
+ * arm_client_timer - used when deadline of the client may
+ * get nearer. Timer is moved only if it expires later, activity
+ * that moves deadline away doesn't touch timers at all: expired
+ * timer checks state of the client and is armed again.
+ * @client - pointer to an object of client struct
+ */
+void arm_client_timer(struct client* client) {
+  struct server* server = client->server;
+
+  lock_timers(server);
+  timer_wheel_shorten(&server->timers, &client->timer, client_deadline(client));
+
+  /* Timers thread sleeps past new deadline */
+  if (server->backend == BACKEND_THREADS && client->timer.deadline < server->wake_at)
+    pthread_cond_signal(&server->timers_wake);
+  unlock_timers(server);
+}
+
+/*
+ * track_partial_frame - used when received bytes were
+ * consumed to start read deadline if decoder is left with
+ * part of next frame. Receivers reset frame_at on every
+ * complete frame (or chunk of streamed one), so deadline
+ * counts from start of the frame or from last chunk.
+ * @client - pointer to an object of client struct
+ * @now - current time (metrics_now clock)
+ */
+void track_partial_frame(struct client* client, uint64_t now) {
+  if (!decoder_pending(&client->decoder) && !client->decoder.left) {
+    __atomic_store_n(&client->frame_at, 0, __ATOMIC_RELAXED);
+    return;
   }
 
-  /* Move i + 1 clients to left */
-  for (; i < server->clients_amount; i++) {
-     server->clients[i] = server->clients[i + 1]; 
+  if (!client->frame_at) {
+    __atomic_store_n(&client->frame_at, now, __ATOMIC_RELAXED);
+    arm_client_timer(client);
+  }
+}
+
+/*
+ * expire_client - used as callback of timer wheel. Client
+ * whose deadline moved away is armed again, otherwise it is
+ * disconnected. Socket of threads client is only shut down,
+ * its thread notices that and frees client.
+ * @item - pointer to an object of client struct
+ * @arg - pointer to an object of server struct
+ */
+static void expire_client(void* item, void* arg) {
+  struct client* client = (struct client*) item;
+  struct server* server = (struct server*) arg;
+  uint64_t deadline = client_deadline(client);
+
+  if (deadline > server->now) {
+    timer_wheel_add(&server->timers, &client->timer, deadline);
+    return;
+  }
+
+  if (client->paused)
+    log_warn("SERVER: Client %s didn't read replies for %d s, disconnecting\n",
+             client->endpoint, SEND_QUEUE_TIMEOUT);
+  else if (client->frame_at)
+    log_warn("SERVER: Client %s didn't complete message for %d s, disconnecting\n",
+             client->endpoint, READ_TIMEOUT);
+  else
+    log_info("SERVER: Client %s was idle for %d s, disconnecting\n", client->endpoint, IDLE_TIMEOUT);
+
+  if (server->backend == BACKEND_URING) {
+    close_uring_connection(client);
+    if (client->inflight == 0)
+      close_connection(client);
+  } else {
+    shutdown(client->fd, SHUT_RDWR);
   }
-  
-  /* Delete last pointer */
-  server->clients[i + 1] = NULL; 
-  server->clients_amount--;
+}
+
+/*
+ * expire_clients - used at the end of io_uring loop iteration
+ * to disconnect clients whose deadlines passed by time of the
+ * iteration (server->now).
+ * @server - pointer to an object of server struct
+ */
+void expire_clients(struct server* server) {
+  timer_wheel_advance(&server->timers, server->now, expire_client, server);
+}
+
+/*
+ * run_timers - used as thread function of threads backend
+ * that expires clients. Sleeps until next tick with deadlines,
+ * clients threads wake it when they arm nearer deadline.
+ * @arg - pointer to an object of server struct
+ */
+void* run_timers(void* arg) {
+  struct server* server = (struct server*) arg;
+  struct timespec wake;
+
+  pthread_mutex_lock(&server->timers_lock);
+  while (1) {
+    server->now = metrics_now();
+    timer_wheel_advance(&server->timers, server->now, expire_client, server);
+
+    int timeout = timer_wheel_timeout(&server->timers, server->now);
+    if (timeout == -1) {
+      server->wake_at = UINT64_MAX;
+      pthread_cond_wait(&server->timers_wake, &server->timers_lock);
+      continue;
+    }
+
+    server->wake_at = server->now + timeout * 1000000ull;
+    wake.tv_sec = server->wake_at / 1000000000ull;
+    wake.tv_nsec = server->wake_at % 1000000000ull;
+    pthread_cond_timedwait(&server->timers_wake, &server->timers_lock, &wake);
+  }
+
+  return NULL;
+}
+
+/*
+ * delete_client - used to delete client object from
+ * registry of clients and free it.
+ * @server - pointer to an object of server struct
+ * @client - pointer to an object of client struct
+ */
+void delete_client(struct server* server, struct client* client) {
+  registry_remove(&server->clients, client->id);
+
+  /* Released buffers must not wake client being freed */
+  if (client->starved)
+    forget_starved_client(client);
+
+  lock_timers(server);
+  timer_wheel_remove(&server->timers, &client->timer);
+  unlock_timers(server);
+
+  metrics_add(METRIC_CLOSED, 1);
+
+  /* Free replies that were not sent */
+  free_replies(client->replies);
+  free_replies(client->sending);
+
+  free_decoder(&client->decoder);
+  free(client->iov);
+  free(client);
 }
 
 /*
  * handle_client_connection - used int thread to
- * handle new messages from connected user. If
+ * handle new messages from connected user. Replies
+ * are queued while decoder holds more messages and
+ * sent together when client waits for them or queue
+ * reaches SEND_QUEUE_HIGH. Blocking send is the
+ * backpressure: thread doesn't read while peer doesn't
+ * take replies, and gives up after SEND_QUEUE_TIMEOUT. If
  * client calls shutdown, connection will be closed,
- * memory freed.
+ * memory freed. Client that starts with shared memory
+ * handshake is served over rings instead.
  * @arg - pointer to an object of client struct
  */
 void* handle_client_connection(void* arg) {
   /* Cast arg to client struct*/
   struct client* client = (struct client*) arg;
-  char buffer[BUFFER_SIZE];
-  int bytes_read;
+
+  if (is_shm_handshake(client)) {
+    serve_shm_client(client);
+    return NULL;
+  }
   
   while (1) {
-    char* message = recv_message(client);
+    struct msgbuf* message = recv_message(client);
     /* Connection closed */
     if (message == NULL) {
-      printf("SERVER: Client %s disconnected\n", client->addr->sun_path);
+      log_info("SERVER: Client %s disconnected\n", client->endpoint);
       close_connection(client);
       break;
     }
     
     /* Log message */
-    printf("SERVER: Received message from client %s: %s\n", client->addr->sun_path, message);
+    log_debug("SERVER: Received message from client %s: %.*s\n", client->endpoint,
+              (int) message->payload_len, message->payload);
 
-    /* Edit message */
-    char* new_message = edit_message(message);
-    send_message(client, new_message);
+    /* Edit message in place and queue it as reply */
+    uint64_t start = metrics_now();
+    edit_message(message);
+    metrics_record(STAGE_TRANSFORM, start);
+    queue_reply(client, message);
 
-    /* Free allocated memory */
-    free(new_message);
-    free(message);
+    /* Send replies when next message isn't received yet */
+    if (!decoder_ready(&client->decoder) || client->queued >= SEND_QUEUE_HIGH) {
+      if (send_message(client) == -1) {
+        log_info("SERVER: Client %s disconnected\n", client->endpoint);
+        close_connection(client);
+        break;
+      }
+    }
   }
 
   return NULL;  
 }
 
 /*
- * send_message - used to send message to client. First
- * sends length of the buffer, then sends the message.
+ * queue_reply - used to write length header in front of
+ * message and add it to the end of clients queue. Header
+ * holds length of whole frame, continued chunks of streamed
+ * frame are queued as they are. Reply takes ownership of
+ * message.
+ * @client - pointer to an object of client struct
+ * @message - message with prefix and REPLY_HEADROOM
+ */
+void queue_reply(struct client* client, struct msgbuf* message) {
+  struct reply* reply = (struct reply*) pool_alloc(sizeof(struct reply));
+  uint32_t net_len = htonl(message->frame_len);
+
+  log_debug("SERVER: Send message length: %u\n", msgbuf_length(message));
+  log_debug("SERVER: Server send message %s%.*s\n", message->data, (int) message->payload_len, message->payload);
+
+  if (!message->continued)
+    msgbuf_push(message, &net_len, sizeof(net_len));
+  reply->message = message;
+  reply->next = NULL;
+  client->queued += msgbuf_length(message);
+
+  if (client->replies_tail)
+    client->replies_tail->next = reply;
+  else
+    client->replies = reply;
+  client->replies_tail = reply;
+}
+
+/*
+ * send_message - used to send queued replies to client.
+ * Up to REPLIES_AMOUNT replies, each already holding its
+ * length header, are gathered into one sendmsg call, payload
+ * straight from blocks it was received into.
  * @client - pointer to an object of client struct 
- * @buffer - message
+ *
+ * Return: 0 if all replies sent, -1 if connection failed
+ * or peer didn't read for SEND_QUEUE_TIMEOUT
  */
-void send_message(struct client* client, char buffer[BUFFER_SIZE]) {
-  uint32_t message_len;
-  uint32_t net_len;
-  
-  message_len = strlen(buffer);
-  net_len = htonl(message_len);
-  
-  /* Send message length */
-  if (send(client->fd, &net_len, sizeof(net_len), 0) == -1)
-    print_error("send");
-  
-  printf("SERVER: Send message length: %d\n", message_len);
+int send_message(struct client* client) {
+  struct iovec iov[REPLIES_AMOUNT * 2];
+  struct msghdr msg;
+  size_t reply_sent = 0;
+  ssize_t bytes_sent;
 
-  /* Send new message */
-  if (send(client->fd, buffer, message_len, 0) == -1)
-    print_error("send");
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+
+  while (client->replies) {
+    size_t skip = reply_sent;
+    int replies = 0;
+    int count = 0;
+
+    /* Gather replies, skip part that was already sent */
+    for (struct reply* reply = client->replies; reply && replies < REPLIES_AMOUNT; reply = reply->next) {
+      count += msgbuf_iov(reply->message, skip, iov + count);
+      replies++;
+      skip = 0;
+    }
+
+    /* Send blocks while client doesn't read, so no latency is recorded */
+    msg.msg_iovlen = count;
+    bytes_sent = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+    if (bytes_sent == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        log_warn("SERVER: Client %s didn't read replies for %d s, disconnecting\n",
+                 client->endpoint, SEND_QUEUE_TIMEOUT);
+      else
+        log_warn("SERVER: Send to client %s failed: %s\n", client->endpoint, strerror(errno));
+      return -1;
+    }
 
-  printf("SERVER: Server send message %s\n", buffer);
+    /* Drop replies that were sent completely */
+    metrics_add_bytes(METRIC_BYTES_OUT, &client->bytes_out, bytes_sent);
+    __atomic_store_n(&client->active_at, metrics_now(), __ATOMIC_RELAXED);
+    reply_sent += bytes_sent;
+    while (client->replies && reply_sent >= msgbuf_length(client->replies->message)) {
+      struct reply* reply = client->replies;
+
+      metrics_add(METRIC_MESSAGES_OUT, !reply->message->continued);
+      client->queued -= msgbuf_length(reply->message);
+      reply_sent -= msgbuf_length(reply->message);
+      client->replies = reply->next;
+      msgbuf_free(reply->message);
+      pool_free(reply);
+    }
+  }
+
+  client->replies_tail = NULL;
+
+  return 0;
 }
 
 /*
- * recv_message - used to receive message from client. Receives
- * message length first, then allocates memory for message and
- * receives full message. Returned message should be freed manually.
+ * recv_message - used to receive message from client. Takes
+ * next message from clients decoder, receiving more bytes only
+ * when decoder doesn't hold complete message, so one receive
+ * may serve several messages. Message has REPLY_HEADROOM, its
+ * payload stays in decoder block it was received into. Long
+ * message is taken in pieces as they arrive. Message should
+ * be freed by msgbuf_free.
  * @client - pointer to an object of client struct
  *
- * Return: string (message) if successful, NULL if connection closed 
+ * Return: string (message) if successful, NULL if connection closed or failed
  */
-char* recv_message(struct client* client) {
-  uint32_t net_len;
-  uint32_t message_len;
+struct msgbuf* recv_message(struct client* client) {
   ssize_t bytes_read;
-  ssize_t total_received;
-  char* message;
-  
-  /* Receive message length */
-  bytes_read = recv(client->fd, &net_len, sizeof(net_len), 0);
-  /* Error occured*/
-  if (bytes_read < 0) {
-    print_error("recv");
-  } 
-  /* Connection closed */
-  else if (bytes_read == 0) {
-    return NULL;
-  }
-  
-  /* Convert message length to Little Endian */
-  message_len = ntohl(net_len);
-  
-  printf("SERVER: Received message length: %d\n", message_len);
+  struct msgbuf* message;
 
-  /* Allocate memory for message */
-  message = (char*) malloc(message_len + 1);
-  if (!message)
-    print_error("malloc");
-  
-  /* Read all message */
-  while (total_received < message_len) {
-    bytes_read = recv(client->fd, message + total_received, message_len - total_received, 0);
+  while (1) {
+    switch (decoder_borrow(&client->decoder, REPLY_HEADROOM, &message)) {
+      case FRAME_OK:
+        log_debug("SERVER: Received message length: %u\n", message->payload_len);
+        metrics_add(METRIC_MESSAGES_IN, !message->continued);
+        __atomic_store_n(&client->frame_at, 0, __ATOMIC_RELAXED);
+        return message;
+
+      case FRAME_TOO_BIG:
+        log_warn("SERVER: Client %s sent message longer than %u bytes\n",
+                 client->endpoint, client->decoder.max_frame);
+        return NULL;
+
+      case FRAME_PARTIAL:
+        break;
+    }
+
+    /* Read deadline starts if part of frame is left before blocking */
+    track_partial_frame(client, metrics_now());
+    bytes_read = decoder_fill(&client->decoder, client->fd);
+    /* Error occured*/
     if (bytes_read < 0) {
-      free(message);
-      print_error("recv");
+      log_warn("SERVER: Receive from client %s failed: %s\n", client->endpoint, strerror(errno));
+      return NULL;
+    } 
+    /* Connection closed */
+    else if (bytes_read == 0) {
+      return NULL;
     }
-    total_received += bytes_read;
+
+    metrics_add_bytes(METRIC_BYTES_IN, &client->bytes_in, bytes_read);
+    __atomic_store_n(&client->active_at, metrics_now(), __ATOMIC_RELAXED);
   }
-  
-  /* Terminate message */
-  message[message_len] = '\0';
-  
-  return message;
 }
 
 /*
- * edit_message - used to add prefix "Server" to message.
- * Allocates new buffer. Return buffer should be free manually.
+ * edit_message - used to add prefix "Server " to message.
+ * Prefix is written in headroom in front of payload, so
+ * payload isn't copied. Streamed frame gets prefix in front
+ * of its first chunk, other chunks pass through unchanged.
  * @message - message from client that needs to be changed
- * 
- * Return: string with prefix
  */
-char* edit_message(char* message) {
-  char* prefix = "Server";
-  char* new_message = (char*) malloc(strlen(message) + strlen(prefix) + 2);
-  if (!new_message)
-    print_error("malloc");
-
-  /* Add prefix to message */
-  snprintf(new_message, strlen(message) + strlen(prefix) + 2, "%s %s", "Server", message);
+void edit_message(struct msgbuf* message) {
+  if (message->continued)
+    return;
 
-  return new_message;
+  msgbuf_push(message, PREFIX, PREFIX_LEN);
+  message->frame_len += PREFIX_LEN;
 }
 
 /*
@@ -277,8 +573,58 @@ void shutdown_connection(struct client* client) {
  * frees memory allocated for client; 
  */
 void close_connection(struct client* client) {
-  close(client->fd);
+  int fd = client->fd;
+
+  /* Client leaves timers before its fd may be reused */
   delete_client(client->server, client);
+  close(fd);
+}
+
+/*
+ * free_replies - used to free list of replies.
+ * @replies - pointer to first reply of the list
+ */
+void free_replies(struct reply* replies) {
+  while (replies) {
+    struct reply* reply = replies;
+    replies = reply->next;
+    msgbuf_free(reply->message);
+    pool_free(reply);
+  }
+}
+
+/*
+ * collect_client - used as callback of registry walk to
+ * copy client into table of admin socket.
+ * @item - pointer to an object of client struct
+ * @arg - pointer to an object of admin_table struct
+ */
+static void collect_client(void* item, void* arg) {
+  struct client* client = (struct client*) item;
+  struct admin_client* row = admin_table_add((struct admin_table*) arg);
+
+  snprintf(row->endpoint, sizeof(row->endpoint), "%s", client->endpoint);
+  row->bytes_in = __atomic_load_n(&client->bytes_in, __ATOMIC_RELAXED);
+  row->bytes_out = __atomic_load_n(&client->bytes_out, __ATOMIC_RELAXED);
+  row->connected_at = client->connected_at;
+}
+
+/*
+ * collect_clients - used by admin socket to copy clients
+ * table. Registry is locked only while clients are copied.
+ * @arg - pointer to an object of server struct
+ * @clients - pointer where allocated table is stored
+ *
+ * Return: amount of clients in table
+ */
+int collect_clients(void* arg, struct admin_client** clients) {
+  struct server* server = (struct server*) arg;
+  struct admin_table table = {NULL, 0, 0};
+
+  registry_foreach(&server->clients, collect_client, &table);
+  *clients = table.rows;
+
+  return table.amount;
 }
 
 /*
@@ -286,10 +632,24 @@ void close_connection(struct client* client) {
  * @server - pointer to an object of server struct
  */
 void free_server(struct server* server) {
-  for (int i = 0; i < server->clients_amount; i++) {
-    shutdown_connection(server->clients[i]);
-    free(server->clients[i]);
+  struct pool_stats stats;
+
+  stop_admin(&server->admin);
+
+  pool_get_stats(&stats);
+  log_info("SERVER: Pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+
+  struct client* client;
+  uint32_t index = 0;
+
+  while ((client = (struct client*) registry_next(&server->clients, &index)))
+    shutdown_connection(client);
+
+  if (server->ring.fd != -1) {
+    uring_free_buffers(&server->ring, &server->buffers);
+    uring_free(&server->ring);
   }
-  free(server->clients);
+  close(server->sfd);
+  free_registry(&server->clients);
   free(server);
 }
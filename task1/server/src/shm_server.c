@@ -0,0 +1,80 @@
+#include "../headers/shm_server.h"
+
+/*
+ * is_shm_handshake - used to check whether client starts
+ * with shared memory handshake instead of message. First
+ * length header is only peeked, so ordinary message is
+ * left for decoder.
+ * @client - pointer to an object of client struct
+ *
+ * Return: 1 if client asked for shared memory transport, 0 otherwise
+ */
+int is_shm_handshake(struct client* client) {
+  uint32_t net_len;
+
+  if (recv(client->fd, &net_len, sizeof(net_len), MSG_PEEK | MSG_WAITALL) != sizeof(net_len))
+    return 0;
+
+  return ntohl(net_len) == SHM_HANDSHAKE;
+}
+
+/*
+ * serve_shm_client - used in clients thread to serve client
+ * over shared memory rings. Every request is copied once, behind
+ * prefix, straight into ring of replies, so messages cost no
+ * system calls while both sides are busy. Returns when client
+ * is gone, connection is closed and memory freed.
+ * @client - pointer to an object of client struct
+ */
+void serve_shm_client(struct client* client) {
+  struct shm_channel channel = {NULL, NULL, NULL, -1, -1, -1, 0};
+  uint32_t max_len = client->server->max_frame;
+  uint32_t net_len, len;
+  char* data;
+
+  if (max_len > SHM_MAX_MESSAGE - PREFIX_LEN)
+    max_len = SHM_MAX_MESSAGE - PREFIX_LEN;
+
+  /* Take handshake out of socket */
+  recv(client->fd, &net_len, sizeof(net_len), MSG_WAITALL);
+
+  if (shm_offer(&channel, client->fd) == -1) {
+    log_warn("SERVER: Shared memory offer to client %s failed: %s\n", client->endpoint, strerror(errno));
+    shm_close(&channel);
+    close_connection(client);
+    return;
+  }
+
+  log_info("SERVER: Client %s switched to shared memory\n", client->endpoint);
+
+  while ((data = shm_peek(&channel, &len)) != NULL) {
+    metrics_add(METRIC_MESSAGES_IN, 1);
+    metrics_add_bytes(METRIC_BYTES_IN, &client->bytes_in, len);
+    log_debug("SERVER: Received message length: %d\n", len);
+
+    if (len > max_len) {
+      log_warn("SERVER: Client %s sent message longer than %u bytes\n", client->endpoint, max_len);
+      break;
+    }
+
+    /* Build reply in ring of replies */
+    uint64_t start = metrics_now();
+    __atomic_store_n(&client->active_at, start, __ATOMIC_RELAXED);
+    char* reply = shm_reserve(&channel, PREFIX_LEN + len);
+    if (reply == NULL)
+      break;
+
+    memcpy(reply, PREFIX, PREFIX_LEN);
+    memcpy(reply + PREFIX_LEN, data, len);
+    shm_release(&channel);
+    shm_commit(&channel, PREFIX_LEN + len);
+    metrics_record(STAGE_TRANSFORM, start);
+
+    metrics_add(METRIC_MESSAGES_OUT, 1);
+    metrics_add_bytes(METRIC_BYTES_OUT, &client->bytes_out, PREFIX_LEN + len);
+  }
+
+  log_info("SERVER: Client %s disconnected\n", client->endpoint);
+  shm_close(&channel);
+  close_connection(client);
+}
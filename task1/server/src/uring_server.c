@@ -0,0 +1,410 @@
+#include "../headers/uring_server.h"
+
+/*
+ * run_uring_server - used to run event loop of the server
+ * on io_uring instead of thread per client. Connections are
+ * accepted by single multishot accept, data is received by
+ * multishot receives into provided buffers and replies are
+ * sent by gathered sends, so all connections share one
+ * submission queue and every loop iteration costs one
+ * system call. Waiting ends on next tick of timer wheel
+ * that holds deadlines, so expired clients are found
+ * without separate timer requests.
+ * @server - pointer to an object of server struct
+ */
+void run_uring_server(struct server* server) {
+  struct io_uring_cqe* cqe;
+
+  uring_init(&server->ring, URING_ENTRIES);
+  uring_init_buffers(&server->ring, &server->buffers, URING_BUFFERS, URING_BUFFER_SIZE, 0);
+
+  server->accept_op.type = OP_ACCEPT;
+  server->accept_op.client = NULL;
+  submit_accept(server);
+
+  while (1) {
+    int timeout = timer_wheel_timeout(&server->timers, server->now);
+
+    /* Submit prepared requests and wait for completion or next deadline */
+    if (uring_submit_timeout(&server->ring, 1, timeout) == -1)
+      print_error("io_uring_enter");
+
+    server->now = metrics_now();
+    while ((cqe = uring_peek_cqe(&server->ring)) != NULL) {
+      handle_uring_completion(server, cqe);
+      uring_cqe_seen(&server->ring);
+    }
+
+    expire_clients(server);
+  }
+}
+
+/*
+ * handle_uring_completion - used to handle completion
+ * of accept, receive, send or cancel request.
+ * @server - pointer to an object of server struct
+ * @cqe - pointer to completion entry
+ */
+void handle_uring_completion(struct server* server, struct io_uring_cqe* cqe) {
+  struct uring_op* op = (struct uring_op*) (uintptr_t) cqe->user_data;
+  struct client* client = op->client;
+  int more = cqe->flags & IORING_CQE_F_MORE;
+
+  switch (op->type) {
+    case OP_ACCEPT:
+      if (cqe->res >= 0) {
+        struct sockaddr_un client_addr;
+        socklen_t client_size = sizeof(client_addr);
+
+        memset(&client_addr, 0, sizeof(client_addr));
+        getpeername(cqe->res, (struct sockaddr*) &client_addr, &client_size);
+        add_client(server, &client_addr, cqe->res);
+      } else if (cqe->res != -EINTR && cqe->res != -ECONNABORTED) {
+        log_error("SERVER: Accept failed: %s\n", strerror(-cqe->res));
+      }
+
+      /* Multishot accept was terminated */
+      if (!more)
+        submit_accept(server);
+      break;
+
+    case OP_RECV:
+      if (!more) {
+        client->inflight--;
+        client->receiving = 0;
+      }
+
+      if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        unsigned short id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+        metrics_add_bytes(METRIC_BYTES_IN, &client->bytes_in, cqe->res);
+        client->active_at = server->now;
+        if (!client->closing)
+          consume_messages(client, uring_take_buffer(&server->buffers, id, cqe->res));
+        else
+          uring_recycle_buffer(&server->buffers, id);
+
+        if (!client->closing)
+          submit_replies(client);
+
+        /* Stop receiving until peer takes replies (and buffers they hold) */
+        if (!client->closing && !client->paused &&
+            (client->queued >= SEND_QUEUE_HIGH || client->pinned >= URING_CLIENT_BUFFERS))
+          pause_uring_client(client);
+      }
+
+      /* Connection closed or failed, cancel only pauses receiving */
+      if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)) {
+        if (!client->closing)
+          log_info("SERVER: Client %s disconnected\n", client->endpoint);
+        close_uring_connection(client);
+      }
+      /* Multishot receive was terminated, out of buffers it waits for replies to free some */
+      else if (!more && !client->closing && !client->paused) {
+        if (cqe->res == -ENOBUFS)
+          wait_for_buffers(client);
+        else
+          submit_recv(client);
+      }
+      break;
+
+    case OP_SEND:
+      client->inflight--;
+      metrics_record(STAGE_SEND, client->sending_started);
+
+      /* Short send means connection failed */
+      if (cqe->res < 0 || (size_t) cqe->res < client->sending_len)
+        close_uring_connection(client);
+      else {
+        metrics_add_bytes(METRIC_BYTES_OUT, &client->bytes_out, cqe->res);
+        metrics_add(METRIC_MESSAGES_OUT, client->sending_count);
+        client->active_at = server->now;
+      }
+
+      client->queued -= client->sending_len;
+      free_replies(client->sending);
+      client->sending = NULL;
+
+      if (!client->closing) {
+        submit_replies(client);
+
+        if (client->paused && client->queued <= SEND_QUEUE_LOW &&
+            client->pinned <= URING_CLIENT_BUFFERS / 4)
+          resume_uring_client(client);
+      }
+      break;
+
+    case OP_CANCEL:
+      client->inflight--;
+      break;
+  }
+
+  /* Free client after its last request completed */
+  if (client && client->closing && client->inflight == 0)
+    close_connection(client);
+}
+
+/*
+ * submit_accept - used to prepare multishot accept request
+ * on servers passive socket.
+ * @server - pointer to an object of server struct
+ */
+void submit_accept(struct server* server) {
+  struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = server->sfd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->user_data = (uint64_t) (uintptr_t) &server->accept_op;
+}
+
+/*
+ * submit_recv - used to prepare multishot receive request
+ * on clients socket. Kernel selects buffer from servers
+ * provided buffers for every chunk of data.
+ * @client - pointer to an object of client struct
+ */
+void submit_recv(struct client* client) {
+  struct server* server = client->server;
+  struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+
+  client->recv_op.type = OP_RECV;
+  client->recv_op.client = client;
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = client->fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = server->buffers.group;
+  sqe->user_data = (uint64_t) (uintptr_t) &client->recv_op;
+
+  client->inflight++;
+  client->receiving = 1;
+}
+
+/*
+ * wait_for_buffers - used when multishot receive of client
+ * ran out of provided buffers. Receive is submitted again
+ * at once if some buffers were released meanwhile, otherwise
+ * client waits in list until next buffer is released.
+ * @client - pointer to an object of client struct
+ */
+void wait_for_buffers(struct client* client) {
+  struct server* server = client->server;
+
+  if (server->pinned < server->buffers.entries) {
+    submit_recv(client);
+    return;
+  }
+
+  if (client->starved)
+    return;
+
+  client->starved = 1;
+  client->next_starved = server->starved;
+  server->starved = client;
+}
+
+/*
+ * forget_starved_client - used to remove client from list
+ * of clients waiting for provided buffers.
+ * @client - pointer to an object of client struct
+ */
+void forget_starved_client(struct client* client) {
+  struct client** link = &client->server->starved;
+
+  while (*link != client)
+    link = &(*link)->next_starved;
+
+  *link = client->next_starved;
+  client->starved = 0;
+}
+
+/*
+ * release_uring_block - used as release callback of block
+ * holding provided buffer. Buffer goes back to kernel once
+ * decoder and all replies dropped it, and first client
+ * waiting for buffers receives again.
+ * @block - pointer to an object of rxbuf struct
+ */
+void release_uring_block(struct rxbuf* block) {
+  struct client* client = (struct client*) block->owner;
+  struct server* server = client->server;
+
+  client->pinned--;
+  server->pinned--;
+  uring_recycle_buffer(&server->buffers, block->id);
+
+  while (server->starved) {
+    struct client* starved = server->starved;
+
+    forget_starved_client(starved);
+    if (!starved->closing && !starved->paused && !starved->receiving) {
+      submit_recv(starved);
+      break;
+    }
+  }
+}
+
+/*
+ * pause_uring_client - used to stop receiving from client
+ * whose queued replies reached SEND_QUEUE_HIGH, write deadline
+ * starts. Multishot receive is cancelled, data it still
+ * delivers is consumed.
+ * @client - pointer to an object of client struct
+ */
+void pause_uring_client(struct client* client) {
+  struct server* server = client->server;
+
+  client->paused = 1;
+  client->paused_at = server->now;
+  arm_client_timer(client);
+
+  log_debug("SERVER: Client %s paused with %zu bytes queued\n", client->endpoint, client->queued);
+  if (!client->receiving)
+    return;
+
+  client->cancel_op.type = OP_CANCEL;
+  client->cancel_op.client = client;
+
+  struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = (uint64_t) (uintptr_t) &client->recv_op;
+  sqe->user_data = (uint64_t) (uintptr_t) &client->cancel_op;
+
+  client->inflight++;
+}
+
+/*
+ * resume_uring_client - used to start receiving from paused
+ * client again once its replies drained to SEND_QUEUE_LOW.
+ * If cancelled receive didn't complete yet, it is submitted
+ * again on its completion.
+ * @client - pointer to an object of client struct
+ */
+void resume_uring_client(struct client* client) {
+  client->paused = 0;
+  log_debug("SERVER: Client %s resumed with %zu bytes queued\n", client->endpoint, client->queued);
+
+  if (!client->receiving)
+    submit_recv(client);
+}
+
+/*
+ * submit_replies - used to submit queued replies of the
+ * client (up to REPLIES_AMOUNT) as one gathered send request.
+ * Payload is sent straight from provided buffers it was
+ * received into, they are recycled when send completes.
+ * Next replies are submitted after previous send completed,
+ * which keeps them in order.
+ * @client - pointer to an object of client struct
+ */
+void submit_replies(struct client* client) {
+  struct server* server = client->server;
+  int replies = 0;
+  int count = 0;
+
+  /* Previous send is in flight or nothing to send */
+  if (client->sending || !client->replies)
+    return;
+
+  /* Allocate vector on first send, idle clients don't need it */
+  if (!client->iov) {
+    client->iov = (struct iovec*) malloc(REPLIES_AMOUNT * 2 * sizeof(struct iovec));
+    if (!client->iov)
+      print_error("malloc");
+  }
+
+  /* Move replies from queue to send request */
+  client->sending = client->replies;
+  client->sending_len = 0;
+  client->sending_count = 0;
+
+  struct reply* last = client->replies;
+  for (struct reply* reply = client->replies; reply && replies < REPLIES_AMOUNT; reply = reply->next) {
+    count += msgbuf_iov(reply->message, 0, client->iov + count);
+    client->sending_len += msgbuf_length(reply->message);
+    client->sending_count += !reply->message->continued;
+    replies++;
+    last = reply;
+  }
+
+  client->replies = last->next;
+  if (!client->replies)
+    client->replies_tail = NULL;
+  last->next = NULL;
+
+  memset(&client->msg, 0, sizeof(client->msg));
+  client->msg.msg_iov = client->iov;
+  client->msg.msg_iovlen = count;
+  client->sending_started = metrics_now();
+
+  client->send_op.type = OP_SEND;
+  client->send_op.client = client;
+
+  struct io_uring_sqe* sqe = uring_get_sqe(&server->ring);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = client->fd;
+  sqe->addr = (uint64_t) (uintptr_t) &client->msg;
+  sqe->len = 1;
+  sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+  sqe->user_data = (uint64_t) (uintptr_t) &client->send_op;
+
+  client->inflight++;
+}
+
+/*
+ * consume_messages - used to pass received provided buffer
+ * to clients decoder and take all messages out of it. Every
+ * message (or piece of long one) is edited and queued as
+ * reply pointing into the buffer, part of next one left in
+ * decoder starts read deadline.
+ * @client - pointer to an object of client struct
+ * @block - block of received provided buffer
+ */
+void consume_messages(struct client* client, struct rxbuf* block) {
+  struct msgbuf* message;
+  enum frame_status status;
+
+  block->owner = client;
+  block->release = release_uring_block;
+  client->pinned++;
+  client->server->pinned++;
+  decoder_append(&client->decoder, block);
+
+  while ((status = decoder_borrow(&client->decoder, REPLY_HEADROOM, &message)) == FRAME_OK) {
+    log_debug("SERVER: Received message length: %u\n", message->payload_len);
+    log_debug("SERVER: Received message from client %s: %.*s\n", client->endpoint,
+              (int) message->payload_len, message->payload);
+    metrics_add(METRIC_MESSAGES_IN, !message->continued);
+    client->frame_at = 0;
+
+    uint64_t start = metrics_now();
+    edit_message(message);
+    metrics_record(STAGE_TRANSFORM, start);
+    queue_reply(client, message);
+  }
+
+  if (status == FRAME_TOO_BIG) {
+    log_warn("SERVER: Client %s sent message longer than %u bytes\n",
+             client->endpoint, client->decoder.max_frame);
+    close_uring_connection(client);
+    return;
+  }
+
+  track_partial_frame(client, client->server->now);
+}
+
+/*
+ * close_uring_connection - used to start closing of the
+ * connection. Shutdown terminates requests in flight, client
+ * is freed when last of them completes.
+ * @client - pointer to an object of client struct
+ */
+void close_uring_connection(struct client* client) {
+  if (client->closing)
+    return;
+
+  client->closing = 1;
+  shutdown(client->fd, SHUT_RDWR);
+}
@@ -0,0 +1,68 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "client.h"
+#include "../../common/headers/histogram.h"
+
+#define BENCH_TIMEOUT_MS 1000
+
+/**
+ * Used as parameters of closed-loop load generation:
+ * every socket sends one datagram, waits for response
+ * (or BENCH_TIMEOUT_MS) and sends next one, until it has
+ * sent its messages. Sizes of messages are uniformly
+ * distributed in range min_size..max_size.
+ */
+struct bench {
+  /* Amount of sockets (one thread each) */
+  int connections;
+
+  /* Amount of messages sent by every socket */
+  int messages;
+
+  /* Range of message sizes in bytes */
+  uint32_t min_size;
+  uint32_t max_size;
+
+  /* Print results as one comma separated row */
+  int csv;
+};
+
+/**
+ * Used as state of one socket of load generator.
+ * Counters and histogram are private to its thread and
+ * merged once all threads finish.
+ */
+struct bench_worker {
+  struct bench* bench;
+
+  /* Socket bound to its own path */
+  struct client* client;
+
+  pthread_t thread;
+
+  /* Barrier that starts all sockets at once */
+  pthread_barrier_t* start;
+
+  /* Seed of message sizes */
+  unsigned int seed;
+
+  /* Sent, answered and lost messages, sent payload bytes */
+  unsigned long sent;
+  unsigned long received;
+  unsigned long lost;
+  uint64_t bytes;
+
+  /* Latencies of answered messages in nanoseconds */
+  struct histogram histogram;
+};
+
+void run_bench(struct bench* bench);
+
+void* run_worker(void* arg);
+
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed);
+
+uint64_t now_ns(void);
+
+#endif // !BENCH_H
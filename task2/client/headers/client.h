@@ -2,6 +2,8 @@
 #define CLIENT_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/pool.h"
 
 /*
  * Used as client for connection to local address
@@ -20,6 +22,8 @@ struct client {
 
 struct client* create_client(const char* client_path, const char* server_path);
 
+void bind_client(struct client* client);
+
 void run_client(struct client* client);
 
 void process_input(struct client* client);
@@ -0,0 +1,191 @@
+#include "../headers/bench.h"
+#include <time.h>
+
+/*
+ * run_bench - used to run closed-loop load generation.
+ * Binds all sockets, starts them at once, waits
+ * until every socket has sent its messages and
+ * prints report.
+ * @bench - pointer to an object of bench struct
+ */
+void run_bench(struct bench* bench) {
+  struct bench_worker* workers = (struct bench_worker*) calloc(bench->connections, sizeof(struct bench_worker));
+  pthread_barrier_t start;
+  uint64_t started;
+  char path[sizeof(CLIENT_SOCK_PATH) + 16];
+
+  if (!workers)
+    print_error("calloc");
+
+  if (pthread_barrier_init(&start, NULL, bench->connections + 1) != 0)
+    print_error("pthread_barrier_init");
+
+  for (int i = 0; i < bench->connections; i++) {
+    struct bench_worker* worker = &workers[i];
+
+    worker->bench = bench;
+    worker->start = &start;
+    worker->seed = time(NULL) + i;
+    snprintf(path, sizeof(path), "%s.%d", CLIENT_SOCK_PATH, i);
+    worker->client = create_client(path, SERV_SOCK_PATH);
+    init_histogram(&worker->histogram);
+
+    if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0)
+      print_error("pthread_create");
+  }
+
+  /* Start measuring once all sockets are ready */
+  pthread_barrier_wait(&start);
+  started = now_ns();
+
+  for (int i = 0; i < bench->connections; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  report_bench(bench, workers, now_ns() - started);
+
+  for (int i = 0; i < bench->connections; i++) {
+    close_connection(workers[i].client);
+    unlink(workers[i].client->client.sun_path);
+    free_client(workers[i].client);
+  }
+
+  pthread_barrier_destroy(&start);
+  free(workers);
+}
+
+/*
+ * recv_reply - used to receive response to message with
+ * given tag. Responses to earlier messages, that came
+ * after their timeout, are skipped.
+ * @client - pointer to an object of client struct
+ * @buffer - buffer for response
+ * @tag - first byte of message payload
+ *
+ * Return: length of response, -1 on timeout
+ */
+static ssize_t recv_reply(struct client* client, char* buffer, char tag) {
+  ssize_t bytes_read;
+
+  while (1) {
+    bytes_read = recv(client->sfd, buffer, BUFFER_SIZE + PREFIX_LEN, 0);
+    if (bytes_read == -1) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+
+    if ((size_t) bytes_read > PREFIX_LEN && buffer[PREFIX_LEN] == tag)
+      return bytes_read;
+  }
+}
+
+/*
+ * run_worker - used in thread to drive one socket.
+ * Sends messages of random sizes one by one and measures
+ * time until response to each of them. First byte of
+ * payload tags message, so late responses are not taken
+ * for responses to next messages.
+ * @arg - pointer to an object of bench_worker struct
+ */
+void* run_worker(void* arg) {
+  struct bench_worker* worker = (struct bench_worker*) arg;
+  struct bench* bench = worker->bench;
+  struct client* client = worker->client;
+  uint32_t range = bench->max_size - bench->min_size + 1;
+  char payload[BUFFER_SIZE];
+  char buffer[BUFFER_SIZE + PREFIX_LEN];
+  struct timeval timeout = {BENCH_TIMEOUT_MS / 1000, BENCH_TIMEOUT_MS % 1000 * 1000};
+
+  memset(payload, 'x', sizeof(payload));
+
+  bind_client(client);
+  if (setsockopt(client->sfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1)
+    print_error("setsockopt");
+
+  pthread_barrier_wait(worker->start);
+
+  for (int i = 0; i < bench->messages; i++) {
+    uint32_t size = bench->min_size + rand_r(&worker->seed) % range;
+    ssize_t bytes_read;
+
+    payload[0] = 'a' + i % 26;
+
+    uint64_t sent_at = now_ns();
+    if (sendto(client->sfd, payload, size, 0, (struct sockaddr*) &client->serv,
+               sizeof(client->serv)) == -1)
+      print_error("send");
+    worker->sent++;
+    worker->bytes += size;
+
+    bytes_read = recv_reply(client, buffer, payload[0]);
+    if (bytes_read == -1) {
+      worker->lost++;
+      continue;
+    }
+
+    histogram_record(&worker->histogram, now_ns() - sent_at);
+    worker->received++;
+  }
+
+  return NULL;
+}
+
+/*
+ * report_bench - used to merge results of all connections
+ * and print throughput and latency percentiles, as text
+ * or as one comma separated row.
+ * @bench - pointer to an object of bench struct
+ * @workers - array of finished workers
+ * @elapsed - duration of load in nanoseconds
+ */
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed) {
+  struct histogram histogram;
+  struct pool_stats stats;
+  unsigned long sent = 0, received = 0;
+  uint64_t bytes = 0;
+  unsigned long lost = 0;
+  double seconds = elapsed / 1e9;
+
+  init_histogram(&histogram);
+  for (int i = 0; i < bench->connections; i++) {
+    histogram_merge(&histogram, &workers[i].histogram);
+    sent += workers[i].sent;
+    received += workers[i].received;
+    bytes += workers[i].bytes;
+    lost += workers[i].lost;
+  }
+
+  /* One row of results table */
+  if (bench->csv) {
+    printf("%d,%d,%u,%u,%d,%lu,%lu,%lu,%.3f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+           bench->connections, bench->messages, bench->min_size, bench->max_size, 1,
+           sent, received, lost, seconds, received / seconds, bytes / seconds / 1e6,
+           histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+           histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+    return;
+  }
+
+  printf("BENCH: %d sockets, %d messages each, %u-%u bytes\n",
+         bench->connections, bench->messages, bench->min_size, bench->max_size);
+  printf("BENCH: %lu sent, %lu received in %.3f s, %lu lost\n", sent, received, seconds, lost);
+  printf("BENCH: throughput %.0f msg/s, %.2f MB/s\n", received / seconds, bytes / seconds / 1e6);
+  printf("BENCH: latency us: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+         histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+         histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+
+  pool_get_stats(&stats);
+  printf("BENCH: pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+}
+
+/*
+ * now_ns - used to read monotonic clock.
+ *
+ * Return: current time in nanoseconds
+ */
+uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
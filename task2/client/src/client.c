@@ -29,16 +29,25 @@ struct client* create_client(const char* client_path, const char* server_path) {
   return client;
 }
 
-/* run_client - used to bind client addr
- * specified int client->client to socket.
+/*
+ * bind_client - used to bind client address
+ * specified in client->client to socket.
  * @client - pointer to an object of client struct
  */
-void run_client(struct client* client) {
+void bind_client(struct client* client) {
   socklen_t client_size = sizeof(client->client);   
    
   if (bind(client->sfd, (struct sockaddr*) &client->client, client_size) == -1)
     print_error("bind");
-  
+}
+
+/* run_client - used to bind client addr
+ * specified int client->client to socket.
+ * @client - pointer to an object of client struct
+ */
+void run_client(struct client* client) {
+  bind_client(client);
+
   /* Process user input */
   process_input(client);
 }
@@ -54,6 +63,7 @@ void process_input(struct client* client) {
   
   /* Wait for user input */
   while (1) {
+    log_flush();
     printf("Enter message: ");
     
     /* Read user input */
@@ -71,8 +81,8 @@ void process_input(struct client* client) {
       break;
     }
 
-    printf("SERVER: Server %s send response: %s\n", client->serv.sun_path, message);
-    free(message);
+    log_info("SERVER: Server %s send response: %s\n", client->serv.sun_path, message);
+    pool_free(message);
   }
 }
 
@@ -90,19 +100,19 @@ void send_message(struct client* client, char buffer[BUFFER_SIZE]) {
   if (bytes_send == -1)
     print_error("sendto");
 
-  printf("CLIENT: Send message to %s: %s\n", client->serv.sun_path, buffer);
+  log_debug("CLIENT: Send message to %s: %s\n", client->serv.sun_path, buffer);
 }
 
 /*
  * recv_message - used to receive message from server.
- * Allocates memory for buffer which should be freed manually.
+ * Allocates buffer from pool which should be freed by pool_free.
  *
  * Return: string (message) if successful, NULL if connection terminated
  */
 char* recv_message(struct client* client) {
   ssize_t bytes_read;
   socklen_t serv_len;
-  char* buffer = (char*) malloc(BUFFER_SIZE * sizeof(char));
+  char* buffer = (char*) pool_alloc(BUFFER_SIZE * sizeof(char));
   
   serv_len = sizeof(client->serv);
   bytes_read = recvfrom(client->sfd, buffer, BUFFER_SIZE, 0, (struct sockaddr*) &client->serv, &serv_len);
@@ -1,11 +1,61 @@
 #include "../headers/client.h"
+#include "../headers/bench.h"
 #include <sys/socket.h>
 
 struct client* client;
 
 void cleanup();
 
-int main(void) {
+/*
+ * Usage: client [-n sockets] [-m messages] [-s size[:max_size]] [-c]
+ * -n - run load generator with given amount of
+ *      sockets instead of reading stdin
+ * -m - amount of messages sent by every socket
+ * -s - size of messages in bytes, or range of
+ *      uniformly distributed sizes
+ * -c - print results of load generator as one
+ *      comma separated row
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  struct bench bench = {0, 10000, 64, 64, 0};
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:m:s:c")) != -1) {
+    switch (opt) {
+      case 'n':
+        bench.connections = atoi(optarg);
+        break;
+      case 'm':
+        bench.messages = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%u:%u", &bench.min_size, &bench.max_size) == 1)
+          bench.max_size = bench.min_size;
+        break;
+      case 'c':
+        bench.csv = 1;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n sockets] [-m messages] [-s size[:max_size]] [-c]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  /* Run load generator */
+  if (bench.connections > 0) {
+    if (bench.min_size < 1 || bench.min_size > bench.max_size || bench.max_size > BUFFER_SIZE - 1) {
+      fprintf(stderr, "Size must be in range 1..%d\n", BUFFER_SIZE - 1);
+      exit(EXIT_FAILURE);
+    }
+
+    run_bench(&bench);
+    exit(EXIT_SUCCESS);
+  }
+
   client = create_client(CLIENT_SOCK_PATH, SERV_SOCK_PATH);
   atexit(cleanup);
   run_client(client);
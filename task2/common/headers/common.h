@@ -10,11 +10,18 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 
 #define CLIENTS_AMOUNT 5
 #define BUFFER_SIZE 128
+#define CACHE_LINE_SIZE 64
+#define BATCH_SIZE 64
+#define PREFIX "Server "
+#define PREFIX_LEN (sizeof(PREFIX) - 1)
 #define SERV_SOCK_PATH "./server_sock"
 #define CLIENT_SOCK_PATH "./client_sock"
+#define ADMIN_SOCK_PATH "./admin_sock"
 #define print_error(msg) do {perror(msg); \
   exit(EXIT_FAILURE);} while(0)
 
@@ -0,0 +1,37 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "common.h"
+
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS (64 * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * Used as log-bucketed histogram of values (latencies in
+ * nanoseconds). Every power of two range is split into
+ * HISTOGRAM_SUB_BUCKETS linear buckets, so recorded values
+ * keep about 6% precision whatever their magnitude and
+ * recording costs one counter increment.
+ */
+struct histogram {
+  /* Amount of values in every bucket */
+  uint64_t counts[HISTOGRAM_BUCKETS];
+
+  /* Amount of recorded values */
+  uint64_t total;
+
+  /* Smallest and largest recorded values (exact) */
+  uint64_t min;
+  uint64_t max;
+};
+
+void init_histogram(struct histogram* histogram);
+
+void histogram_record(struct histogram* histogram, uint64_t value);
+
+void histogram_merge(struct histogram* histogram, const struct histogram* other);
+
+uint64_t histogram_percentile(const struct histogram* histogram, double percentile);
+
+#endif // !HISTOGRAM_H
@@ -0,0 +1,34 @@
+#ifndef MSGBUF_H
+#define MSGBUF_H
+
+#include "common.h"
+#include "pool.h"
+
+/**
+ * Used as message buffer with headroom. Payload is received
+ * (or assembled) behind reserved space, so prefix and length
+ * header of reply are written in place in front of it and
+ * payload is never copied again before send. Struct and its
+ * storage are one pool buffer.
+ */
+struct msgbuf {
+  /* First byte of data, headroom lies in front of it */
+  char* data;
+
+  /* Length of data */
+  uint32_t len;
+
+  /* Free bytes in front of data */
+  uint32_t headroom;
+
+  /* Headroom followed by space for data */
+  char storage[];
+};
+
+struct msgbuf* msgbuf_alloc(uint32_t headroom, uint32_t size);
+
+char* msgbuf_push(struct msgbuf* msgbuf, const void* bytes, uint32_t len);
+
+void msgbuf_free(struct msgbuf* msgbuf);
+
+#endif // !MSGBUF_H
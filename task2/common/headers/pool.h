@@ -0,0 +1,63 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "common.h"
+
+#define POOL_CLASSES 9
+#define POOL_MIN_SHIFT 6
+#define POOL_HEADER_SIZE 16
+#define POOL_CACHE_LIMIT 256
+
+/**
+ * Used as header in front of every pooled buffer.
+ * Holds size class, so buffer can be freed without
+ * its size.
+ */
+struct pool_header {
+  /* Size class, POOL_CLASSES for large buffers */
+  uint32_t size_class;
+};
+
+/**
+ * Used as free buffer in the list of its size class.
+ */
+struct pool_block {
+  struct pool_block* next;
+};
+
+/**
+ * Used as buffers cache of one thread. Buffers of every
+ * size class (CACHE_LINE_SIZE << class bytes, header
+ * included) are kept in free lists, so allocation and
+ * free cost a few instructions and no locks. Caches are
+ * linked to report counters of all threads.
+ */
+struct pool_cache {
+  /* Free buffers of every size class */
+  struct pool_block* blocks[POOL_CLASSES];
+  int blocks_amount[POOL_CLASSES];
+
+  /* Allocations taken from free lists and from malloc */
+  uint64_t hits;
+  uint64_t misses;
+
+  /* Neighbours in list of all caches */
+  struct pool_cache* prev;
+  struct pool_cache* next;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * Used as counters of all caches.
+ */
+struct pool_stats {
+  uint64_t hits;
+  uint64_t misses;
+};
+
+void* pool_alloc(size_t size);
+
+void pool_free(void* buffer);
+
+void pool_get_stats(struct pool_stats* stats);
+
+#endif // !POOL_H
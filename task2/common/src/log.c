@@ -0,0 +1,557 @@
+#include "../headers/log.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/**
+ * Used as types of printf arguments kept in records.
+ */
+enum log_arg {
+  ARG_NONE,
+  ARG_INT,
+  ARG_LONG,
+  ARG_LLONG,
+  ARG_SIZE,
+  ARG_DOUBLE,
+  ARG_STRING,
+  ARG_POINTER
+};
+
+/**
+ * Used as parsed conversion specification of format.
+ */
+struct log_spec {
+  /* First character after specification */
+  const char* end;
+
+  /* Type of argument and amount of '*' in width and precision */
+  enum log_arg type;
+  int stars;
+
+  /* Precision, -1 if not given, -2 if taken from argument */
+  int precision;
+};
+
+/* Names of levels, indexed by enum log_level */
+static const char* log_names[] = {"debug", "info", "warn", "error", "off"};
+
+int log_level = LOG_INFO;
+
+/* Ring of current thread */
+static __thread struct log_ring* log_ring;
+
+/* Key that releases ring when its thread exits */
+static pthread_key_t log_key;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+
+/* Rings of all threads, new ones are added to the head */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_ring* log_rings;
+
+/* Flusher thread */
+static pthread_t log_flusher;
+static int log_running;
+static int log_stopping;
+
+/* Flusher sleeps on futex of wakeups counter, producers
+   wake it only when it announced sleep */
+static uint32_t log_wakeups;
+static int log_sleeping;
+
+/* Threads in log_flush sleep on futex of drains counter */
+static uint32_t log_drains;
+static int log_flush_waiters;
+
+/*
+ * release_ring - used as destructor of thread ring. Ring
+ * keeps its records and is taken by next new thread.
+ * @arg - pointer to an object of log_ring struct
+ */
+static void release_ring(void* arg) {
+  struct log_ring* ring = (struct log_ring*) arg;
+
+  pthread_mutex_lock(&log_lock);
+  ring->owned = 0;
+  pthread_mutex_unlock(&log_lock);
+
+  log_ring = NULL;
+}
+
+/*
+ * create_key - used once to create key of thread rings.
+ */
+static void create_key(void) {
+  if (pthread_key_create(&log_key, release_ring) != 0)
+    print_error("pthread_key_create");
+}
+
+/*
+ * get_ring - used to get ring of current thread. Takes
+ * ring of finished thread or creates new one on first use.
+ *
+ * Return: pointer to an object of log_ring struct
+ */
+static struct log_ring* get_ring(void) {
+  struct log_ring* ring;
+
+  if (log_ring)
+    return log_ring;
+
+  pthread_once(&log_once, create_key);
+  pthread_mutex_lock(&log_lock);
+
+  for (ring = log_rings; ring; ring = ring->next) {
+    if (!ring->owned)
+      break;
+  }
+
+  if (!ring) {
+    ring = (struct log_ring*) aligned_alloc(CACHE_LINE_SIZE, sizeof(struct log_ring));
+    if (!ring)
+      print_error("aligned_alloc");
+    memset(ring, 0, sizeof(struct log_ring));
+
+    ring->next = log_rings;
+    __atomic_store_n(&log_rings, ring, __ATOMIC_RELEASE);
+  }
+
+  ring->owned = 1;
+  pthread_mutex_unlock(&log_lock);
+
+  pthread_setspecific(log_key, ring);
+  log_ring = ring;
+
+  return ring;
+}
+
+/*
+ * parse_spec - used to parse conversion specification
+ * of printf format.
+ * @p - first character after '%'
+ * @spec - pointer where parsed specification is stored
+ */
+static void parse_spec(const char* p, struct log_spec* spec) {
+  int longs = 0, size = 0;
+
+  spec->stars = 0;
+  spec->precision = -1;
+
+  /* Flags, width and precision */
+  while (*p && strchr("-+ #0'", *p))
+    p++;
+  for (; *p == '*' || (*p >= '0' && *p <= '9') || *p == '.'; p++) {
+    if (*p == '*') {
+      spec->stars++;
+      if (spec->precision == 0)
+        spec->precision = -2;
+    } else if (*p == '.') {
+      spec->precision = 0;
+    } else if (spec->precision >= 0) {
+      spec->precision = spec->precision * 10 + (*p - '0');
+    }
+  }
+
+  /* Length modifier */
+  for (; *p && strchr("hlqLjzt", *p); p++) {
+    if (*p == 'l' || *p == 'q' || *p == 'j')
+      longs += *p == 'l' ? 1 : 2;
+    else if (*p == 'z' || *p == 't')
+      size = 1;
+  }
+
+  /* Conversion */
+  if (!*p) {
+    spec->type = ARG_NONE;
+    spec->end = p;
+    return;
+  }
+
+  if (strchr("diouxXc", *p))
+    spec->type = size ? ARG_SIZE : longs >= 2 ? ARG_LLONG : longs ? ARG_LONG : ARG_INT;
+  else if (strchr("fFeEgGaA", *p))
+    spec->type = ARG_DOUBLE;
+  else if (*p == 's')
+    spec->type = ARG_STRING;
+  else if (*p == 'p')
+    spec->type = ARG_POINTER;
+  else
+    spec->type = ARG_NONE;
+
+  spec->end = p + 1;
+}
+
+/*
+ * capture_args - used to store arguments of format in
+ * record without formatting them. Arguments above
+ * LOG_MAX_ARGS are dropped.
+ * @record - pointer to an object of log_record struct
+ * @fmt - printf format
+ * @args - arguments of format
+ */
+static void capture_args(struct log_record* record, const char* fmt, va_list args) {
+  struct log_spec spec;
+
+  record->argc = 0;
+  record->data_len = 0;
+
+  for (const char* p = strchr(fmt, '%'); p; p = strchr(spec.end, '%')) {
+    parse_spec(p + 1, &spec);
+    if (spec.type == ARG_NONE)
+      continue;
+
+    if (record->argc + spec.stars + 1 > LOG_MAX_ARGS)
+      return;
+
+    for (int i = 0; i < spec.stars; i++)
+      record->args[record->argc++] = (uint64_t) va_arg(args, int);
+
+    uint64_t* arg = &record->args[record->argc++];
+
+    switch (spec.type) {
+      case ARG_INT:
+        *arg = (uint64_t) va_arg(args, int);
+        break;
+      case ARG_LONG:
+        *arg = (uint64_t) va_arg(args, long);
+        break;
+      case ARG_LLONG:
+        *arg = (uint64_t) va_arg(args, long long);
+        break;
+      case ARG_SIZE:
+        *arg = (uint64_t) va_arg(args, size_t);
+        break;
+      case ARG_POINTER:
+        *arg = (uint64_t) (uintptr_t) va_arg(args, void*);
+        break;
+      case ARG_DOUBLE: {
+        double value = va_arg(args, double);
+        memcpy(arg, &value, sizeof(value));
+        break;
+      }
+      case ARG_STRING: {
+        const char* string = va_arg(args, const char*);
+        size_t space = LOG_DATA_SIZE - record->data_len;
+        size_t max = SIZE_MAX;
+
+        /* String limited by precision may be unterminated,
+           '*' of precision is argument in front of it */
+        if (spec.precision == -2 && (int) arg[-1] >= 0)
+          max = (int) arg[-1];
+        else if (spec.precision >= 0)
+          max = spec.precision;
+
+        if (!string)
+          string = "(null)";
+        size_t len = strnlen(string, max);
+
+        /* Full data ends with terminator of previous string */
+        if (space == 0) {
+          *arg = LOG_DATA_SIZE - 1;
+          break;
+        }
+
+        if (len > space - 1)
+          len = space - 1;
+        memcpy(record->data + record->data_len, string, len);
+        record->data[record->data_len + len] = '\0';
+
+        *arg = record->data_len;
+        record->data_len += len + 1;
+        break;
+      }
+      case ARG_NONE:
+        break;
+    }
+  }
+}
+
+/*
+ * format_record - used to format record the way printf
+ * would and write it to stdout (stderr for warnings and
+ * errors).
+ * @record - pointer to an object of log_record struct
+ */
+static void format_record(struct log_record* record) {
+  char line[LOG_LINE_SIZE];
+  size_t len = 0;
+  int argc = 0;
+
+  for (const char* p = record->fmt; *p && len < sizeof(line) - 1;) {
+    if (*p != '%') {
+      line[len++] = *p++;
+      continue;
+    }
+
+    struct log_spec spec;
+    parse_spec(p + 1, &spec);
+
+    /* Literal text, "%%" and arguments that were dropped */
+    if (spec.type == ARG_NONE || argc + spec.stars + 1 > record->argc) {
+      if (p[1] == '%') {
+        line[len++] = '%';
+        p += 2;
+      } else {
+        while (p < spec.end && len < sizeof(line) - 1)
+          line[len++] = *p++;
+      }
+      continue;
+    }
+
+    /* Put values of '*' into specification */
+    char conv[64];
+    size_t conv_len = 0;
+
+    for (; p < spec.end && conv_len < sizeof(conv) - 16; p++) {
+      if (*p == '*')
+        conv_len += sprintf(conv + conv_len, "%d", (int) record->args[argc++]);
+      else
+        conv[conv_len++] = *p;
+    }
+    conv[conv_len] = '\0';
+    p = spec.end;
+
+    uint64_t arg = record->args[argc++];
+    size_t space = sizeof(line) - len;
+    int written = 0;
+
+    switch (spec.type) {
+      case ARG_INT:
+        written = snprintf(line + len, space, conv, (int) arg);
+        break;
+      case ARG_LONG:
+        written = snprintf(line + len, space, conv, (long) arg);
+        break;
+      case ARG_LLONG:
+        written = snprintf(line + len, space, conv, (long long) arg);
+        break;
+      case ARG_SIZE:
+        written = snprintf(line + len, space, conv, (size_t) arg);
+        break;
+      case ARG_POINTER:
+        written = snprintf(line + len, space, conv, (void*) (uintptr_t) arg);
+        break;
+      case ARG_DOUBLE: {
+        double value;
+        memcpy(&value, &arg, sizeof(value));
+        written = snprintf(line + len, space, conv, value);
+        break;
+      }
+      case ARG_STRING:
+        written = snprintf(line + len, space, conv, record->data + arg);
+        break;
+      case ARG_NONE:
+        break;
+    }
+
+    if (written > 0)
+      len += (size_t) written < space ? (size_t) written : space - 1;
+  }
+
+  /* Keep end of line of truncated message */
+  if (len == sizeof(line) - 1 && line[len - 1] != '\n')
+    line[len - 1] = '\n';
+
+  fwrite(line, 1, len, record->level >= LOG_WARN ? stderr : stdout);
+}
+
+/*
+ * drain_rings - used to print records of all rings.
+ *
+ * Return: amount of printed records
+ */
+static size_t drain_rings(void) {
+  size_t total = 0;
+
+  for (struct log_ring* ring = __atomic_load_n(&log_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+    size_t tail = ring->tail;
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+
+    if (dropped)
+      fprintf(stderr, "LOG: %lu message(s) dropped\n", dropped);
+
+    if (tail == head)
+      continue;
+
+    total += head - tail;
+    for (; tail != head; tail++)
+      format_record(&ring->records[tail & (LOG_RING_SIZE - 1)]);
+
+    /* Records are free when they reached streams */
+    fflush(stdout);
+    fflush(stderr);
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+  }
+
+  return total;
+}
+
+/*
+ * wake_flusher - used to wake flusher thread if it sleeps.
+ * Pairs with fence of run_flusher: either producer sees
+ * flusher asleep or flusher sees new record.
+ */
+static void wake_flusher(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_load_n(&log_sleeping, __ATOMIC_RELAXED))
+    return;
+
+  __atomic_fetch_add(&log_wakeups, 1, __ATOMIC_RELEASE);
+  syscall(SYS_futex, &log_wakeups, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/*
+ * run_flusher - used as routine of flusher thread. Prints
+ * records of all rings, sleeps on futex until producer
+ * wakes it when there are none, so idle program costs
+ * no wakeups.
+ * @arg - unused
+ */
+static void* run_flusher(void* arg) {
+  (void) arg;
+
+  while (!__atomic_load_n(&log_stopping, __ATOMIC_ACQUIRE)) {
+    if (drain_rings() > 0) {
+      /* Wake threads waiting for their records */
+      __atomic_fetch_add(&log_drains, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&log_flush_waiters, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &log_drains, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+      continue;
+    }
+
+    /* Announce sleep, then look at rings once more */
+    uint32_t wakeups = __atomic_load_n(&log_wakeups, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&log_sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (drain_rings() == 0 && !__atomic_load_n(&log_stopping, __ATOMIC_ACQUIRE))
+      syscall(SYS_futex, &log_wakeups, FUTEX_WAIT_PRIVATE, wakeups, NULL, NULL, 0);
+
+    __atomic_store_n(&log_sleeping, 0, __ATOMIC_RELAXED);
+  }
+
+  return NULL;
+}
+
+/*
+ * log_init - used to start flusher thread. Level is taken
+ * from LOG_LEVEL environment variable (debug, info, warn,
+ * error, off), info by default. Remaining records are
+ * printed when program exits.
+ */
+void log_init(void) {
+  const char* name = getenv("LOG_LEVEL");
+
+  if (log_running)
+    return;
+
+  if (name) {
+    int level = log_parse_level(name);
+    if (level == -1)
+      fprintf(stderr, "Unknown log level: %s\n", name);
+    else
+      log_set_level(level);
+  }
+
+  if (pthread_create(&log_flusher, NULL, run_flusher, NULL) != 0)
+    print_error("pthread_create");
+
+  log_running = 1;
+  atexit(log_shutdown);
+}
+
+/*
+ * log_parse_level - used to find level by its name.
+ * @name - name of level
+ *
+ * Return: level, -1 if name is unknown
+ */
+int log_parse_level(const char* name) {
+  for (int i = LOG_DEBUG; i <= LOG_OFF; i++) {
+    if (strcmp(name, log_names[i]) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+/*
+ * log_set_level - used to change level at runtime.
+ * @level - lowest level of printed messages
+ */
+void log_set_level(enum log_level level) {
+  __atomic_store_n(&log_level, level, __ATOMIC_RELAXED);
+}
+
+/*
+ * log_write - used to put message into ring of current
+ * thread. Message is formatted later by flusher thread,
+ * so call costs a few copies (and system call only if
+ * flusher sleeps). Message is dropped when ring is full.
+ * Should be called by log_* macros.
+ * @level - level of message
+ * @fmt - printf format, must live until program exits
+ */
+void log_write(enum log_level level, const char* fmt, ...) {
+  struct log_ring* ring = get_ring();
+  size_t head = ring->head;
+  va_list args;
+
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == LOG_RING_SIZE) {
+    __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  struct log_record* record = &ring->records[head & (LOG_RING_SIZE - 1)];
+
+  record->fmt = fmt;
+  record->level = level;
+
+  va_start(args, fmt);
+  capture_args(record, fmt, args);
+  va_end(args);
+
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  wake_flusher();
+}
+
+/*
+ * log_flush - used to wait until messages of current
+ * thread are printed, e.g. before prompting user.
+ */
+void log_flush(void) {
+  struct log_ring* ring = log_ring;
+
+  if (!ring || !__atomic_load_n(&log_running, __ATOMIC_ACQUIRE))
+    return;
+
+  __atomic_fetch_add(&log_flush_waiters, 1, __ATOMIC_SEQ_CST);
+  while (1) {
+    uint32_t drains = __atomic_load_n(&log_drains, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == ring->head)
+      break;
+    syscall(SYS_futex, &log_drains, FUTEX_WAIT_PRIVATE, drains, NULL, NULL, 0);
+  }
+  __atomic_fetch_sub(&log_flush_waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * log_shutdown - used to stop flusher thread and print
+ * records that are left. Called when program exits.
+ */
+void log_shutdown(void) {
+  if (!log_running)
+    return;
+
+  __atomic_store_n(&log_stopping, 1, __ATOMIC_RELEASE);
+  wake_flusher();
+  pthread_join(log_flusher, NULL);
+  __atomic_store_n(&log_running, 0, __ATOMIC_RELEASE);
+
+  pthread_mutex_lock(&log_lock);
+  drain_rings();
+  pthread_mutex_unlock(&log_lock);
+
+  __atomic_fetch_add(&log_drains, 1, __ATOMIC_SEQ_CST);
+  syscall(SYS_futex, &log_drains, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
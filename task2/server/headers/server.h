@@ -2,6 +2,9 @@
 #define SERVER_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/admin.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/msgbuf.h"
 
 /**
  * Used to create server on local adress family (AF_LOCAL) with
@@ -13,17 +16,41 @@ struct server {
   
   /* Socket file descriptor */
   int sfd;
+
+  /* Max amount of datagrams received and sent by one call */
+  int batch_size;
+
+  /* Preallocated headers, addresses and buffers of the batch */
+  struct mmsghdr* in_msgs;
+  struct mmsghdr* out_msgs;
+  struct iovec* in_iovs;
+  struct iovec* out_iovs;
+  struct sockaddr_un* addrs;
+  char* in_buffers;
+
+  /* Socket that answers with metrics */
+  struct admin admin;
 };
 
-struct server* create_server(const char* path);
+struct server* create_server(const char* path, int batch_size);
 
 void run_server(struct server* server);
 
-void send_message(struct server* server, struct sockaddr_un* client, char buffer[BUFFER_SIZE]);
+void run_batch_server(struct server* server);
+
+int recv_messages(struct server* server);
+
+void edit_messages(struct server* server, int amount);
+
+void send_messages(struct server* server, int amount);
+
+void count_replies(struct server* server, int first, int amount);
+
+void send_message(struct server* server, struct sockaddr_un* client, struct msgbuf* message);
   
-char* recv_message(struct server* server, struct sockaddr_un* client);
+struct msgbuf* recv_message(struct server* server, struct sockaddr_un* client);
 
-char* edit_message(char* message);
+void edit_message(struct msgbuf* message);
 
 void close_connection(struct server* server);
 
@@ -4,8 +4,34 @@ struct server* server;
 
 void cleanup();
 
-int main(void) {
-  server = create_server(SERV_SOCK_PATH);
+/*
+ * Usage: server [-n batch]
+ * -n - max amount of datagrams handled by one system
+ *      call (BATCH_SIZE by default, 1 - one by one)
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  int batch_size = BATCH_SIZE;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    switch (opt) {
+      case 'n':
+        batch_size = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n batch]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  if (batch_size < 1)
+    batch_size = 1;
+
+  server = create_server(SERV_SOCK_PATH, batch_size);
   atexit(cleanup);
   run_server(server); 
   exit(EXIT_SUCCESS);
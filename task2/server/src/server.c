@@ -7,10 +7,12 @@
  * create_server - used to create an object of server
  * struct, initializes its fields.
  * @path - path to socket file
+ * @batch_size - max amount of datagrams handled by one
+ * system call, 1 to handle datagrams one by one
  *
  * Return: pointer to an object of server struct 
  */
-struct server* create_server(const char* path) {
+struct server* create_server(const char* path, int batch_size) {
   struct server* server = (struct server*) malloc(sizeof(struct server));
   if (!server)
     print_error("malloc");
@@ -25,12 +27,42 @@ struct server* create_server(const char* path) {
   if (server->sfd == -1)
     print_error("socket");
 
+  /* Allocate batch once, it is reused by every call */
+  server->batch_size = batch_size;
+  server->admin.sfd = -1;
+  server->in_msgs = (struct mmsghdr*) calloc(batch_size, sizeof(struct mmsghdr));
+  server->out_msgs = (struct mmsghdr*) calloc(batch_size, sizeof(struct mmsghdr));
+  server->in_iovs = (struct iovec*) calloc(batch_size, sizeof(struct iovec));
+  server->out_iovs = (struct iovec*) calloc(batch_size * 2, sizeof(struct iovec));
+  server->addrs = (struct sockaddr_un*) calloc(batch_size, sizeof(struct sockaddr_un));
+  server->in_buffers = (char*) malloc(batch_size * BUFFER_SIZE);
+  if (!server->in_msgs || !server->out_msgs || !server->in_iovs || !server->out_iovs ||
+      !server->addrs || !server->in_buffers)
+    print_error("malloc");
+
+  /* Incoming datagrams land in their own buffer, reply is prefix
+     followed by the same buffer and goes back to sender */
+  for (int i = 0; i < batch_size; i++) {
+    server->in_iovs[i].iov_base = server->in_buffers + i * BUFFER_SIZE;
+    server->in_iovs[i].iov_len = BUFFER_SIZE;
+    server->in_msgs[i].msg_hdr.msg_iov = &server->in_iovs[i];
+    server->in_msgs[i].msg_hdr.msg_iovlen = 1;
+    server->in_msgs[i].msg_hdr.msg_name = &server->addrs[i];
+
+    server->out_iovs[i * 2].iov_base = PREFIX;
+    server->out_iovs[i * 2].iov_len = PREFIX_LEN;
+    server->out_iovs[i * 2 + 1].iov_base = server->in_iovs[i].iov_base;
+    server->out_msgs[i].msg_hdr.msg_iov = &server->out_iovs[i * 2];
+    server->out_msgs[i].msg_hdr.msg_iovlen = 2;
+    server->out_msgs[i].msg_hdr.msg_name = &server->addrs[i];
+  }
+
   return server;
 }
 
 /*
- * run_server - used to bind server, set it
- * to passive mode and accept connections
+ * run_server - used to bind server, start admin
+ * socket and serve datagrams
  * @server - pointer to an object of server struct
  */
 void run_server(struct server* server) {
@@ -41,85 +73,201 @@ void run_server(struct server* server) {
   if (bind(server->sfd, (struct sockaddr*) &server->serv, sizeof(server->serv)) == -1)
     print_error("bind");
     
-  printf("SERVER: Server %s started\n", server->serv.sun_path);
+  log_info("SERVER: Server %s started\n", server->serv.sun_path);
+  start_admin(&server->admin, ADMIN_SOCK_PATH, NULL, NULL);
+
+  if (server->batch_size > 1) {
+    run_batch_server(server);
+    return;
+  }
 
   /* Wait for data */
   while (1) {
-    char* buffer = recv_message(server, &client);
-    char* reply = edit_message(buffer);
-    
-    printf("SERVER: Received message from %s: %s\n", client.sun_path, buffer);
-    send_message(server, &client, reply);
+    struct msgbuf* message = recv_message(server, &client);
+    if (!message)
+      continue;
+
+    log_debug("SERVER: Received message from %s: %s\n", client.sun_path, message->data);
+    uint64_t start = metrics_now();
+    edit_message(message);
+    metrics_record(STAGE_TRANSFORM, start);
+    send_message(server, &client, message);
+
+    msgbuf_free(message);
+  }
+}
+
+/*
+ * run_batch_server - used to receive, edit and answer
+ * datagrams in batches. Each iteration costs one recvmmsg
+ * and one sendmmsg call and no allocations.
+ * @server - pointer to an object of server struct
+ */
+void run_batch_server(struct server* server) {
+  while (1) {
+    int amount = recv_messages(server);
+
+    uint64_t start = metrics_now();
+    edit_messages(server, amount);
+    metrics_record(STAGE_TRANSFORM, start);
+    send_messages(server, amount);
+
+    log_debug("SERVER: Answered %d datagram(s)\n", amount);
+  }
+}
+
+/*
+ * recv_messages - used to receive batch of datagrams into
+ * preallocated buffers. Waits for first datagram only, then
+ * takes whatever else is already queued.
+ * @server - pointer to an object of server struct
+ *
+ * Return: amount of received datagrams
+ */
+int recv_messages(struct server* server) {
+  int amount;
+
+  /* Reset lengths changed by previous call */
+  for (int i = 0; i < server->batch_size; i++)
+    server->in_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_un);
+
+  do {
+    amount = recvmmsg(server->sfd, server->in_msgs, server->batch_size, MSG_WAITFORONE, NULL);
+  } while (amount == -1 && errno == EINTR);
+
+  if (amount == -1)
+    print_error("recvmmsg");
+
+  metrics_add(METRIC_MESSAGES_IN, amount);
+  for (int i = 0; i < amount; i++)
+    metrics_add(METRIC_BYTES_IN, server->in_msgs[i].msg_len);
 
-    free(buffer);
-    free(reply);
+  return amount;
+}
+
+/*
+ * edit_messages - used to add prefix "Server " to received
+ * datagrams. Reply gathers static prefix and received
+ * payload, so nothing is copied.
+ * @server - pointer to an object of server struct
+ * @amount - amount of received datagrams
+ */
+void edit_messages(struct server* server, int amount) {
+  for (int i = 0; i < amount; i++) {
+    server->out_iovs[i * 2 + 1].iov_len = server->in_msgs[i].msg_len;
+    server->out_msgs[i].msg_hdr.msg_namelen = server->in_msgs[i].msg_hdr.msg_namelen;
   }
 }
 
+/*
+ * send_messages - used to send replies of the batch with
+ * as few sendmmsg calls as possible. Reply that can't be
+ * delivered is skipped, so one gone client doesn't stop
+ * the others.
+ * @server - pointer to an object of server struct
+ * @amount - amount of replies
+ */
+void send_messages(struct server* server, int amount) {
+  int sent = 0;
+
+  while (sent < amount) {
+    uint64_t start = metrics_now();
+    int result = sendmmsg(server->sfd, server->out_msgs + sent, amount - sent, 0);
+    metrics_record(STAGE_SEND, start);
+    if (result == -1) {
+      if (errno == EINTR)
+        continue;
+
+      /* Client socket is gone or unnamed, drop its reply */
+      log_warn("SERVER: Reply to %s dropped: %s\n", server->addrs[sent].sun_path, strerror(errno));
+      sent++;
+      continue;
+    }
+
+    count_replies(server, sent, result);
+    sent += result;
+  }
+}
+
+/*
+ * count_replies - used to count sent replies and their
+ * bytes in metrics.
+ * @server - pointer to an object of server struct
+ * @first - index of first sent reply
+ * @amount - amount of sent replies
+ */
+void count_replies(struct server* server, int first, int amount) {
+  metrics_add(METRIC_MESSAGES_OUT, amount);
+  for (int i = first; i < first + amount; i++)
+    metrics_add(METRIC_BYTES_OUT, PREFIX_LEN + server->out_iovs[i * 2 + 1].iov_len);
+}
+
 /*
  * send_message - used to send message to client.
  * @server - pointer to an object of server struct
  * @client - address of client (sockaddr_un)
- * @buffer - message
+ * @message - message with prefix
  */
-void send_message(struct server* server, struct sockaddr_un* client, char buffer[BUFFER_SIZE]) {
+void send_message(struct server* server, struct sockaddr_un* client, struct msgbuf* message) {
   ssize_t bytes_send;
   socklen_t client_len = sizeof(*client);
 
-  bytes_send = sendto(server->sfd, buffer, strlen(buffer), 0, (struct sockaddr*) client, client_len);
+  uint64_t start = metrics_now();
+  bytes_send = sendto(server->sfd, message->data, message->len, 0, (struct sockaddr*) client, client_len);
+  metrics_record(STAGE_SEND, start);
 
   if (bytes_send == -1)
     print_error("sendto");
 
-  printf("SERVER: Send message to %s: %s\n", client->sun_path, buffer);
+  metrics_add(METRIC_MESSAGES_OUT, 1);
+  metrics_add(METRIC_BYTES_OUT, bytes_send);
+
+  log_debug("SERVER: Send message to %s: %s\n", client->sun_path, message->data);
 }
 
 /*
  * recv_message - used to receive message from server.
- * allocates memory for message, then receives it all. Allocated
- * buffer must be freed manually.
+ * Datagram is received behind PREFIX_LEN bytes of headroom and
+ * terminated. Message buffer must be freed by msgbuf_free.
  * @server - pointer to an object of server struct
  * @client - address of client (sockaddr_un)
  *
- * Return: string (message) if successful, NULL if connection terminated
+ * Return: message buffer if successful, NULL if connection terminated
  */
-char* recv_message(struct server* server, struct sockaddr_un* client) {
+struct msgbuf* recv_message(struct server* server, struct sockaddr_un* client) {
   ssize_t bytes_read;
   socklen_t client_len;
-  char* buffer = (char*) malloc(BUFFER_SIZE * sizeof(char));
+  struct msgbuf* message = msgbuf_alloc(PREFIX_LEN, BUFFER_SIZE + 1);
   
   client_len = sizeof(*client);
 
-  bytes_read = recvfrom(server->sfd, buffer, BUFFER_SIZE, 0, (struct sockaddr*) client, &client_len);  
+  bytes_read = recvfrom(server->sfd, message->data, BUFFER_SIZE, 0, (struct sockaddr*) client, &client_len);  
   
-  /* Truncate buffer */
-  buffer[bytes_read] = '\0';
-
   if (bytes_read == -1)
     print_error("recvfrom");
-  else if (bytes_read == 0)
+  else if (bytes_read == 0) {
+    msgbuf_free(message);
     return NULL;
+  }
+
+  /* Truncate message */
+  message->data[bytes_read] = '\0';
+  message->len = bytes_read;
 
-  return buffer;
+  metrics_add(METRIC_MESSAGES_IN, 1);
+  metrics_add(METRIC_BYTES_IN, bytes_read);
+
+  return message;
 }
 
 /*
- * edit_message - used to add prefix "Server" to message.
- * Allocates new buffer. Return buffer should be free manually.
+ * edit_message - used to add prefix "Server " to message.
+ * Prefix is written in headroom in front of payload, so
+ * payload isn't copied.
  * @message - message from client that needs to be changed
- * 
- * Return: string with prefix
  */
-char* edit_message(char* message) {
-  char* prefix = "Server";
-  char* new_message = (char*) malloc(strlen(message) + strlen(prefix) + 2);
-  if (!new_message)
-    print_error("malloc");
-
-  /* Add prefix to message */
-  snprintf(new_message, strlen(message) + strlen(prefix) + 2, "%s %s", "Server", message);
-
-  return new_message;
+void edit_message(struct msgbuf* message) {
+  msgbuf_push(message, PREFIX, PREFIX_LEN);
 }
 
 /*
@@ -136,5 +284,18 @@ void close_connection(struct server* server) {
  * @server - pointer to an object of server struct
  */
 void free_server(struct server* server) {
+  struct pool_stats stats;
+
+  stop_admin(&server->admin);
+
+  pool_get_stats(&stats);
+  log_info("SERVER: Pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+
+  free(server->in_msgs);
+  free(server->out_msgs);
+  free(server->in_iovs);
+  free(server->out_iovs);
+  free(server->addrs);
+  free(server->in_buffers);
   free(server);
 }
@@ -0,0 +1,71 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "client.h"
+#include "../../common/headers/histogram.h"
+
+/**
+ * Used as parameters of closed-loop load generation:
+ * every connection sends window messages, waits for all
+ * responses and sends next ones, until it has sent its
+ * messages. Sizes of messages are uniformly distributed
+ * in range min_size..max_size.
+ */
+struct bench {
+  /* Amount of connections (one thread each) */
+  int connections;
+
+  /* Amount of messages sent by every connection */
+  int messages;
+
+  /* Amount of messages in flight on every connection */
+  int window;
+
+  /* Range of message sizes in bytes */
+  uint32_t min_size;
+  uint32_t max_size;
+
+  /* Print results as one comma separated row */
+  int csv;
+};
+
+/**
+ * Used as state of one connection of load generator.
+ * Counters and histogram are private to its thread and
+ * merged once all threads finish.
+ */
+struct bench_worker {
+  struct bench* bench;
+
+  /* Connection to the server */
+  struct client* client;
+
+  pthread_t thread;
+
+  /* Barrier that starts all connections at once */
+  pthread_barrier_t* start;
+
+  /* Seed of message sizes */
+  unsigned int seed;
+
+  /* Sent and answered messages, sent payload bytes */
+  unsigned long sent;
+  unsigned long received;
+  uint64_t bytes;
+
+  /* Connection failed before all messages were answered */
+  int failed;
+
+  /* Latencies of answered messages in nanoseconds */
+  struct histogram histogram;
+};
+
+void run_bench(struct bench* bench);
+
+void* run_worker(void* arg);
+
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed);
+
+uint64_t now_ns(void);
+
+#endif // !BENCH_H
@@ -2,6 +2,8 @@
 #define CLIENT_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/decoder.h"
 #include "../../common/headers/endpoint.h"
 
 /*
@@ -13,21 +15,31 @@ struct client {
   struct sockaddr_in serv;
   
   /* IP and port of server */
-  struct endpoint* serv_endpoint;
+  struct endpoint serv_endpoint;
 
   /* Server file descriptor*/
   int sfd;
+
+  /* Received bytes and messages that were not taken yet */
+  struct decoder decoder;
+
+  /* Amount of messages sent before waiting for responses */
+  int window;
 };
 
-struct client* create_client(const char* ip, const int port);
+struct client* create_client(const char* ip, const int port, int window);
+
+void connect_client(struct client* client);
 
 void run_client(struct client* client);
 
 void process_input(struct client* client);
 
-void send_message(struct client* client, const char* buffer);
+void send_messages(struct client* client, const char** messages, int count);
+
+int send_frames(struct client* client, struct iovec* iov, int count);
 
-char* recv_message(struct client* client);
+struct msgbuf* recv_message(struct client* client);
 
 void shutdown_connection(struct client* client);
 
@@ -0,0 +1,211 @@
+#include "../headers/bench.h"
+#include <time.h>
+
+/*
+ * run_bench - used to run closed-loop load generation.
+ * Connects all connections, starts them at once, waits
+ * until every connection has sent its messages and
+ * prints report.
+ * @bench - pointer to an object of bench struct
+ */
+void run_bench(struct bench* bench) {
+  struct bench_worker* workers = (struct bench_worker*) calloc(bench->connections, sizeof(struct bench_worker));
+  pthread_barrier_t start;
+  uint64_t started;
+
+  if (!workers)
+    print_error("calloc");
+
+  if (pthread_barrier_init(&start, NULL, bench->connections + 1) != 0)
+    print_error("pthread_barrier_init");
+
+  for (int i = 0; i < bench->connections; i++) {
+    struct bench_worker* worker = &workers[i];
+
+    worker->bench = bench;
+    worker->start = &start;
+    worker->seed = time(NULL) + i;
+    worker->client = create_client(SERVER_IP, SERVER_PORT, bench->window);
+    init_histogram(&worker->histogram);
+
+    if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0)
+      print_error("pthread_create");
+  }
+
+  /* Start measuring once all connections are established */
+  pthread_barrier_wait(&start);
+  started = now_ns();
+
+  for (int i = 0; i < bench->connections; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  report_bench(bench, workers, now_ns() - started);
+
+  for (int i = 0; i < bench->connections; i++) {
+    shutdown_connection(workers[i].client);
+    free_client(workers[i].client);
+  }
+
+  pthread_barrier_destroy(&start);
+  free(workers);
+}
+
+/*
+ * recv_frame - used to take next response from decoder
+ * without logging, receiving more bytes when needed.
+ * @client - pointer to an object of client struct
+ * @frame - pointer where received frame is stored
+ *
+ * Return: 0 if frame received, -1 if connection failed
+ */
+static int recv_frame(struct client* client, struct msgbuf** frame) {
+  while (1) {
+    switch (decoder_next(&client->decoder, 0, frame)) {
+      case FRAME_OK:
+        return 0;
+
+      case FRAME_TOO_BIG:
+        return -1;
+
+      case FRAME_PARTIAL:
+        break;
+    }
+
+    if (decoder_fill(&client->decoder, client->sfd) <= 0)
+      return -1;
+  }
+}
+
+/*
+ * run_worker - used in thread to drive one connection.
+ * Sends window messages of random sizes in one gathered
+ * send and measures time until response to each of them.
+ * @arg - pointer to an object of bench_worker struct
+ */
+void* run_worker(void* arg) {
+  struct bench_worker* worker = (struct bench_worker*) arg;
+  struct bench* bench = worker->bench;
+  struct client* client = worker->client;
+  struct iovec iov[REPLIES_AMOUNT * 2];
+  uint32_t net_lens[REPLIES_AMOUNT];
+  uint32_t sizes[REPLIES_AMOUNT];
+  uint32_t range = bench->max_size - bench->min_size + 1;
+  int left = bench->messages;
+
+  /* Payload of every message is part of the same buffer */
+  char* payload = (char*) malloc(bench->max_size);
+  if (!payload)
+    print_error("malloc");
+  memset(payload, 'x', bench->max_size);
+
+  connect_client(client);
+  pthread_barrier_wait(worker->start);
+
+  while (left > 0 && !worker->failed) {
+    int count = left < bench->window ? left : bench->window;
+
+    for (int i = 0; i < count; i++) {
+      sizes[i] = bench->min_size + rand_r(&worker->seed) % range;
+      net_lens[i] = htonl(sizes[i]);
+
+      iov[i * 2].iov_base = &net_lens[i];
+      iov[i * 2].iov_len = sizeof(net_lens[i]);
+      iov[i * 2 + 1].iov_base = payload;
+      iov[i * 2 + 1].iov_len = sizes[i];
+      worker->bytes += sizes[i];
+    }
+
+    uint64_t sent_at = now_ns();
+    if (send_frames(client, iov, count * 2) == -1) {
+      worker->failed = 1;
+      break;
+    }
+    worker->sent += count;
+    left -= count;
+
+    /* Responses come in order of messages */
+    for (int i = 0; i < count; i++) {
+      struct msgbuf* frame;
+      uint32_t frame_len;
+
+      if (recv_frame(client, &frame) == -1) {
+        worker->failed = 1;
+        break;
+      }
+
+      histogram_record(&worker->histogram, now_ns() - sent_at);
+      frame_len = frame->len;
+      msgbuf_free(frame);
+
+      if (frame_len != sizes[i] + PREFIX_LEN) {
+        worker->failed = 1;
+        break;
+      }
+      worker->received++;
+    }
+  }
+
+  free(payload);
+
+  return NULL;
+}
+
+/*
+ * report_bench - used to merge results of all connections
+ * and print throughput and latency percentiles, as text
+ * or as one comma separated row.
+ * @bench - pointer to an object of bench struct
+ * @workers - array of finished workers
+ * @elapsed - duration of load in nanoseconds
+ */
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed) {
+  struct histogram histogram;
+  struct pool_stats stats;
+  unsigned long sent = 0, received = 0;
+  uint64_t bytes = 0;
+  int failed = 0;
+  double seconds = elapsed / 1e9;
+
+  init_histogram(&histogram);
+  for (int i = 0; i < bench->connections; i++) {
+    histogram_merge(&histogram, &workers[i].histogram);
+    sent += workers[i].sent;
+    received += workers[i].received;
+    bytes += workers[i].bytes;
+    failed += workers[i].failed;
+  }
+
+  /* One row of results table */
+  if (bench->csv) {
+    printf("%d,%d,%u,%u,%d,%lu,%lu,%d,%.3f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+           bench->connections, bench->messages, bench->min_size, bench->max_size, bench->window,
+           sent, received, failed, seconds, received / seconds, bytes / seconds / 1e6,
+           histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+           histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+    return;
+  }
+
+  printf("BENCH: %d connections, %d messages each, %u-%u bytes, window %d\n",
+         bench->connections, bench->messages, bench->min_size, bench->max_size, bench->window);
+  printf("BENCH: %lu sent, %lu received in %.3f s, %d connections failed\n", sent, received, seconds, failed);
+  printf("BENCH: throughput %.0f msg/s, %.2f MB/s\n", received / seconds, bytes / seconds / 1e6);
+  printf("BENCH: latency us: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+         histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+         histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+
+  pool_get_stats(&stats);
+  printf("BENCH: pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+}
+
+/*
+ * now_ns - used to read monotonic clock.
+ *
+ * Return: current time in nanoseconds
+ */
+uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
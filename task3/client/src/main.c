@@ -1,11 +1,71 @@
 #include "../headers/client.h"
+#include "../headers/bench.h"
 
 struct client* client;
 
 void cleanup();
 
-int main(void) {
-  client = create_client(SERVER_IP, SERVER_PORT);
+/*
+ * Usage: client [-w window] [-n connections] [-m messages] [-s size[:max_size]] [-c]
+ * -w - amount of messages sent before waiting
+ *      for responses (1 by default)
+ * -n - run load generator with given amount of
+ *      connections instead of reading stdin
+ * -m - amount of messages sent by every connection
+ * -s - size of messages in bytes, or range of
+ *      uniformly distributed sizes
+ * -c - print results of load generator as one
+ *      comma separated row
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  struct bench bench = {0, 10000, 1, 64, 64, 0};
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w:n:m:s:c")) != -1) {
+    switch (opt) {
+      case 'w':
+        bench.window = atoi(optarg);
+        break;
+      case 'n':
+        bench.connections = atoi(optarg);
+        break;
+      case 'm':
+        bench.messages = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%u:%u", &bench.min_size, &bench.max_size) == 1)
+          bench.max_size = bench.min_size;
+        break;
+      case 'c':
+        bench.csv = 1;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-w window] [-n connections] [-m messages] [-s size[:max_size]] [-c]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  if (bench.window < 1 || bench.window > REPLIES_AMOUNT) {
+    fprintf(stderr, "Window must be in range 1..%d\n", REPLIES_AMOUNT);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Run load generator */
+  if (bench.connections > 0) {
+    if (bench.min_size < 1 || bench.min_size > bench.max_size || bench.max_size > MAX_FRAME_SIZE - PREFIX_LEN) {
+      fprintf(stderr, "Size must be in range 1..%lu\n", MAX_FRAME_SIZE - PREFIX_LEN);
+      exit(EXIT_FAILURE);
+    }
+
+    run_bench(&bench);
+    exit(EXIT_SUCCESS);
+  }
+
+  client = create_client(SERVER_IP, SERVER_PORT, bench.window);
   atexit(cleanup);
   run_client(client);
   exit(EXIT_SUCCESS);
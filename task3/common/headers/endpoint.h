@@ -2,18 +2,24 @@
 #define ENDPOINT_H
 
 #include "common.h"
+#include <arpa/inet.h>
+
+/* "[" + IPv6 address + "]:" + port */
+#define ENDPOINT_SIZE (INET6_ADDRSTRLEN + 8)
 
 /**
- * Used as data struct containing ip address and port
- * converter from sockaddr_in struct from network type (Big Endian)
- * to host type (Little Endian).
+ * Used as printable address of connection. It is formatted
+ * once, when connection is created, into inline buffer, so
+ * logs, metrics and admin table just read it.
  */
 struct endpoint {
-  char* ip;
-  int port;
+  /* "ip:port" for IPv4, "[ip]:port" for IPv6 */
+  char text[ENDPOINT_SIZE];
+
+  /* Port in host byte order */
+  uint16_t port;
 };
 
-struct endpoint* addr_to_endpoint(struct sockaddr_in* addr);
+void addr_to_endpoint(const struct sockaddr* addr, struct endpoint* endpoint);
 
 #endif // !ENDPOINT_H
-
@@ -0,0 +1,92 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "common.h"
+#include <stdarg.h>
+
+#define LOG_RING_SIZE 256
+#define LOG_MAX_ARGS 8
+#define LOG_DATA_SIZE 176
+#define LOG_LINE_SIZE 512
+
+/**
+ * Used as severity of log messages. Messages below current
+ * level are skipped before their arguments are evaluated.
+ */
+enum log_level {
+  LOG_DEBUG,
+  LOG_INFO,
+  LOG_WARN,
+  LOG_ERROR,
+  LOG_OFF
+};
+
+/**
+ * Used as log message that is not formatted yet. Keeps
+ * format string and raw arguments, strings are copied
+ * into data (truncated if they don't fit), as their
+ * buffers may be freed before message is formatted.
+ */
+struct log_record {
+  /* Format string, must live until program exits */
+  const char* fmt;
+
+  /* Level of message */
+  uint8_t level;
+
+  /* Amount of arguments and bytes of data taken by strings */
+  uint8_t argc;
+  uint16_t data_len;
+
+  /* Integers, doubles and pointers, offsets of strings in data */
+  uint64_t args[LOG_MAX_ARGS];
+  char data[LOG_DATA_SIZE];
+};
+
+/**
+ * Used as log buffer of one thread. Thread is the only
+ * producer and flusher thread is the only consumer, so
+ * records are passed without locks. Ring of finished
+ * thread is reused by the next one.
+ */
+struct log_ring {
+  /* Records written by thread */
+  size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+
+  /* Records printed by flusher */
+  size_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+
+  /* Records that didn't fit into full ring */
+  uint64_t dropped;
+
+  /* Ring belongs to running thread */
+  int owned;
+
+  /* Next ring in list of all rings */
+  struct log_ring* next;
+
+  struct log_record records[LOG_RING_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+extern int log_level;
+
+#define log_at(level, ...) do {if ((level) >= __atomic_load_n(&log_level, __ATOMIC_RELAXED)) \
+  log_write(level, __VA_ARGS__);} while(0)
+#define log_debug(...) log_at(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...) log_at(LOG_INFO, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_WARN, __VA_ARGS__)
+#define log_error(...) log_at(LOG_ERROR, __VA_ARGS__)
+
+void log_init(void);
+
+int log_parse_level(const char* name);
+
+void log_set_level(enum log_level level);
+
+void log_write(enum log_level level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+void log_flush(void);
+
+void log_shutdown(void);
+
+#endif // !LOG_H
@@ -0,0 +1,48 @@
+#ifndef RXBUF_H
+#define RXBUF_H
+
+#include "common.h"
+#include "pool.h"
+
+/**
+ * Used as block of bytes received from socket. Decoder keeps
+ * blocks in queue until their bytes are taken, and message
+ * buffers of replies point at payload inside the block, so
+ * payload is sent from where it was received. Block lives
+ * until its last reference is dropped: pooled block is then
+ * freed, other blocks (e.g. provided buffers of io_uring)
+ * are given back by their release callback.
+ */
+struct rxbuf {
+  /* First byte of block */
+  char* data;
+
+  /* Amount of received bytes and size of block */
+  uint32_t len;
+  uint32_t size;
+
+  /* References held by decoder and message buffers */
+  uint32_t refs;
+
+  /* Identifier of block given by its owner */
+  uint32_t id;
+
+  /* Owner of block and callback that takes block back,
+     NULL for pooled block */
+  void* owner;
+  void (*release)(struct rxbuf* rxbuf);
+
+  /* Next block in queue of decoder */
+  struct rxbuf* next;
+
+  /* Bytes of pooled block */
+  char storage[];
+};
+
+struct rxbuf* rxbuf_alloc(uint32_t size);
+
+void rxbuf_get(struct rxbuf* rxbuf);
+
+void rxbuf_put(struct rxbuf* rxbuf);
+
+#endif // !RXBUF_H
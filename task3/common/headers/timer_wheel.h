@@ -0,0 +1,61 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "common.h"
+
+#define TIMER_WHEEL_SLOTS 512
+#define TIMER_TICK_NS (100 * 1000000ull)
+
+/**
+ * Used as timer embedded into its owner, so arming it
+ * allocates nothing. Armed timer is linked into slot of
+ * its deadline tick.
+ */
+struct timer {
+  /* Neighbours in slot list, prev is NULL if timer isn't armed */
+  struct timer* prev;
+  struct timer* next;
+
+  /* Time timer expires at (metrics_now clock) */
+  uint64_t deadline;
+
+  /* Owner of the timer, passed to expire callback */
+  void* item;
+};
+
+/**
+ * Used as hashed timer wheel. Slot of timer is its deadline
+ * tick modulo TIMER_WHEEL_SLOTS, so adding and removing cost
+ * the same whatever amount of timers. Deadlines further than
+ * one turn of the wheel share slots with nearer ones and are
+ * skipped until their turn comes. Wheel has no lock, it is
+ * driven by one thread (or under lock of its owner).
+ */
+struct timer_wheel {
+  /* Sentinels of slot lists */
+  struct timer slots[TIMER_WHEEL_SLOTS];
+
+  /* Last processed tick */
+  uint64_t tick;
+
+  /* Amount of armed timers */
+  uint32_t amount;
+};
+
+void init_timer_wheel(struct timer_wheel* wheel, uint64_t now);
+
+void init_timer(struct timer* timer, void* item);
+
+int timer_armed(struct timer* timer);
+
+void timer_wheel_add(struct timer_wheel* wheel, struct timer* timer, uint64_t deadline);
+
+void timer_wheel_shorten(struct timer_wheel* wheel, struct timer* timer, uint64_t deadline);
+
+void timer_wheel_remove(struct timer_wheel* wheel, struct timer* timer);
+
+int timer_wheel_timeout(struct timer_wheel* wheel, uint64_t now);
+
+void timer_wheel_advance(struct timer_wheel* wheel, uint64_t now, void (*expire)(void* item, void* arg), void* arg);
+
+#endif // !TIMER_WHEEL_H
@@ -0,0 +1,91 @@
+#ifndef URING_H
+#define URING_H
+
+#include "common.h"
+#include "rxbuf.h"
+#include <linux/io_uring.h>
+
+/**
+ * Used as minimal wrapper around io_uring instance created
+ * with raw system calls. Holds pointers into submission and
+ * completion rings shared with kernel.
+ */
+struct uring {
+  /* Descriptor of io_uring instance */
+  int fd;
+
+  /* Submission queue */
+  unsigned sq_entries;
+  unsigned* sq_head;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  struct io_uring_sqe* sqes;
+
+  /* Tail of prepared but not yet published entries */
+  unsigned sqe_tail;
+
+  /* Completion queue */
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+
+  /* Mapped memory of rings */
+  void* rings;
+  size_t rings_size;
+  size_t sqes_size;
+};
+
+/**
+ * Used as ring of buffers provided to kernel. Kernel picks
+ * buffer for each receive by itself, so memory is not pinned
+ * by idle connections. Received buffer is wrapped in block,
+ * so replies send payload from it and buffer goes back to
+ * kernel after last of them.
+ */
+struct uring_buffers {
+  /* Ring shared with kernel */
+  struct io_uring_buf_ring* ring;
+  size_t ring_size;
+
+  /* Memory of all buffers */
+  char* data;
+  size_t buffer_size;
+
+  /* Block of every buffer */
+  struct rxbuf** blocks;
+
+  /* Amount of buffers (power of two) */
+  unsigned entries;
+
+  /* Buffer group identifier */
+  unsigned short group;
+};
+
+void uring_init(struct uring* ring, unsigned entries);
+
+struct io_uring_sqe* uring_get_sqe(struct uring* ring);
+
+int uring_submit(struct uring* ring, unsigned wait_nr);
+
+int uring_submit_timeout(struct uring* ring, unsigned wait_nr, int timeout);
+
+struct io_uring_cqe* uring_peek_cqe(struct uring* ring);
+
+void uring_cqe_seen(struct uring* ring);
+
+void uring_free(struct uring* ring);
+
+void uring_init_buffers(struct uring* ring, struct uring_buffers* buffers, unsigned entries,
+                        size_t buffer_size, unsigned short group);
+
+char* uring_buffer(struct uring_buffers* buffers, unsigned short id);
+
+void uring_recycle_buffer(struct uring_buffers* buffers, unsigned short id);
+
+struct rxbuf* uring_take_buffer(struct uring_buffers* buffers, unsigned short id, uint32_t len);
+
+void uring_free_buffers(struct uring* ring, struct uring_buffers* buffers);
+
+#endif // !URING_H
@@ -0,0 +1,436 @@
+#include "../headers/decoder.h"
+
+/*
+ * decoder_copy - used to copy unread bytes out of blocks
+ * without consuming them.
+ * @decoder - pointer to an object of decoder struct
+ * @offset - position of first byte relative to first unread one
+ * @dest - destination buffer
+ * @len - amount of bytes
+ */
+static void decoder_copy(struct decoder* decoder, size_t offset, char* dest, size_t len) {
+  struct rxbuf* block = decoder->first;
+  size_t start = decoder->offset + offset;
+
+  /* Find block holding first byte */
+  while (start >= block->len) {
+    start -= block->len;
+    block = block->next;
+  }
+
+  while (len > 0) {
+    size_t part = block->len - start < len ? block->len - start : len;
+
+    memcpy(dest, block->data + start, part);
+    dest += part;
+    len -= part;
+    start = 0;
+    block = block->next;
+  }
+}
+
+/*
+ * decoder_trim - used to drop blocks that were read through.
+ * Last pooled block is kept for next receive and starts
+ * from the beginning if nothing else references it.
+ * @decoder - pointer to an object of decoder struct
+ */
+static void decoder_trim(struct decoder* decoder) {
+  while (decoder->first && decoder->offset == decoder->first->len) {
+    struct rxbuf* block = decoder->first;
+
+    if (block == decoder->last && !block->release) {
+      if (block->refs == 1) {
+        block->len = 0;
+        decoder->offset = 0;
+        return;
+      }
+
+      if (block->len < block->size)
+        return;
+    }
+
+    decoder->first = block->next;
+    if (!decoder->first)
+      decoder->last = NULL;
+    decoder->offset = 0;
+    rxbuf_put(block);
+  }
+}
+
+/*
+ * decoder_skip - used to consume unread bytes.
+ * @decoder - pointer to an object of decoder struct
+ * @len - amount of bytes (up to pending)
+ */
+static void decoder_skip(struct decoder* decoder, size_t len) {
+  decoder->pending -= len;
+
+  while (len > 0) {
+    struct rxbuf* block = decoder->first;
+    size_t part = block->len - decoder->offset < len ? block->len - decoder->offset : len;
+
+    decoder->offset += part;
+    len -= part;
+    decoder_trim(decoder);
+  }
+}
+
+/*
+ * decoder_missing - used to get amount of bytes frame being
+ * received still lacks.
+ * @decoder - pointer to an object of decoder struct
+ *
+ * Return: amount of bytes, 0 if length header is incomplete
+ */
+static size_t decoder_missing(struct decoder* decoder) {
+  size_t need;
+  uint32_t net_len;
+  uint32_t len;
+
+  if (decoder->left > 0) {
+    need = decoder->chunk && decoder->left > decoder->chunk ? decoder->chunk : decoder->left;
+  } else {
+    if (decoder->pending < sizeof(net_len))
+      return 0;
+
+    decoder_copy(decoder, 0, (char*) &net_len, sizeof(net_len));
+    len = ntohl(net_len);
+    if (len > decoder->max_frame)
+      return 0;
+
+    need = sizeof(net_len) + (decoder->chunk && len > decoder->chunk ? decoder->chunk : len);
+  }
+
+  return need > decoder->pending ? need - decoder->pending : 0;
+}
+
+/*
+ * decoder_block_size - used to get size of new block, big
+ * enough for rest of frame being received (up to limit).
+ * @decoder - pointer to an object of decoder struct
+ *
+ * Return: size of block
+ */
+static uint32_t decoder_block_size(struct decoder* decoder) {
+  size_t missing = decoder_missing(decoder);
+
+  if (missing < DECODER_SIZE)
+    return DECODER_SIZE;
+
+  return missing < DECODER_BLOCK_MAX ? missing : DECODER_BLOCK_MAX;
+}
+
+/*
+ * init_decoder - used to initialize decoder. Blocks are not
+ * allocated until first bytes arrive, so idle connections
+ * cost nothing.
+ * @decoder - pointer to an object of decoder struct
+ * @max_frame - max allowed length of frame payload
+ * @chunk - max length of frame taken whole, longer frames
+ * are streamed (0 - every frame is taken whole)
+ */
+void init_decoder(struct decoder* decoder, uint32_t max_frame, uint32_t chunk) {
+  decoder->first = NULL;
+  decoder->last = NULL;
+  decoder->offset = 0;
+  decoder->pending = 0;
+  decoder->max_frame = max_frame;
+  decoder->chunk = chunk;
+  decoder->left = 0;
+  decoder->frame_len = 0;
+}
+
+/*
+ * decoder_space - used to get amount of bytes next receive
+ * has space for.
+ * @decoder - pointer to an object of decoder struct
+ *
+ * Return: amount of bytes next decoder_fill may receive
+ */
+size_t decoder_space(struct decoder* decoder) {
+  struct rxbuf* block = decoder->last;
+
+  if (block && !block->release && block->len < block->size)
+    return block->size - block->len;
+
+  return decoder_block_size(decoder);
+}
+
+/*
+ * decoder_fill - used to receive as many bytes as last block
+ * has space for with single system call. New block is
+ * appended when last one is full.
+ * @decoder - pointer to an object of decoder struct
+ * @fd - socket to receive from
+ *
+ * Return: amount of received bytes, 0 if connection closed,
+ * -1 on error (errno is set)
+ */
+ssize_t decoder_fill(struct decoder* decoder, int fd) {
+  struct rxbuf* block = decoder->last;
+  ssize_t bytes_read;
+
+  if (!block || block->release || block->len == block->size) {
+    block = rxbuf_alloc(decoder_block_size(decoder));
+    decoder_append(decoder, block);
+  }
+
+  do {
+    bytes_read = read(fd, block->data + block->len, block->size - block->len);
+  } while (bytes_read == -1 && errno == EINTR);
+
+  if (bytes_read > 0) {
+    block->len += bytes_read;
+    decoder->pending += bytes_read;
+  }
+
+  return bytes_read;
+}
+
+/*
+ * decoder_append - used to queue block that was already
+ * received into (e.g. provided buffer of io_uring). Decoder
+ * takes reference to it until its bytes are taken.
+ * @decoder - pointer to an object of decoder struct
+ * @rxbuf - received block
+ */
+void decoder_append(struct decoder* decoder, struct rxbuf* rxbuf) {
+  rxbuf_get(rxbuf);
+  rxbuf->next = NULL;
+
+  if (decoder->last)
+    decoder->last->next = rxbuf;
+  else
+    decoder->first = rxbuf;
+  decoder->last = rxbuf;
+  decoder->pending += rxbuf->len;
+
+  /* Block kept for receive may be read through */
+  decoder_trim(decoder);
+}
+
+/*
+ * decoder_ready - used to check if next frame (piece of
+ * frame being borrowed, or length that exceeds limit) can be
+ * taken by decoder_borrow without more bytes.
+ * @decoder - pointer to an object of decoder struct
+ *
+ * Return: 1 if next frame can be taken, 0 otherwise
+ */
+int decoder_ready(struct decoder* decoder) {
+  uint32_t net_len;
+  uint32_t len;
+
+  if (decoder->left > 0)
+    return decoder->pending > 0;
+
+  if (decoder->pending < sizeof(net_len))
+    return 0;
+
+  decoder_copy(decoder, 0, (char*) &net_len, sizeof(net_len));
+  len = ntohl(net_len);
+
+  return len > decoder->max_frame || len == 0 || decoder->pending > sizeof(net_len);
+}
+
+/*
+ * decoder_pending - used to get amount of bytes held by
+ * blocks that were not taken as frames yet.
+ * @decoder - pointer to an object of decoder struct
+ *
+ * Return: amount of unread bytes
+ */
+size_t decoder_pending(struct decoder* decoder) {
+  return decoder->pending;
+}
+
+/*
+ * decoder_take - used to copy payload out of blocks into
+ * new message buffer behind given headroom and terminate it.
+ * Payload is consumed.
+ * @decoder - pointer to an object of decoder struct
+ * @headroom - bytes reserved in front of payload
+ * @len - length of payload
+ *
+ * Return: pointer to an object of msgbuf struct
+ */
+static struct msgbuf* decoder_take(struct decoder* decoder, uint32_t headroom, uint32_t len) {
+  struct msgbuf* payload = msgbuf_alloc(headroom, len + 1);
+
+  if (len > 0)
+    decoder_copy(decoder, 0, payload->data, len);
+  payload->data[len] = '\0';
+  payload->len = len;
+  decoder_skip(decoder, len);
+
+  return payload;
+}
+
+/*
+ * decoder_header - used to consume length header of next
+ * frame.
+ * @decoder - pointer to an object of decoder struct
+ * @len - pointer where length of frame payload is stored
+ *
+ * Return: FRAME_OK if header was consumed, FRAME_PARTIAL if
+ * it is incomplete, FRAME_TOO_BIG if length exceeds limit
+ */
+static enum frame_status decoder_header(struct decoder* decoder, uint32_t* len) {
+  uint32_t net_len;
+
+  /* Length header may arrive in parts */
+  if (decoder->pending < sizeof(net_len))
+    return FRAME_PARTIAL;
+
+  decoder_copy(decoder, 0, (char*) &net_len, sizeof(net_len));
+  *len = ntohl(net_len);
+
+  /* Reject hostile lengths before anything is allocated */
+  if (*len > decoder->max_frame)
+    return FRAME_TOO_BIG;
+
+  return FRAME_OK;
+}
+
+/*
+ * decoder_next - used to take next complete frame out of
+ * blocks. Payload is copied to message buffer behind given
+ * headroom and terminated. Frame longer than chunk is taken
+ * as first chunk (frame_len holds length of whole frame)
+ * followed by continued ones without headroom. Buffer must
+ * be freed by msgbuf_free.
+ * @decoder - pointer to an object of decoder struct
+ * @headroom - bytes reserved in front of payload
+ * @frame - pointer where message buffer is stored
+ *
+ * Return: FRAME_OK if frame (or its chunk) was taken,
+ * FRAME_PARTIAL if more bytes are needed, FRAME_TOO_BIG if
+ * length exceeds limit
+ */
+enum frame_status decoder_next(struct decoder* decoder, uint32_t headroom, struct msgbuf** frame) {
+  enum frame_status status;
+  uint32_t len, take;
+
+  /* Rest of streamed frame is taken chunk by chunk */
+  if (decoder->left > 0) {
+    take = decoder->left < decoder->chunk ? decoder->left : decoder->chunk;
+    if (decoder->pending < take)
+      return FRAME_PARTIAL;
+
+    *frame = decoder_take(decoder, 0, take);
+    (*frame)->continued = 1;
+    decoder->left -= take;
+
+    return FRAME_OK;
+  }
+
+  status = decoder_header(decoder, &len);
+  if (status != FRAME_OK)
+    return status;
+
+  /* Long frame starts with its first chunk */
+  take = decoder->chunk && len > decoder->chunk ? decoder->chunk : len;
+  if (decoder->pending < sizeof(uint32_t) + take)
+    return FRAME_PARTIAL;
+
+  decoder_skip(decoder, sizeof(uint32_t));
+  *frame = decoder_take(decoder, headroom, take);
+  (*frame)->frame_len = len;
+  decoder->frame_len = len;
+  decoder->left = len - take;
+
+  return FRAME_OK;
+}
+
+/*
+ * decoder_borrow - used to take next frame without copying
+ * its payload. Message buffer gets empty terminated data
+ * behind given headroom and payload is left in the block
+ * it was received into. Frame is taken in pieces as its
+ * bytes arrive (each up to chunk bytes and inside one
+ * block): first piece has headroom and frame_len holds
+ * length of whole frame, next ones are continued. Buffer
+ * must be freed by msgbuf_free.
+ * @decoder - pointer to an object of decoder struct
+ * @headroom - bytes reserved in front of payload
+ * @frame - pointer where message buffer is stored
+ *
+ * Return: FRAME_OK if frame (or its piece) was taken,
+ * FRAME_PARTIAL if more bytes are needed, FRAME_TOO_BIG if
+ * length exceeds limit
+ */
+enum frame_status decoder_borrow(struct decoder* decoder, uint32_t headroom, struct msgbuf** frame) {
+  enum frame_status status;
+  uint32_t len, take;
+
+  if (decoder->left == 0) {
+    status = decoder_header(decoder, &len);
+    if (status != FRAME_OK)
+      return status;
+
+    decoder_skip(decoder, sizeof(uint32_t));
+    decoder->frame_len = len;
+    decoder->left = len;
+
+    /* Empty frame has nothing to wait for */
+    if (len == 0) {
+      *frame = decoder_take(decoder, headroom, 0);
+      return FRAME_OK;
+    }
+  }
+
+  if (decoder->pending == 0)
+    return FRAME_PARTIAL;
+
+  struct rxbuf* block = decoder->first;
+  take = block->len - decoder->offset;
+  if (take > decoder->left)
+    take = decoder->left;
+  if (decoder->chunk && take > decoder->chunk)
+    take = decoder->chunk;
+
+  /* Only first piece gets headroom for reply header */
+  *frame = decoder_take(decoder, decoder->left == decoder->frame_len ? headroom : 0, 0);
+  msgbuf_attach(*frame, block, block->data + decoder->offset, take);
+  (*frame)->frame_len = decoder->frame_len;
+  (*frame)->continued = decoder->left < decoder->frame_len;
+  decoder->left -= take;
+  decoder_skip(decoder, take);
+
+  return FRAME_OK;
+}
+
+/*
+ * decoder_detach - used to take rest of frame being borrowed
+ * away from decoder, so caller moves it past the blocks
+ * (e.g. by splice). Caller borrows held bytes first.
+ * @decoder - pointer to an object of decoder struct
+ *
+ * Return: amount of payload bytes caller must take from socket
+ */
+uint32_t decoder_detach(struct decoder* decoder) {
+  uint32_t left = decoder->left;
+
+  decoder->left = 0;
+
+  return left;
+}
+
+/*
+ * free_decoder - used to drop all blocks of decoder. Blocks
+ * still referenced by message buffers live until they are freed.
+ * @decoder - pointer to an object of decoder struct
+ */
+void free_decoder(struct decoder* decoder) {
+  while (decoder->first) {
+    struct rxbuf* block = decoder->first;
+
+    decoder->first = block->next;
+    rxbuf_put(block);
+  }
+
+  decoder->last = NULL;
+  decoder->offset = 0;
+  decoder->pending = 0;
+}
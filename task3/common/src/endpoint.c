@@ -1,20 +1,30 @@
 #include "../headers/endpoint.h"
-#include <arpa/inet.h>
 #include <netinet/in.h>
 
 /*
- * addr_to_endpoint - used to create an object of endpoint struct.
- * Converts sin_addr and sin_port in sockaddr_in struct for comfortable
- * usage.
- * @addr - pointer to an object of sockaddr_in struct
- *
- * Return: pointer to an object of endpoint struct
+ * addr_to_endpoint - used to format address of connection.
+ * Converts address and port from network byte order with
+ * inet_ntop, so it is safe to call from several threads.
+ * @addr - pointer to sockaddr_in or sockaddr_in6 struct
+ * @endpoint - pointer where formatted address is stored
  */
-struct endpoint* addr_to_endpoint(struct sockaddr_in* addr) {
-  struct endpoint* endpoint = (struct endpoint*) malloc(sizeof(struct endpoint));
-  
-  endpoint->ip = inet_ntoa(addr->sin_addr);
-  endpoint->port = htons(addr->sin_port);
+void addr_to_endpoint(const struct sockaddr* addr, struct endpoint* endpoint) {
+  char ip[INET6_ADDRSTRLEN];
 
-  return endpoint;
+  if (addr->sa_family == AF_INET6) {
+    const struct sockaddr_in6* addr6 = (const struct sockaddr_in6*) addr;
+
+    inet_ntop(AF_INET6, &addr6->sin6_addr, ip, sizeof(ip));
+    endpoint->port = ntohs(addr6->sin6_port);
+    snprintf(endpoint->text, sizeof(endpoint->text), "[%s]:%u", ip, endpoint->port);
+  } else if (addr->sa_family == AF_INET) {
+    const struct sockaddr_in* addr4 = (const struct sockaddr_in*) addr;
+
+    inet_ntop(AF_INET, &addr4->sin_addr, ip, sizeof(ip));
+    endpoint->port = ntohs(addr4->sin_port);
+    snprintf(endpoint->text, sizeof(endpoint->text), "%s:%u", ip, endpoint->port);
+  } else {
+    endpoint->port = 0;
+    snprintf(endpoint->text, sizeof(endpoint->text), "unknown");
+  }
 }
@@ -0,0 +1,116 @@
+#include "../headers/msgbuf.h"
+
+/*
+ * msgbuf_alloc - used to allocate empty message buffer
+ * from pool.
+ * @headroom - bytes reserved in front of data
+ * @size - max length of data
+ *
+ * Return: pointer to an object of msgbuf struct, must be
+ * freed by msgbuf_free
+ */
+struct msgbuf* msgbuf_alloc(uint32_t headroom, uint32_t size) {
+  struct msgbuf* msgbuf = (struct msgbuf*) pool_alloc(sizeof(struct msgbuf) + headroom + size);
+
+  msgbuf->data = msgbuf->storage + headroom;
+  msgbuf->len = 0;
+  msgbuf->frame_len = 0;
+  msgbuf->continued = 0;
+  msgbuf->headroom = headroom;
+  msgbuf->rx = NULL;
+  msgbuf->payload = msgbuf->data;
+  msgbuf->payload_len = 0;
+
+  return msgbuf;
+}
+
+/*
+ * msgbuf_push - used to prepend bytes to data, taking
+ * them from headroom.
+ * @msgbuf - pointer to an object of msgbuf struct
+ * @bytes - bytes that need to be prepended
+ * @len - amount of bytes (up to headroom)
+ *
+ * Return: new start of data
+ */
+char* msgbuf_push(struct msgbuf* msgbuf, const void* bytes, uint32_t len) {
+  if (len > msgbuf->headroom) {
+    fprintf(stderr, "msgbuf_push: %u bytes don't fit in headroom of %u bytes\n", len, msgbuf->headroom);
+    exit(EXIT_FAILURE);
+  }
+
+  msgbuf->data -= len;
+  msgbuf->len += len;
+  msgbuf->headroom -= len;
+  memcpy(msgbuf->data, bytes, len);
+
+  return msgbuf->data;
+}
+
+/*
+ * msgbuf_attach - used to make payload inside received block
+ * follow data. Block is referenced until buffer is freed.
+ * @msgbuf - pointer to an object of msgbuf struct
+ * @rx - block holding payload
+ * @payload - first byte of payload
+ * @len - length of payload
+ */
+void msgbuf_attach(struct msgbuf* msgbuf, struct rxbuf* rx, char* payload, uint32_t len) {
+  rxbuf_get(rx);
+  msgbuf->rx = rx;
+  msgbuf->payload = payload;
+  msgbuf->payload_len = len;
+}
+
+/*
+ * msgbuf_length - used to get amount of bytes message
+ * buffer sends.
+ * @msgbuf - pointer to an object of msgbuf struct
+ *
+ * Return: length of data and payload following it
+ */
+uint32_t msgbuf_length(struct msgbuf* msgbuf) {
+  return msgbuf->len + msgbuf->payload_len;
+}
+
+/*
+ * msgbuf_iov - used to describe bytes of message buffer
+ * that were not sent yet for gather output.
+ * @msgbuf - pointer to an object of msgbuf struct
+ * @skip - amount of bytes already sent
+ * @iov - array of at least two entries to fill
+ *
+ * Return: amount of filled entries
+ */
+int msgbuf_iov(struct msgbuf* msgbuf, uint32_t skip, struct iovec* iov) {
+  int count = 0;
+
+  if (skip < msgbuf->len) {
+    iov[count].iov_base = msgbuf->data + skip;
+    iov[count].iov_len = msgbuf->len - skip;
+    count++;
+    skip = 0;
+  } else {
+    skip -= msgbuf->len;
+  }
+
+  if (skip < msgbuf->payload_len) {
+    iov[count].iov_base = msgbuf->payload + skip;
+    iov[count].iov_len = msgbuf->payload_len - skip;
+    count++;
+  }
+
+  return count;
+}
+
+/*
+ * msgbuf_free - used to return message buffer to pool and
+ * drop reference to block holding its payload.
+ * @msgbuf - pointer to an object of msgbuf struct (may be NULL)
+ */
+void msgbuf_free(struct msgbuf* msgbuf) {
+  if (msgbuf && msgbuf->rx)
+    rxbuf_put(msgbuf->rx);
+
+  pool_free(msgbuf);
+}
@@ -0,0 +1,181 @@
+#include "../headers/pool.h"
+
+/* Cache of current thread */
+static __thread struct pool_cache* pool_cache;
+
+/* Key that frees cache when its thread exits */
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* Caches of running threads and counters of finished ones */
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_cache* pool_caches;
+static struct pool_stats pool_retired;
+
+/*
+ * release_cache - used as destructor of thread cache.
+ * Frees buffers kept in cache and saves its counters.
+ * @arg - pointer to an object of pool_cache struct
+ */
+static void release_cache(void* arg) {
+  struct pool_cache* cache = (struct pool_cache*) arg;
+
+  for (int i = 0; i < POOL_CLASSES; i++) {
+    while (cache->blocks[i]) {
+      struct pool_block* block = cache->blocks[i];
+      cache->blocks[i] = block->next;
+      free((char*) block - POOL_HEADER_SIZE);
+    }
+  }
+
+  pthread_mutex_lock(&pool_lock);
+  pool_retired.hits += cache->hits;
+  pool_retired.misses += cache->misses;
+
+  if (cache->prev)
+    cache->prev->next = cache->next;
+  else
+    pool_caches = cache->next;
+  if (cache->next)
+    cache->next->prev = cache->prev;
+  pthread_mutex_unlock(&pool_lock);
+
+  free(cache);
+  pool_cache = NULL;
+}
+
+/*
+ * create_key - used once to create key of thread caches.
+ */
+static void create_key(void) {
+  if (pthread_key_create(&pool_key, release_cache) != 0)
+    print_error("pthread_key_create");
+}
+
+/*
+ * get_cache - used to get cache of current thread,
+ * creates it on first use.
+ *
+ * Return: pointer to an object of pool_cache struct
+ */
+static struct pool_cache* get_cache(void) {
+  if (pool_cache)
+    return pool_cache;
+
+  pthread_once(&pool_once, create_key);
+
+  struct pool_cache* cache = (struct pool_cache*) aligned_alloc(CACHE_LINE_SIZE, sizeof(struct pool_cache));
+  if (!cache)
+    print_error("aligned_alloc");
+  memset(cache, 0, sizeof(struct pool_cache));
+
+  pthread_mutex_lock(&pool_lock);
+  cache->next = pool_caches;
+  if (pool_caches)
+    pool_caches->prev = cache;
+  pool_caches = cache;
+  pthread_mutex_unlock(&pool_lock);
+
+  pthread_setspecific(pool_key, cache);
+  pool_cache = cache;
+
+  return cache;
+}
+
+/*
+ * size_class - used to find smallest class that holds
+ * buffer with its header.
+ * @size - requested size
+ *
+ * Return: size class, POOL_CLASSES if buffer is too large
+ */
+static uint32_t size_class(size_t size) {
+  size_t total = size + POOL_HEADER_SIZE;
+  uint32_t class = 0;
+
+  while (class < POOL_CLASSES && ((size_t) CACHE_LINE_SIZE << class) < total)
+    class++;
+
+  return class;
+}
+
+/*
+ * pool_alloc - used to allocate buffer. Buffer is taken
+ * from free list of its size class, malloc is called only
+ * when list is empty or buffer is larger than biggest
+ * class. Buffers start on cache line, so buffers of
+ * different threads never share one.
+ * @size - size of buffer
+ *
+ * Return: pointer to buffer, must be freed by pool_free
+ */
+void* pool_alloc(size_t size) {
+  struct pool_cache* cache = get_cache();
+  uint32_t class = size_class(size);
+  struct pool_header* header;
+
+  if (class < POOL_CLASSES && cache->blocks[class]) {
+    struct pool_block* block = cache->blocks[class];
+
+    cache->blocks[class] = block->next;
+    cache->blocks_amount[class]--;
+    __atomic_store_n(&cache->hits, cache->hits + 1, __ATOMIC_RELAXED);
+
+    return block;
+  }
+
+  /* Round large buffers up to cache line */
+  size_t total = class < POOL_CLASSES ? (size_t) CACHE_LINE_SIZE << class :
+                 (size + POOL_HEADER_SIZE + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1);
+
+  header = (struct pool_header*) aligned_alloc(CACHE_LINE_SIZE, total);
+  if (!header)
+    print_error("aligned_alloc");
+
+  header->size_class = class;
+  __atomic_store_n(&cache->misses, cache->misses + 1, __ATOMIC_RELAXED);
+
+  return (char*) header + POOL_HEADER_SIZE;
+}
+
+/*
+ * pool_free - used to return buffer to free list of its
+ * size class in cache of current thread. Large buffers and
+ * buffers above POOL_CACHE_LIMIT of the class are freed.
+ * @buffer - buffer allocated by pool_alloc (may be NULL)
+ */
+void pool_free(void* buffer) {
+  if (!buffer)
+    return;
+
+  struct pool_header* header = (struct pool_header*) ((char*) buffer - POOL_HEADER_SIZE);
+  uint32_t class = header->size_class;
+  struct pool_cache* cache = get_cache();
+
+  if (class >= POOL_CLASSES || cache->blocks_amount[class] >= POOL_CACHE_LIMIT) {
+    free(header);
+    return;
+  }
+
+  struct pool_block* block = (struct pool_block*) buffer;
+
+  block->next = cache->blocks[class];
+  cache->blocks[class] = block;
+  cache->blocks_amount[class]++;
+}
+
+/*
+ * pool_get_stats - used to sum counters of all threads,
+ * including finished ones.
+ * @stats - pointer where counters are stored
+ */
+void pool_get_stats(struct pool_stats* stats) {
+  pthread_mutex_lock(&pool_lock);
+  *stats = pool_retired;
+
+  for (struct pool_cache* cache = pool_caches; cache; cache = cache->next) {
+    stats->hits += __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+    stats->misses += __atomic_load_n(&cache->misses, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&pool_lock);
+}
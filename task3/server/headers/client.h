@@ -2,30 +2,169 @@
 #define CLIENT_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/decoder.h"
+#include "../../common/headers/endpoint.h"
+#include "../../common/headers/metrics.h"
+#include "../../common/headers/timer_wheel.h"
+
+/**
+ * Used as result of non-blocking IO operations on
+ * clients socket.
+ */
+enum io_status {
+  /* Operation completed */
+  IO_DONE,
+
+  /* Socket would block, wait for next event */
+  IO_AGAIN,
+
+  /* Connection closed or failed */
+  IO_CLOSED
+};
+
+/**
+ * Used as types of requests submitted to io_uring.
+ */
+enum uring_op_type {
+  OP_ACCEPT,
+  OP_RECV,
+  OP_SEND,
+  OP_CANCEL
+};
+
+/**
+ * Used as user data of io_uring requests to find
+ * request owner when its completion arrives.
+ */
+struct uring_op {
+  enum uring_op_type type;
+
+  /* Client that submitted request (NULL for accept) */
+  struct client* client;
+};
+
+/**
+ * Used as reply waiting to be sent. Queued replies of
+ * the client are sent in order by one gathered send.
+ */
+struct reply {
+  /* Length header, prefix and payload built in place */
+  struct msgbuf* message;
+
+  /* epoll: message was sent by zerocopy send and id of last
+     such send, its buffer is freed once kernel releases it */
+  uint32_t zerocopy;
+  uint32_t zc_id;
+
+  /* Next reply of the client */
+  struct reply* next;
+};
 
 /**
  * Used as data struct to specify clients
- * address, descriptor for communication and 
- * clients id (required for proper delete operations)
+ * address, descriptor for communication,
+ * clients id (in reactors clients registry)
+ * and partially received/sent messages.
  */
 struct client {
   /* Clients address */
-  struct sockaddr_in* addr;
-  
-  /* IP and port */
-  struct endpoint* endpoint;
-
-  /* Pointer to connected server */
-  struct server* server;
-  
-  /* Thread that handles new messages */
-  pthread_t thread;
-  
+  struct sockaddr_storage addr;
+
+  /* IP and port, formatted once on connection */
+  struct endpoint endpoint;
+
+  /* Pointer to reactor that serves client */
+  struct reactor* reactor;
+
   /* File descriptor for communication */
   int fd;
 
   /* Identifier of user */
-  int id;
+  uint64_t id;
+
+  /* Received bytes and frames that were not taken yet */
+  struct decoder decoder;
+
+  /* Last receive didn't fill decoder, socket has no more data */
+  int drained;
+
+  /* Client shut down its side: epoll reads socket until EOF,
+     both backends close it once replies are sent */
+  int hangup;
+
+  /* epoll: large replies are sent by zerocopy sends, id of
+     next one and sent replies whose buffers kernel still
+     holds (oldest first) */
+  int zerocopy;
+  uint32_t zc_next;
+  struct reply* zc_pending;
+  struct reply* zc_pending_tail;
+
+  /* epoll: pipe payload of long message is spliced through
+     (-1 until first relay), payload bytes still in socket and
+     bytes waiting in pipe */
+  int pipe[2];
+  uint32_t relay_left;
+  uint32_t piped;
+
+  /* Replies that were not accepted by socket yet */
+  struct reply* replies;
+  struct reply* replies_tail;
+
+  /* Bytes of first reply that were already sent */
+  size_t reply_sent;
+
+  /* Bytes of replies that were not sent yet */
+  size_t queued;
+
+  /* Reading stopped until queued replies drain to SEND_QUEUE_LOW
+     and time of pause (metrics_now) */
+  int paused;
+  uint64_t paused_at;
+
+  /* Time bytes were last received or sent and time part of next
+     frame was received (0 if decoder holds no part of frame) */
+  uint64_t active_at;
+  uint64_t frame_at;
+
+  /* Expires client at nearest of its idle, read and write deadlines */
+  struct timer timer;
+
+  /* Bytes received and sent, written by reactor only */
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+
+  /* Time of connection (metrics_now) */
+  uint64_t connected_at;
+
+  /* io_uring: replies being sent, their gathered send request,
+     its length and amount of messages it completes */
+  struct reply* sending;
+  struct iovec* iov;
+  struct msghdr msg;
+  size_t sending_len;
+  int sending_count;
+  uint64_t sending_started;
+
+  /* io_uring: multishot receive, send and cancel requests */
+  struct uring_op recv_op;
+  struct uring_op send_op;
+  struct uring_op cancel_op;
+
+  /* io_uring: multishot receive is armed */
+  int receiving;
+
+  /* io_uring: provided buffers held by decoder and replies */
+  int pinned;
+
+  /* io_uring: receive waits for provided buffers and next
+     client waiting for them */
+  int starved;
+  struct client* next_starved;
+
+  /* io_uring: amount of requests in flight and close flag */
+  int inflight;
+  int closing;
 };
 
 #endif // !CLIENT_H
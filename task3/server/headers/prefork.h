@@ -0,0 +1,88 @@
+#ifndef PREFORK_H
+#define PREFORK_H
+
+#include "server.h"
+
+/* Pause before restarting worker that crashed right after start */
+#define WORKER_RESTART_DELAY 1
+
+/**
+ * Used as message that hands connection to worker. Descriptor
+ * itself is passed as SCM_RIGHTS control message.
+ */
+struct handoff {
+  /* Address of the client */
+  struct sockaddr_storage addr;
+};
+
+/**
+ * Used as load report that worker sends to acceptor every
+ * time its amount of connections changes.
+ */
+struct worker_load {
+  /* Connections served by worker */
+  uint32_t clients;
+
+  /* Connections received from acceptor in total */
+  uint64_t received;
+};
+
+/**
+ * Used as worker process as it is seen by acceptor.
+ */
+struct worker {
+  /* Process of the worker, -1 if it is not running */
+  pid_t pid;
+
+  /* Acceptors end of socketpair */
+  int channel;
+
+  /* Time worker was started and time it is due to be started
+     again after quick crash (metrics_now, 0 if not waiting) */
+  uint64_t started;
+  uint64_t restart_at;
+
+  /* Connections handed to worker in total */
+  uint64_t handed;
+
+  /* Last load report of the worker */
+  struct worker_load load;
+};
+
+/**
+ * Used as acceptor of prefork server. Acceptor owns passive
+ * socket, accepts connections and hands them over socketpair
+ * to the least loaded worker. Workers are separate processes
+ * started from the same binary, crashed worker is restarted
+ * while passive socket stays open.
+ */
+struct acceptor {
+  /* Passive socket to accept connections */
+  int sfd;
+
+  /* Epoll instance that watches passive socket and channels */
+  int epfd;
+
+  /* Worker processes */
+  struct worker* workers;
+  int workers_amount;
+
+  /* Name of the binary, passed to workers as argv[0] */
+  const char* path;
+};
+
+struct server* create_acceptor(const char* ip, const int port, int workers_amount, enum backend backend,
+                               uint32_t max_frame, int splice, int zerocopy, const char* path);
+
+struct server* create_worker(const char* ip, const int port, enum backend backend, uint32_t max_frame, int splice,
+                             int zerocopy, int channel, int id);
+
+void run_acceptor(struct server* server);
+
+void receive_handoffs(struct reactor* reactor);
+
+void report_load(struct server* server);
+
+void free_acceptor(struct acceptor* acceptor);
+
+#endif // !PREFORK_H
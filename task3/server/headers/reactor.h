@@ -0,0 +1,75 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/registry.h"
+#include "../../common/headers/uring.h"
+#include "client.h"
+#include <sys/epoll.h>
+
+/**
+ * Used as event loop that owns its own passive socket
+ * (bound with SO_REUSEPORT), epoll instance and clients.
+ * Reactors share nothing, so each of them runs in its own
+ * thread without locks.
+ */
+struct reactor {
+  /* Pointer to server that owns reactor */
+  struct server* server;
+
+  /* Clients of reactor, shared only with admin socket */
+  struct registry clients;
+
+  /* Passive socket to accept connecitons */
+  int sfd;
+
+  /* Epoll instance that watches passive and clients sockets */
+  int epfd;
+
+  /* io_uring instance, provided buffers and multishot accept request */
+  struct uring ring;
+  struct uring_buffers buffers;
+  struct uring_op accept_op;
+
+  /* Provided buffers held by clients and clients whose
+     receive ran out of them */
+  unsigned pinned;
+  struct client* starved;
+
+  /* Deadlines of clients and time of current loop iteration */
+  struct timer_wheel timers;
+  uint64_t now;
+
+  /* Index of reactor, used as CPU number to pin thread */
+  int id;
+
+  /* Thread that runs event loop */
+  pthread_t thread;
+};
+
+void init_reactor(struct reactor* reactor, struct server* server, int id);
+
+void start_reactor(struct reactor* reactor);
+
+void* run_reactor(void* arg);
+
+void accept_clients(struct reactor* reactor);
+
+void add_client(struct reactor* reactor, struct sockaddr_storage* client_addr, int client_fd);
+
+void delete_client(struct reactor* reactor, struct client* client);
+
+void pause_client(struct client* client);
+
+void resume_client(struct client* client);
+
+void arm_client_timer(struct client* client);
+
+void track_partial_frame(struct client* client);
+
+void expire_clients(struct reactor* reactor);
+
+void free_reactor(struct reactor* reactor);
+
+#endif // !REACTOR_H
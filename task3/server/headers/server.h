@@ -2,45 +2,90 @@
 #define SERVER_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/admin.h"
 #include "../../common/headers/endpoint.h"
 #include "client.h"
+#include "reactor.h"
+
+/**
+ * Used as IO engines that reactors can run on.
+ */
+enum backend {
+  /* Non-blocking sockets and edge-triggered epoll */
+  BACKEND_EPOLL,
+
+  /* Multishot accept/receive and gathered sends on io_uring */
+  BACKEND_URING
+};
 
 /**
  * Used to create server on internet adress family (AF_INET) with
- * TCP protocol. 
+ * TCP protocol. All sockets are served by
+ * event loops (reactors), one per thread.
  */
 struct server {
   /* Address of the server */
   struct sockaddr_in serv;
-  
-  /* Array of pointers to clients */
-  struct client** clients;
-  int clients_amount;
 
-  /* Passive socket to accept connecitons */
-  int sfd;
+  /* Event loops, each with its own passive socket */
+  struct reactor* reactors;
+  int reactors_amount;
+
+  /* IO engine of reactors */
+  enum backend backend;
+
+  /* Max allowed length of message from client */
+  uint32_t max_frame;
+
+  /* epoll: payload of long messages is relayed by splice */
+  int splice;
+
+  /* epoll: replies above ZEROCOPY_MIN_SIZE are sent by MSG_ZEROCOPY */
+  int zerocopy;
+
+  /* Socket that answers with metrics and clients table */
+  struct admin admin;
+
+  /* Acceptor of prefork server, NULL in other modes */
+  struct acceptor* acceptor;
+
+  /* Worker of prefork server: channel to acceptor (-1 in
+     other modes), index and connections received over it */
+  int channel;
+  int worker_id;
+  uint64_t received;
 };
 
-struct server* create_server(const char* ip, const int port);
+struct server* create_server(const char* ip, const int port, int reactors_amount, enum backend backend,
+                             uint32_t max_frame, int splice, int zerocopy);
 
 void run_server(struct server* server);
 
-void* handle_client_connection(void* arg);
+void handle_client_connection(struct client* client, uint32_t events);
 
-void add_client(struct server* server, struct sockaddr_in* client_addr, int client_fd);
+void queue_reply(struct client* client, struct msgbuf* message);
 
-void delete_client(struct server* server, struct client* client);
+enum io_status send_message(struct client* client);
 
-void send_message(struct client* client, char buffer[BUFFER_SIZE]);
+enum io_status recv_message(struct client* client, struct msgbuf** message);
 
-char* recv_message(struct client* client);
+void edit_message(struct msgbuf* message);
 
-char* edit_message(char* message);
+int start_relay(struct client* client);
+
+enum io_status relay_payload(struct client* client);
+
+int reap_zerocopy(struct client* client);
 
 void shutdown_connection(struct client* client);
 
 void close_connection(struct client *client);
 
+void free_replies(struct reply* replies);
+
+int collect_clients(void* arg, struct admin_client** clients);
+
 void free_server(struct server* server);
 
 #endif // !SERVER_H
@@ -0,0 +1,30 @@
+#ifndef URING_REACTOR_H
+#define URING_REACTOR_H
+
+#include "reactor.h"
+
+void run_uring_reactor(struct reactor* reactor);
+
+void handle_uring_completion(struct reactor* reactor, struct io_uring_cqe* cqe);
+
+void submit_accept(struct reactor* reactor);
+
+void submit_recv(struct client* client);
+
+void submit_replies(struct client* client);
+
+void pause_uring_client(struct client* client);
+
+void resume_uring_client(struct client* client);
+
+void consume_messages(struct client* client, struct rxbuf* block);
+
+void release_uring_block(struct rxbuf* block);
+
+void wait_for_buffers(struct client* client);
+
+void forget_starved_client(struct client* client);
+
+void close_uring_connection(struct client* client);
+
+#endif // !URING_REACTOR_H
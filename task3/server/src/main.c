@@ -1,11 +1,99 @@
 #include "../headers/server.h"
+#include "../headers/prefork.h"
 
 struct server* server;
 
 void cleanup();
 
-int main(void) {
-  server = create_server(SERVER_IP, SERVER_PORT);
+/*
+ * Usage: server [-r reactors] [-w workers] [-b epoll|uring] [-f max_frame] [-s] [-z]
+ * -r - amount of event loops with their own passive
+ *      sockets (SO_REUSEPORT), 0 - one per CPU
+ * -w - run acceptor process that hands connections to
+ *      given amount of worker processes (one event loop
+ *      each, -r is ignored), 0 - one per CPU
+ * -b - IO engine of event loops (epoll by default)
+ * -f - max allowed length of message in bytes, messages
+ *      longer than STREAM_CHUNK_SIZE are passed through
+ *      in chunks, so limit doesn't cost memory
+ * -s - relay payload of messages longer than SPLICE_CHUNK_SIZE
+ *      from socket back to socket by splice, so it isn't
+ *      copied to user space (epoll only)
+ * -z - send replies longer than ZEROCOPY_MIN_SIZE by
+ *      MSG_ZEROCOPY, so kernel doesn't copy them (epoll only)
+ * -c - channel and index of worker, set by acceptor only
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  enum backend backend = BACKEND_EPOLL;
+  uint32_t max_frame = MAX_FRAME_SIZE;
+  int reactors_amount = 1;
+  int workers_amount = -1;
+  int channel = -1, worker_id = 0;
+  int splice = 0, zerocopy = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:w:b:f:szc:")) != -1) {
+    switch (opt) {
+      case 'r':
+        reactors_amount = atoi(optarg);
+        break;
+      case 'b':
+        if (strcmp(optarg, "uring") == 0)
+          backend = BACKEND_URING;
+        else if (strcmp(optarg, "epoll") == 0)
+          backend = BACKEND_EPOLL;
+        else {
+          fprintf(stderr, "Unknown backend: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'w':
+        workers_amount = atoi(optarg);
+        break;
+      case 'f':
+        /* Length header of reply holds prefix too */
+        if (strtoull(optarg, NULL, 10) > UINT32_MAX - PREFIX_LEN) {
+          fprintf(stderr, "Max frame must be in range 0..%lu\n", UINT32_MAX - PREFIX_LEN);
+          exit(EXIT_FAILURE);
+        }
+        max_frame = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        splice = 1;
+        break;
+      case 'z':
+        zerocopy = 1;
+        break;
+      case 'c':
+        if (sscanf(optarg, "%d:%d", &channel, &worker_id) != 2) {
+          fprintf(stderr, "Invalid channel: %s\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-r reactors] [-w workers] [-b epoll|uring] [-f max_frame] [-s] [-z]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  /* One reactor per CPU */
+  if (reactors_amount <= 0)
+    reactors_amount = sysconf(_SC_NPROCESSORS_ONLN);
+
+  /* One worker per CPU */
+  if (workers_amount == 0)
+    workers_amount = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (channel != -1)
+    server = create_worker(SERVER_IP, SERVER_PORT, backend, max_frame, splice, zerocopy, channel, worker_id);
+  else if (workers_amount > 0)
+    server = create_acceptor(SERVER_IP, SERVER_PORT, workers_amount, backend, max_frame, splice, zerocopy, argv[0]);
+  else
+    server = create_server(SERVER_IP, SERVER_PORT, reactors_amount, backend, max_frame, splice, zerocopy);
   atexit(cleanup);
   run_server(server); 
   exit(EXIT_SUCCESS);
@@ -0,0 +1,507 @@
+#include "../headers/prefork.h"
+#include <fcntl.h>
+#include <sys/wait.h>
+
+/*
+ * spawn_worker - used to start worker process with new
+ * socketpair. Worker is started from the same binary with
+ * hidden option that gives it its end of socketpair, so
+ * it doesn't inherit threads and locks of acceptor.
+ * @server - pointer to an object of server struct
+ * @id - index of worker
+ */
+static void spawn_worker(struct server* server, int id) {
+  struct acceptor* acceptor = server->acceptor;
+  struct worker* worker = &acceptor->workers[id];
+  struct epoll_event event;
+  char channel_arg[32], frame_arg[16];
+  char* argv[10];
+  int argc = 0;
+  int channels[2];
+
+  /* Messages keep their boundaries, both ends are closed on exec */
+  if (socketpair(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, channels) == -1)
+    print_error("socketpair");
+
+  snprintf(channel_arg, sizeof(channel_arg), "%d:%d", channels[1], id);
+  snprintf(frame_arg, sizeof(frame_arg), "%u", server->max_frame);
+  argv[argc++] = (char*) acceptor->path;
+  argv[argc++] = "-b";
+  argv[argc++] = server->backend == BACKEND_URING ? "uring" : "epoll";
+  argv[argc++] = "-f";
+  argv[argc++] = frame_arg;
+  argv[argc++] = "-c";
+  argv[argc++] = channel_arg;
+  if (server->splice)
+    argv[argc++] = "-s";
+  if (server->zerocopy)
+    argv[argc++] = "-z";
+  argv[argc] = NULL;
+
+  pid_t pid = fork();
+  if (pid == -1)
+    print_error("fork");
+
+  /* Worker keeps only its end of socketpair */
+  if (pid == 0) {
+    fcntl(channels[1], F_SETFD, 0);
+    execv("/proc/self/exe", argv);
+    _exit(EXIT_FAILURE);
+  }
+
+  close(channels[1]);
+
+  worker->pid = pid;
+  worker->channel = channels[0];
+  worker->started = metrics_now();
+  worker->restart_at = 0;
+  worker->handed = 0;
+  memset(&worker->load, 0, sizeof(worker->load));
+
+  /* Watch channel for load reports and exit of worker */
+  event.events = EPOLLIN;
+  event.data.u32 = id;
+  if (epoll_ctl(acceptor->epfd, EPOLL_CTL_ADD, worker->channel, &event) == -1)
+    print_error("epoll_ctl");
+
+  log_info("SERVER: Worker %d started with pid %d\n", id, pid);
+}
+
+/*
+ * restart_worker - used to reap exited worker and start
+ * new one in its place. Worker that failed right after
+ * start is only given restart deadline, acceptor starts it
+ * when deadline passes and keeps accepting meanwhile.
+ * Connections of exited worker are lost, passive socket
+ * and other workers are not affected.
+ * @server - pointer to an object of server struct
+ * @id - index of worker
+ */
+static void restart_worker(struct server* server, int id) {
+  struct worker* worker = &server->acceptor->workers[id];
+  uint64_t now = metrics_now();
+  int status;
+
+  close(worker->channel);
+  waitpid(worker->pid, &status, 0);
+  log_warn("SERVER: Worker %d (pid %d) exited with status %d, restarting\n", id, worker->pid,
+           WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status));
+
+  worker->pid = -1;
+  worker->channel = -1;
+
+  /* Don't spin when worker fails right after start */
+  if (now - worker->started < WORKER_RESTART_DELAY * 1000000000ull) {
+    worker->restart_at = worker->started + WORKER_RESTART_DELAY * 1000000000ull;
+    return;
+  }
+
+  spawn_worker(server, id);
+}
+
+/*
+ * restart_due_workers - used to start workers whose restart
+ * deadline passed.
+ * @server - pointer to an object of server struct
+ *
+ * Return: time to wait for next deadline in milliseconds,
+ * -1 if no worker waits for restart
+ */
+static int restart_due_workers(struct server* server) {
+  struct acceptor* acceptor = server->acceptor;
+  uint64_t now = metrics_now();
+  int timeout = -1;
+
+  for (int i = 0; i < acceptor->workers_amount; i++) {
+    struct worker* worker = &acceptor->workers[i];
+
+    if (!worker->restart_at)
+      continue;
+
+    if (worker->restart_at <= now) {
+      spawn_worker(server, i);
+      continue;
+    }
+
+    /* Round up, so deadline has passed on wakeup */
+    int wait = (worker->restart_at - now + 999999) / 1000000;
+    if (timeout == -1 || wait < timeout)
+      timeout = wait;
+  }
+
+  return timeout;
+}
+
+/*
+ * read_reports - used to take load reports of worker.
+ * Only the latest report matters.
+ * @server - pointer to an object of server struct
+ * @id - index of worker
+ *
+ * Return: 0 if worker is alive, -1 if its channel is closed
+ */
+static int read_reports(struct server* server, int id) {
+  struct worker* worker = &server->acceptor->workers[id];
+  struct worker_load load;
+
+  while (1) {
+    ssize_t bytes_read = recv(worker->channel, &load, sizeof(load), MSG_DONTWAIT);
+
+    if (bytes_read == sizeof(load))
+      worker->load = load;
+    else if (bytes_read == 0)
+      return -1;
+    else if (bytes_read == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 0;
+      if (errno != EINTR)
+        return -1;
+    }
+  }
+}
+
+/*
+ * pick_worker - used to find the least loaded running worker.
+ * Load is the last report plus connections handed after it.
+ * @acceptor - pointer to an object of acceptor struct
+ *
+ * Return: index of worker, -1 if all wait for restart
+ */
+static int pick_worker(struct acceptor* acceptor) {
+  uint64_t best_load = UINT64_MAX;
+  int best = -1;
+
+  for (int i = 0; i < acceptor->workers_amount; i++) {
+    struct worker* worker = &acceptor->workers[i];
+    uint64_t load = worker->load.clients + (worker->handed - worker->load.received);
+
+    if (worker->pid == -1)
+      continue;
+
+    if (load < best_load) {
+      best_load = load;
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+/*
+ * hand_connection - used to pass descriptor of connection
+ * and address of the client to worker with SCM_RIGHTS.
+ * @worker - pointer to an object of worker struct
+ * @client_addr - pointer to address of the client
+ * @client_fd - descriptor of connection
+ *
+ * Return: 0 on success, -1 if worker can't take it
+ */
+static int hand_connection(struct worker* worker, struct sockaddr_storage* client_addr, int client_fd) {
+  char control[CMSG_SPACE(sizeof(int))];
+  struct handoff handoff;
+  struct msghdr msg;
+  struct iovec iov;
+
+  memset(&msg, 0, sizeof(msg));
+  memset(control, 0, sizeof(control));
+  handoff.addr = *client_addr;
+
+  iov.iov_base = &handoff;
+  iov.iov_len = sizeof(handoff);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &client_fd, sizeof(int));
+
+  if (sendmsg(worker->channel, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == -1)
+    return -1;
+
+  worker->handed++;
+
+  return 0;
+}
+
+/*
+ * accept_connections - used to accept all pending connections
+ * and hand each of them to the least loaded worker. Descriptor
+ * is closed in acceptor once it was passed.
+ * @server - pointer to an object of server struct
+ */
+static void accept_connections(struct server* server) {
+  struct acceptor* acceptor = server->acceptor;
+  struct sockaddr_storage client;
+  socklen_t client_size;
+  int flags = SOCK_CLOEXEC;
+
+  /* Epoll workers need non-blocking sockets, io_uring waits by itself */
+  if (server->backend == BACKEND_EPOLL)
+    flags |= SOCK_NONBLOCK;
+
+  while (1) {
+    client_size = sizeof(client);
+    uint64_t start = metrics_now();
+    int client_fd = accept4(acceptor->sfd, (struct sockaddr*) &client, &client_size, flags);
+
+    if (client_fd == -1) {
+      /* No more pending connections */
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      /* Connection aborted before accept or interrupted */
+      if (errno == ECONNABORTED || errno == EINTR)
+        continue;
+      /* Out of descriptors, let workers release some */
+      if (errno == EMFILE || errno == ENFILE) {
+        log_error("SERVER: Accept failed: %s\n", strerror(errno));
+        break;
+      }
+      print_error("accept4");
+    }
+
+    metrics_record(STAGE_ACCEPT, start);
+
+    int id = pick_worker(acceptor);
+    if (id == -1)
+      log_warn("SERVER: No worker is running, connection dropped\n");
+    else if (hand_connection(&acceptor->workers[id], &client, client_fd) == -1)
+      log_warn("SERVER: Worker (pid %d) can't take connection: %s\n", acceptor->workers[id].pid,
+               strerror(errno));
+
+    close(client_fd);
+  }
+}
+
+/*
+ * create_acceptor - used to create server that accepts
+ * connections in its own process and serves them in worker
+ * processes. Server has no reactors of its own.
+ * @ip - IPv4 address of the server
+ * @port - port of the server
+ * @workers_amount - amount of worker processes
+ * @backend - IO engine of workers
+ * @max_frame - max allowed length of message from client
+ * @splice - relay payload of long messages by splice (epoll only)
+ * @zerocopy - send large replies by MSG_ZEROCOPY (epoll only)
+ * @path - path of the binary, used to start workers
+ *
+ * Return: pointer to an object of server struct
+ */
+struct server* create_acceptor(const char* ip, const int port, int workers_amount, enum backend backend,
+                               uint32_t max_frame, int splice, int zerocopy, const char* path) {
+  struct server* server = create_server(ip, port, 0, backend, max_frame, splice, zerocopy);
+  int enable = 1;
+
+  struct acceptor* acceptor = (struct acceptor*) malloc(sizeof(struct acceptor));
+  if (!acceptor)
+    print_error("malloc");
+
+  acceptor->path = path;
+  acceptor->workers_amount = workers_amount;
+  acceptor->workers = (struct worker*) calloc(workers_amount, sizeof(struct worker));
+  if (!acceptor->workers)
+    print_error("calloc");
+  for (int i = 0; i < workers_amount; i++) {
+    acceptor->workers[i].pid = -1;
+    acceptor->workers[i].channel = -1;
+  }
+
+  /* Workers must not inherit passive socket */
+  acceptor->sfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (acceptor->sfd == -1)
+    print_error("socket");
+
+  if (setsockopt(acceptor->sfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1)
+    print_error("setsockopt");
+
+  acceptor->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (acceptor->epfd == -1)
+    print_error("epoll_create1");
+
+  server->acceptor = acceptor;
+
+  return server;
+}
+
+/*
+ * create_worker - used to create server of worker process.
+ * Worker runs one reactor that gets connections from
+ * acceptor over channel instead of passive socket.
+ * @ip - IPv4 address of the server (used in logs only)
+ * @port - port of the server (used in logs only)
+ * @backend - IO engine of the reactor
+ * @max_frame - max allowed length of message from client
+ * @splice - relay payload of long messages by splice (epoll only)
+ * @zerocopy - send large replies by MSG_ZEROCOPY (epoll only)
+ * @channel - workers end of socketpair
+ * @id - index of worker
+ *
+ * Return: pointer to an object of server struct
+ */
+struct server* create_worker(const char* ip, const int port, enum backend backend, uint32_t max_frame, int splice,
+                             int zerocopy, int channel, int id) {
+  struct server* server = create_server(ip, port, 0, backend, max_frame, splice, zerocopy);
+
+  /* Channel is drained until it would block */
+  if (fcntl(channel, F_SETFL, fcntl(channel, F_GETFL) | O_NONBLOCK) == -1)
+    print_error("fcntl");
+  fcntl(channel, F_SETFD, FD_CLOEXEC);
+
+  server->channel = channel;
+  server->worker_id = id;
+
+  server->reactors_amount = 1;
+  free(server->reactors);
+  server->reactors = (struct reactor*) malloc(sizeof(struct reactor));
+  if (!server->reactors)
+    print_error("malloc");
+  init_reactor(&server->reactors[0], server, 0);
+
+  return server;
+}
+
+/*
+ * run_acceptor - used to bind passive socket, start workers
+ * and hand them connections. Exited workers are restarted,
+ * waiting ends on nearest restart deadline.
+ * @server - pointer to an object of server struct
+ */
+void run_acceptor(struct server* server) {
+  struct acceptor* acceptor = server->acceptor;
+  struct epoll_event events[EVENTS_AMOUNT];
+  struct epoll_event event;
+
+  /* Bind Endpoint to socket */
+  if (bind(acceptor->sfd, (struct sockaddr*) &server->serv, sizeof(server->serv)) == -1)
+    print_error("bind");
+
+  /* Set socket to passive mode */
+  if (listen(acceptor->sfd, SOMAXCONN) == -1)
+    print_error("listen");
+
+  /* Passive socket is marked with index past workers */
+  event.events = EPOLLIN | EPOLLET;
+  event.data.u32 = acceptor->workers_amount;
+  if (epoll_ctl(acceptor->epfd, EPOLL_CTL_ADD, acceptor->sfd, &event) == -1)
+    print_error("epoll_ctl");
+
+  for (int i = 0; i < acceptor->workers_amount; i++)
+    spawn_worker(server, i);
+
+  while (1) {
+    int timeout = restart_due_workers(server);
+    int ready = epoll_wait(acceptor->epfd, events, EVENTS_AMOUNT, timeout);
+    if (ready == -1) {
+      if (errno == EINTR)
+        continue;
+      print_error("epoll_wait");
+    }
+
+    for (int i = 0; i < ready; i++) {
+      int id = events[i].data.u32;
+
+      if (id == acceptor->workers_amount)
+        accept_connections(server);
+      else if (read_reports(server, id) == -1)
+        restart_worker(server, id);
+    }
+  }
+}
+
+/*
+ * receive_handoffs - used by worker to take all connections
+ * that acceptor passed over channel and report new load.
+ * Worker exits when acceptor closes channel.
+ * @reactor - pointer to an object of reactor struct
+ */
+void receive_handoffs(struct reactor* reactor) {
+  struct server* server = reactor->server;
+  char control[CMSG_SPACE(sizeof(int))];
+  struct handoff handoff;
+  struct msghdr msg;
+  struct iovec iov;
+  int received = 0;
+
+  while (1) {
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &handoff;
+    iov.iov_len = sizeof(handoff);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t bytes_read = recvmsg(server->channel, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (bytes_read == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      print_error("recvmsg");
+    }
+
+    /* Acceptor is gone */
+    if (bytes_read == 0) {
+      log_info("SERVER: Worker %d lost acceptor, exiting\n", server->worker_id);
+      exit(EXIT_SUCCESS);
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    int client_fd;
+    memcpy(&client_fd, CMSG_DATA(cmsg), sizeof(int));
+    server->received++;
+    received++;
+
+    add_client(reactor, &handoff.addr, client_fd);
+  }
+
+  if (received)
+    report_load(server);
+}
+
+/*
+ * report_load - used by worker to send its amount of
+ * connections to acceptor. Report is dropped if channel
+ * is full, next one replaces it anyway.
+ * @server - pointer to an object of server struct
+ */
+void report_load(struct server* server) {
+  struct worker_load load;
+
+  if (server->channel == -1)
+    return;
+
+  load.clients = registry_size(&server->reactors[0].clients);
+  load.received = server->received;
+  send(server->channel, &load, sizeof(load), MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/*
+ * free_acceptor - used to stop workers, close passive
+ * socket and free memory of acceptor. Workers exit once
+ * their channels are closed.
+ * @acceptor - pointer to an object of acceptor struct
+ */
+void free_acceptor(struct acceptor* acceptor) {
+  for (int i = 0; i < acceptor->workers_amount; i++) {
+    struct worker* worker = &acceptor->workers[i];
+
+    if (worker->pid == -1)
+      continue;
+
+    close(worker->channel);
+    waitpid(worker->pid, NULL, 0);
+  }
+
+  close(acceptor->epfd);
+  close(acceptor->sfd);
+  free(acceptor->workers);
+  free(acceptor);
+}
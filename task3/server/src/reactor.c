@@ -0,0 +1,427 @@
+#include "../headers/reactor.h"
+#include "../headers/server.h"
+#include "../headers/uring_reactor.h"
+#include "../headers/prefork.h"
+#include <sched.h>
+#include <netinet/tcp.h>
+
+/*
+ * init_reactor - used to initialize reactor fields, create
+ * its passive socket and epoll instance. When server runs
+ * several reactors, passive sockets are created with SO_REUSEPORT
+ * so kernel spreads connections between them.
+ * @reactor - pointer to an object of reactor struct
+ * @server - pointer to server that owns reactor
+ * @id - index of reactor
+ */
+void init_reactor(struct reactor* reactor, struct server* server, int id) {
+  int enable = 1;
+  int type = SOCK_STREAM;
+
+  reactor->server = server;
+  reactor->id = id;
+
+  init_registry(&reactor->clients);
+  reactor->now = metrics_now();
+  init_timer_wheel(&reactor->timers, reactor->now);
+
+  /* io_uring instance is created by reactors thread */
+  reactor->ring.fd = -1;
+  reactor->pinned = 0;
+  reactor->starved = NULL;
+
+  /* Create epoll instance */
+  reactor->epfd = -1;
+  if (server->backend == BACKEND_EPOLL) {
+    reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epfd == -1)
+      print_error("epoll_create1");
+  }
+
+  /* Prefork worker gets connections over channel instead */
+  if (server->channel != -1) {
+    reactor->sfd = server->channel;
+    return;
+  }
+
+  /* Epoll needs non-blocking sockets, io_uring waits by itself */
+  if (server->backend == BACKEND_EPOLL)
+    type |= SOCK_NONBLOCK;
+
+  /* Create a socket */
+  reactor->sfd = socket(AF_INET, type, 0);
+  if (reactor->sfd == -1)
+    print_error("socket");
+
+  if (setsockopt(reactor->sfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1)
+    print_error("setsockopt");
+
+  /* Share port between reactors */
+  if (server->reactors_amount > 1 &&
+      setsockopt(reactor->sfd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1)
+    print_error("setsockopt");
+}
+
+/*
+ * start_reactor - used to bind reactors socket, set it
+ * to passive mode and register it in epoll. Passive socket
+ * (or channel of prefork worker) is registered with NULL
+ * data pointer, clients sockets with pointer to their
+ * client struct.
+ * @reactor - pointer to an object of reactor struct
+ */
+void start_reactor(struct reactor* reactor) {
+  struct epoll_event event;
+  struct sockaddr_in* serv = &reactor->server->serv;
+
+  if (reactor->server->channel == -1) {
+    /* Bind Endpoint to socket */
+    if (bind(reactor->sfd, (struct sockaddr*) serv, sizeof(*serv)) == -1)
+      print_error("bind");
+
+    /* Set socket to passive mode */
+    if (listen(reactor->sfd, SOMAXCONN) == -1)
+      print_error("listen");
+  }
+
+  /* io_uring accepts connections with its own request */
+  if (reactor->server->backend != BACKEND_EPOLL)
+    return;
+
+  /* Watch passive socket for new connections */
+  event.events = EPOLLIN | EPOLLET;
+  event.data.ptr = NULL;
+  if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->sfd, &event) == -1)
+    print_error("epoll_ctl");
+}
+
+/*
+ * run_reactor - used as thread function that runs event
+ * loop of the reactor on selected backend. Thread is pinned to CPU with index
+ * of the reactor when server runs several reactors.
+ * @arg - pointer to an object of reactor struct
+ */
+void* run_reactor(void* arg) {
+  struct reactor* reactor = (struct reactor*) arg;
+  struct epoll_event events[EVENTS_AMOUNT];
+
+  /* Pin reactor to its CPU */
+  if (reactor->server->reactors_amount > 1) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(reactor->id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+
+  if (reactor->server->backend == BACKEND_URING) {
+    run_uring_reactor(reactor);
+    return NULL;
+  }
+
+  /* Wait for events, wake up for next tick with deadlines */
+  while (1) {
+    int timeout = timer_wheel_timeout(&reactor->timers, reactor->now);
+    int ready = epoll_wait(reactor->epfd, events, EVENTS_AMOUNT, timeout);
+    if (ready == -1) {
+      if (errno == EINTR)
+        continue;
+      print_error("epoll_wait");
+    }
+
+    reactor->now = metrics_now();
+
+    for (int i = 0; i < ready; i++) {
+      /* New connections */
+      if (events[i].data.ptr == NULL)
+        accept_clients(reactor);
+      /* Clients socket is ready */
+      else
+        handle_client_connection((struct client*) events[i].data.ptr, events[i].events);
+    }
+
+    /* Events were handled, expired clients may be freed now */
+    expire_clients(reactor);
+  }
+
+  return NULL;
+}
+
+/*
+ * accept_clients - used to accept all pending connections
+ * on passive socket. Passive socket is edge-triggered, so
+ * it must be drained until accept would block. Prefork worker
+ * takes connections handed by acceptor instead.
+ * @reactor - pointer to an object of reactor struct
+ */
+void accept_clients(struct reactor* reactor) {
+  struct sockaddr_storage client;
+  socklen_t client_size;
+
+  if (reactor->server->channel != -1) {
+    receive_handoffs(reactor);
+    return;
+  }
+
+  while (1) {
+    client_size = sizeof(client);
+    uint64_t start = metrics_now();
+    int client_fd = accept4(reactor->sfd, (struct sockaddr*) &client, &client_size, SOCK_NONBLOCK);
+
+    if (client_fd == -1) {
+      /* No more pending connections */
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      /* Connection aborted before accept or interrupted */
+      if (errno == ECONNABORTED || errno == EINTR)
+        continue;
+      /* Out of descriptors, keep serving existing clients */
+      if (errno == EMFILE || errno == ENFILE) {
+        log_error("SERVER: Accept failed: %s\n", strerror(errno));
+        break;
+      }
+      print_error("accept4");
+    }
+
+    metrics_record(STAGE_ACCEPT, start);
+    add_client(reactor, &client, client_fd);
+  }
+}
+
+/*
+ * add_client - used to add client object to registry
+ * of clients and start receiving from its socket.
+ * @reactor - pointer to an object of reactor struct
+ * @client_addr - pointer to address of client (IPv4 or IPv6)
+ * client_fd - descriptor for communication with client
+ */
+void add_client(struct reactor* reactor, struct sockaddr_storage* client_addr, int client_fd) {
+  struct epoll_event event;
+  int enable = 1;
+
+  struct client* client = (struct client*) calloc(1, sizeof(struct client));
+  if (!client)
+    print_error("calloc");
+
+  /* Initialzie client struct */
+  client->addr = *client_addr;
+  client->fd = client_fd;
+  client->reactor = reactor;
+  addr_to_endpoint((struct sockaddr*) &client->addr, &client->endpoint);
+  client->connected_at = metrics_now();
+  client->active_at = client->connected_at;
+  client->pipe[0] = -1;
+  client->pipe[1] = -1;
+
+  /* Relayed messages are streamed from their first small chunk */
+  if (reactor->server->splice && reactor->server->backend == BACKEND_EPOLL)
+    init_decoder(&client->decoder, reactor->server->max_frame, SPLICE_CHUNK_SIZE);
+  else
+    init_decoder(&client->decoder, reactor->server->max_frame, STREAM_CHUNK_SIZE);
+  client->id = registry_insert(&reactor->clients, client);
+
+  /* Idle deadline starts */
+  init_timer(&client->timer, client);
+  arm_client_timer(client);
+
+  /* Replies are batched already, don't let Nagle hold them until ACK */
+  if (setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)) == -1)
+    log_warn("SERVER: TCP_NODELAY of client %s not set: %s\n", client->endpoint.text, strerror(errno));
+
+  /* Without SO_ZEROCOPY replies are copied as usual */
+  if (reactor->server->zerocopy && reactor->server->backend == BACKEND_EPOLL) {
+    if (setsockopt(client_fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == -1)
+      log_warn("SERVER: SO_ZEROCOPY of client %s not set, replies are copied: %s\n",
+               client->endpoint.text, strerror(errno));
+    else
+      client->zerocopy = 1;
+  }
+
+  if (reactor->server->backend == BACKEND_URING) {
+    /* Receive with multishot request */
+    submit_recv(client);
+  } else {
+    /* Watch socket for input and output */
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = client;
+    if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, client_fd, &event) == -1)
+      print_error("epoll_ctl");
+  }
+
+  metrics_add(METRIC_ACCEPTED, 1);
+  log_info("SERVER: Client %s connected\n", client->endpoint.text);
+}
+
+/*
+ * client_deadline - used to find nearest deadline of the
+ * client: write deadline while it is paused, read deadline
+ * while part of frame waits for the rest, idle otherwise.
+ * @client - pointer to an object of client struct
+ *
+ * Return: time client expires at (metrics_now clock)
+ */
+static uint64_t client_deadline(struct client* client) {
+  if (client->paused)
+    return client->paused_at + SEND_QUEUE_TIMEOUT * 1000000000ull;
+  if (client->frame_at)
+    return client->frame_at + READ_TIMEOUT * 1000000000ull;
+
+  return client->active_at + IDLE_TIMEOUT * 1000000000ull;
+}
+
+/*
+ * arm_client_timer - used when deadline of the client may
+ * get nearer. Timer is moved only if it expires later, activity
+ * that moves deadline away doesn't touch wheel at all: expired
+ * timer checks state of the client and is armed again.
+ * @client - pointer to an object of client struct
+ */
+void arm_client_timer(struct client* client) {
+  timer_wheel_shorten(&client->reactor->timers, &client->timer, client_deadline(client));
+}
+
+/*
+ * track_partial_frame - used after received bytes were
+ * consumed to start read deadline when decoder is left with
+ * part of next frame. Receivers reset frame_at on every
+ * complete frame (or chunk of streamed one), so deadline
+ * counts from start of the frame or from last chunk. Relay
+ * that waits for socket is tracked the same way.
+ * @client - pointer to an object of client struct
+ */
+void track_partial_frame(struct client* client) {
+  if (!decoder_pending(&client->decoder) && !client->decoder.left && !client->relay_left && !client->piped) {
+    client->frame_at = 0;
+    return;
+  }
+
+  if (!client->frame_at) {
+    client->frame_at = client->reactor->now;
+    arm_client_timer(client);
+  }
+}
+
+/*
+ * expire_client - used as callback of timer wheel. Client
+ * whose deadline moved away is armed again, otherwise it
+ * is disconnected.
+ * @item - pointer to an object of client struct
+ * @arg - pointer to an object of reactor struct
+ */
+static void expire_client(void* item, void* arg) {
+  struct client* client = (struct client*) item;
+  struct reactor* reactor = (struct reactor*) arg;
+  uint64_t deadline = client_deadline(client);
+
+  if (deadline > reactor->now) {
+    timer_wheel_add(&reactor->timers, &client->timer, deadline);
+    return;
+  }
+
+  if (client->paused)
+    log_warn("SERVER: Client %s didn't read replies for %d s, disconnecting\n",
+             client->endpoint.text, SEND_QUEUE_TIMEOUT);
+  else if (client->frame_at)
+    log_warn("SERVER: Client %s didn't complete message for %d s, disconnecting\n",
+             client->endpoint.text, READ_TIMEOUT);
+  else
+    log_info("SERVER: Client %s was idle for %d s, disconnecting\n", client->endpoint.text, IDLE_TIMEOUT);
+
+  if (reactor->server->backend == BACKEND_URING) {
+    close_uring_connection(client);
+    if (client->inflight == 0)
+      close_connection(client);
+  } else {
+    close_connection(client);
+  }
+}
+
+/*
+ * expire_clients - used at the end of event loop iteration
+ * to disconnect clients whose deadlines passed by time of
+ * the iteration (reactor->now).
+ * @reactor - pointer to an object of reactor struct
+ */
+void expire_clients(struct reactor* reactor) {
+  timer_wheel_advance(&reactor->timers, reactor->now, expire_client, reactor);
+}
+
+/*
+ * pause_client - used to mark client whose queued replies
+ * reached SEND_QUEUE_HIGH, caller stops reading from it.
+ * Write deadline starts.
+ * @client - pointer to an object of client struct
+ */
+void pause_client(struct client* client) {
+  client->paused = 1;
+  client->paused_at = client->reactor->now;
+  arm_client_timer(client);
+
+  log_debug("SERVER: Client %s paused with %zu bytes queued\n", client->endpoint.text, client->queued);
+}
+
+/*
+ * resume_client - used to unmark paused client once its
+ * queued replies drained to SEND_QUEUE_LOW, caller starts
+ * reading from it again.
+ * @client - pointer to an object of client struct
+ */
+void resume_client(struct client* client) {
+  client->paused = 0;
+
+  log_debug("SERVER: Client %s resumed with %zu bytes queued\n", client->endpoint.text, client->queued);
+}
+
+/*
+ * delete_client - used to delete client object from
+ * registry of clients and free it.
+ * @reactor - pointer to an object of reactor struct
+ * @client - pointer to an object of client struct
+ */
+void delete_client(struct reactor* reactor, struct client* client) {
+  registry_remove(&reactor->clients, client->id);
+
+  /* Released buffers must not wake client being freed */
+  if (client->starved)
+    forget_starved_client(client);
+
+  timer_wheel_remove(&reactor->timers, &client->timer);
+
+  metrics_add(METRIC_CLOSED, 1);
+  report_load(reactor->server);
+
+  /* Free replies that were not sent and buffers kernel released */
+  free_replies(client->replies);
+  free_replies(client->sending);
+  free_replies(client->zc_pending);
+
+  free_decoder(&client->decoder);
+  if (client->pipe[0] != -1) {
+    close(client->pipe[0]);
+    close(client->pipe[1]);
+  }
+  free(client->iov);
+  free(client);
+}
+
+/*
+ * free_reactor - used to close all connections of the
+ * reactor and free its memory. Reactor struct itself
+ * is owned by server.
+ * @reactor - pointer to an object of reactor struct
+ */
+void free_reactor(struct reactor* reactor) {
+  struct client* client;
+  uint32_t index = 0;
+
+  while ((client = (struct client*) registry_next(&reactor->clients, &index)))
+    shutdown_connection(client);
+
+  if (reactor->ring.fd != -1) {
+    uring_free_buffers(&reactor->ring, &reactor->buffers);
+    uring_free(&reactor->ring);
+  }
+  if (reactor->epfd != -1)
+    close(reactor->epfd);
+  close(reactor->sfd);
+  free_registry(&reactor->clients);
+}
@@ -1,270 +1,547 @@
 #include "../headers/server.h"
+#include "../headers/prefork.h"
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
 
 /*
  * create_server - used to create an object of server
- * struct, initializes its fields.
- * @path - path to socket file
+ * struct, initializes its fields and reactors.
+ * @ip - IPv4 address of the server
+ * @port - port of the server
+ * @reactors_amount - amount of event loops (threads)
+ * @backend - IO engine of event loops
+ * @max_frame - max allowed length of message from client
+ * @splice - relay payload of long messages by splice (epoll only)
+ * @zerocopy - send large replies by MSG_ZEROCOPY (epoll only)
  *
- * Return: pointer to an object of server struct 
+ * Return: pointer to an object of server struct
  */
-struct server* create_server(const char* ip, const int port) {
+struct server* create_server(const char* ip, const int port, int reactors_amount, enum backend backend,
+                             uint32_t max_frame, int splice, int zerocopy) {
   struct server* server = (struct server*) malloc(sizeof(struct server));
   if (!server)
     print_error("malloc");
 
-  /* Initialzie sockaddr_un struct */
+  /* Initialzie sockaddr_in struct */
   server->serv.sin_family = AF_INET;
-  server->serv.sin_addr.s_addr = inet_addr(ip); 
+  server->serv.sin_addr.s_addr = inet_addr(ip);
   server->serv.sin_port = htons(port);
 
-  /* Initialize clients array */
-  server->clients_amount = 0;
-  server->clients = (struct client**) malloc(CLIENTS_AMOUNT * sizeof(struct client*));
-  if (!server->clients)
+  /* Allow as many descriptors as hard limit permits */
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  server->max_frame = max_frame;
+  server->splice = splice;
+  server->zerocopy = zerocopy;
+  server->admin.sfd = -1;
+  server->acceptor = NULL;
+  server->channel = -1;
+  server->worker_id = 0;
+  server->received = 0;
+
+  /* Initialize reactors */
+  server->backend = backend;
+  server->reactors_amount = reactors_amount;
+  server->reactors = (struct reactor*) malloc(reactors_amount * sizeof(struct reactor));
+  if (!server->reactors)
     print_error("malloc");
 
-  /* Create a socket */
-  server->sfd = socket(AF_INET, SOCK_STREAM, 0);
-  if (server->sfd == -1)
-    print_error("socket");
+  for (int i = 0; i < reactors_amount; i++)
+    init_reactor(&server->reactors[i], server, i);
 
   return server;
 }
 
 /*
- * run_server - used to bind server, set it
- * to passive mode and accept connections
+ * run_server - used to bind passive sockets of all
+ * reactors, start admin socket and run their event loops. Single reactor
+ * runs in calling thread, several reactors run in their
+ * own threads. Prefork acceptor runs its own loop, each
+ * worker gets admin socket with its index appended.
  * @server - pointer to an object of server struct
  */
 void run_server(struct server* server) {
-  struct sockaddr_in client;
-  socklen_t client_size = sizeof(client);
-
-  /* Bind Endpoint to socket */
-  if (bind(server->sfd, (struct sockaddr*) &server->serv, sizeof(server->serv)) == -1)
-    print_error("bind");
-  
-  /* Set socket to passive mode */
-  if (listen(server->sfd, CLIENTS_AMOUNT) == -1)
-    print_error("listen");
-  
-  struct endpoint* serv_ep = addr_to_endpoint(&server->serv); 
-  printf("SERVER: Server %s:%d started\n", serv_ep->ip, serv_ep->port);
-  free(serv_ep);
-
-  /* Accept connections */
-  while (1) {
-    int client_fd;
-    client_fd = accept(server->sfd, (struct sockaddr*) &client, &client_size);
-    
-    /* Error occured */
-    if (client_fd == -1) {
-      print_error("accept");
-    }
-    /* Connection shutdown */
-    else if (client_fd == 0) {
-      break;
-    } 
-    /* Message received */
-    else {
-      struct endpoint* client_ep = addr_to_endpoint(&client); 
-      printf("SERVER: Client %s:%d connected\n", client_ep->ip, client_ep->port);
-      add_client(server, &client, client_fd);
-      free(client_ep);
-    }
+  char admin_path[sizeof(ADMIN_SOCK_PATH) + 16];
+  struct endpoint serv_ep;
+
+  addr_to_endpoint((struct sockaddr*) &server->serv, &serv_ep);
+
+  if (server->acceptor) {
+    start_admin(&server->admin, ADMIN_SOCK_PATH, NULL, NULL);
+    log_info("SERVER: Server %s started with %d %s worker(s)\n", serv_ep.text,
+             server->acceptor->workers_amount, server->backend == BACKEND_URING ? "io_uring" : "epoll");
+    run_acceptor(server);
+    return;
   }
+
+  for (int i = 0; i < server->reactors_amount; i++)
+    start_reactor(&server->reactors[i]);
+
+  if (server->channel != -1) {
+    snprintf(admin_path, sizeof(admin_path), "%s.%d", ADMIN_SOCK_PATH, server->worker_id);
+    start_admin(&server->admin, admin_path, collect_clients, server);
+  } else {
+    start_admin(&server->admin, ADMIN_SOCK_PATH, collect_clients, server);
+    log_info("SERVER: Server %s started with %d %s reactor(s)\n", serv_ep.text,
+             server->reactors_amount, server->backend == BACKEND_URING ? "io_uring" : "epoll");
+  }
+
+  /* Run event loop in current thread */
+  if (server->reactors_amount == 1) {
+    run_reactor(&server->reactors[0]);
+    return;
+  }
+
+  /* Run event loops in their threads */
+  for (int i = 0; i < server->reactors_amount; i++) {
+    if (pthread_create(&server->reactors[i].thread, NULL, run_reactor, &server->reactors[i]) != 0)
+      print_error("pthread_create");
+  }
+
+  for (int i = 0; i < server->reactors_amount; i++)
+    pthread_join(server->reactors[i].thread, NULL);
 }
 
 /*
- * add_client - used to add client object to array
- * of clients.
- * @server - pointer to an object of server struct
- * @client_addr - pointer to an object of sockaddr_un struct  
- * client_fd - descriptor for communication with client
+ * handle_client_connection - used in event loop to
+ * handle events on clients socket. Takes all messages
+ * client has sent so far, queues replies in the same order
+ * and sends them together. Reading stops while queued
+ * replies are above SEND_QUEUE_HIGH and resumes once
+ * they drain to SEND_QUEUE_LOW. If client calls shutdown,
+ * connection will be closed, memory freed.
+ * @client - pointer to an object of client struct
+ * @events - epoll events of clients socket
  */
-void add_client(struct server* server, struct sockaddr_in* client_addr, int client_fd) {
-  /* Check if server is full */
-  if (server->clients_amount == CLIENTS_AMOUNT)
+void handle_client_connection(struct client* client, uint32_t events) {
+  int readable = events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP);
+  enum io_status status;
+
+  /* Hang up is reported once, EOF may follow data of the same event */
+  if (events & (EPOLLRDHUP | EPOLLHUP))
+    client->hangup = 1;
+
+  /* Socket failed, with zerocopy error queue reports completions too */
+  if ((events & EPOLLERR) && (!client->reactor->server->zerocopy || reap_zerocopy(client) == -1)) {
+    log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+    close_connection(client);
     return;
+  }
+
+  /* Paused client waits until socket takes its replies. Socket
+     is edge-triggered, so input that came meanwhile is read now */
+  if (client->paused) {
+    if (send_message(client) == IO_CLOSED) {
+      log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+      close_connection(client);
+      return;
+    }
+    if (client->queued > SEND_QUEUE_LOW)
+      return;
+
+    resume_client(client);
+    readable = 1;
+  }
+
+  /* Payload of long message is relayed before next message is read */
+  if (client->relay_left || client->piped) {
+    status = relay_payload(client);
+    if (status == IO_CLOSED) {
+      log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+      close_connection(client);
+      return;
+    }
+    if (status == IO_AGAIN)
+      return;
+
+    readable = 1;
+  }
+
+  /* Receive messages until socket would block */
+  if (readable) {
+    client->drained = 0;
+
+    while (1) {
+      struct msgbuf* message;
+
+      status = recv_message(client, &message);
+      if (status == IO_AGAIN) {
+        track_partial_frame(client);
+        break;
+      }
+
+      /* Connection closed, client that shut down its side still
+         gets replies to its messages, socket is closed once they
+         are sent */
+      if (status == IO_CLOSED) {
+        if (client->hangup && client->replies && send_message(client) == IO_AGAIN)
+          return;
+
+        log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+        close_connection(client);
+        return;
+      }
+
+      /* Log message */
+      log_debug("SERVER: Received message from client %s: %.*s\n", client->endpoint.text,
+                (int) message->payload_len, message->payload);
 
-  struct client* client = (struct client*) malloc(sizeof(struct client));
+      /* Edit message in place and queue it as reply */
+      uint64_t start = metrics_now();
+      edit_message(message);
+      metrics_record(STAGE_TRANSFORM, start);
+      queue_reply(client, message);
 
-  /* Initialzie client struct */
-  client->addr = client_addr;
-  client->fd = client_fd;
-  client->id = server->clients_amount;
-  client->server = server;
-  client->endpoint = addr_to_endpoint(client_addr);
+      /* Rest of long message goes from socket to socket */
+      if (start_relay(client)) {
+        status = relay_payload(client);
+        if (status == IO_CLOSED) {
+          log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+          close_connection(client);
+          return;
+        }
+        if (status == IO_AGAIN)
+          return;
 
-  /* Create thread for client */
-  if (pthread_create(&client->thread, NULL, handle_client_connection, (void *) client) != 0)
-    print_error("pthread_create");
+        continue;
+      }
 
-  /* Add client to array*/
-  server->clients[server->clients_amount] = client;
-  server->clients_amount++;
+      /* Stop reading until peer takes replies */
+      if (client->queued >= SEND_QUEUE_HIGH) {
+        if (send_message(client) == IO_CLOSED) {
+          log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+          close_connection(client);
+          return;
+        }
+        if (client->queued >= SEND_QUEUE_HIGH) {
+          pause_client(client);
+          return;
+        }
+      }
+    }
+  }
+
+  /* Send replies to all received messages and data left from previous events */
+  if (client->replies && send_message(client) == IO_CLOSED) {
+    log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+    close_connection(client);
+  }
 }
 
 /*
- * delete_client - used to delete client object from
- * array of clients.
- * @server - pointer to an object of server struct
+ * queue_reply - used to write length header in front of
+ * message and add it to the end of clients queue. Header
+ * holds length of whole frame, continued chunks of streamed
+ * frame are queued as they are. Reply takes ownership of
+ * message.
  * @client - pointer to an object of client struct
+ * @message - message with prefix and REPLY_HEADROOM
  */
-void delete_client(struct server* server, struct client* client) {
-  int i;
-  
-  /* Find necessary client */
-  for (i = 0; i < server->clients_amount; i++) {
-    if (server->clients[i]->id == client->id) {
-      free(server->clients[i]);
-      break;
-    } 
-  }
+void queue_reply(struct client* client, struct msgbuf* message) {
+  struct reply* reply = (struct reply*) pool_alloc(sizeof(struct reply));
+  uint32_t net_len = htonl(message->frame_len);
+
+  log_debug("SERVER: Send message length: %u\n", msgbuf_length(message));
+  log_debug("SERVER: Server send message %s%.*s\n", message->data, (int) message->payload_len, message->payload);
+
+  if (!message->continued)
+    msgbuf_push(message, &net_len, sizeof(net_len));
+  reply->message = message;
+  reply->zerocopy = 0;
+  reply->next = NULL;
+  client->queued += msgbuf_length(message);
+
+  if (client->replies_tail)
+    client->replies_tail->next = reply;
+  else
+    client->replies = reply;
+  client->replies_tail = reply;
+}
 
-  /* Move i + 1 clients to left */
-  for (; i < server->clients_amount; i++) {
-     server->clients[i] = server->clients[i + 1]; 
+/*
+ * send_message - used to send queued replies to client.
+ * Up to REPLIES_AMOUNT replies, each already holding its
+ * length header, are gathered into one sendmsg call, payload
+ * straight from blocks it was received into. Replies that socket doesn't
+ * accept will be sent on next EPOLLOUT event. Reply above
+ * ZEROCOPY_MIN_SIZE is sent alone by MSG_ZEROCOPY if client
+ * has it enabled, its buffer waits for kernel to release it.
+ * @client - pointer to an object of client struct
+ *
+ * Return: IO_DONE if all replies sent, IO_AGAIN if some
+ * of them are pending, IO_CLOSED if connection failed
+ */
+enum io_status send_message(struct client* client) {
+  struct iovec iov[REPLIES_AMOUNT * 2];
+  struct msghdr msg;
+  ssize_t bytes_sent;
+  int copy = 0;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+
+  while (client->replies) {
+    size_t skip = client->reply_sent;
+    int flags = MSG_NOSIGNAL;
+    int replies = 0;
+    int count = 0;
+
+    /* Gather replies, skip part that was already sent */
+    for (struct reply* reply = client->replies; reply && replies < REPLIES_AMOUNT; reply = reply->next) {
+      /* Large reply goes alone, pinning small ones isn't worth it */
+      if (client->zerocopy && !copy && msgbuf_length(reply->message) - skip >= ZEROCOPY_MIN_SIZE) {
+        if (count > 0)
+          break;
+        flags |= MSG_ZEROCOPY;
+      }
+
+      count += msgbuf_iov(reply->message, skip, iov + count);
+      replies++;
+      skip = 0;
+
+      if (flags & MSG_ZEROCOPY)
+        break;
+    }
+
+    msg.msg_iovlen = count;
+    uint64_t start = metrics_now();
+    bytes_sent = sendmsg(client->fd, &msg, flags);
+    metrics_record(STAGE_SEND, start);
+    if (bytes_sent == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return IO_AGAIN;
+      if (errno == EINTR)
+        continue;
+
+      /* Too many zerocopy sends wait for completion, copy this one */
+      if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+        copy = 1;
+        continue;
+      }
+      log_warn("SERVER: Send to client %s failed: %s\n", client->endpoint.text, strerror(errno));
+      return IO_CLOSED;
+    }
+
+    /* Kernel numbers zerocopy sends, buffer is held until last of them completes */
+    if (flags & MSG_ZEROCOPY) {
+      client->replies->zerocopy = 1;
+      client->replies->zc_id = client->zc_next++;
+    }
+    copy = 0;
+
+    /* Drop replies that were sent completely */
+    metrics_add_bytes(METRIC_BYTES_OUT, &client->bytes_out, bytes_sent);
+    client->active_at = client->reactor->now;
+    client->reply_sent += bytes_sent;
+    while (client->replies && client->reply_sent >= msgbuf_length(client->replies->message)) {
+      struct reply* reply = client->replies;
+
+      metrics_add(METRIC_MESSAGES_OUT, !reply->message->continued);
+      client->reply_sent -= msgbuf_length(reply->message);
+      client->replies = reply->next;
+
+      /* Buffer kernel holds stays queued for backpressure */
+      if (reply->zerocopy) {
+        reply->next = NULL;
+        if (client->zc_pending_tail)
+          client->zc_pending_tail->next = reply;
+        else
+          client->zc_pending = reply;
+        client->zc_pending_tail = reply;
+        continue;
+      }
+
+      client->queued -= msgbuf_length(reply->message);
+      msgbuf_free(reply->message);
+      pool_free(reply);
+    }
   }
-  
-  /* Delete last pointer */
-  server->clients[i + 1] = NULL; 
-  server->clients_amount--;
+
+  client->replies_tail = NULL;
+
+  return IO_DONE;
 }
 
 /*
- * handle_client_connection - used int thread to
- * handle new messages from connected user. If
- * client calls shutdown, connection will be closed,
- * memory freed.
- * @arg - pointer to an object of client struct
+ * recv_message - used to take next message from client without
+ * blocking. Messages already held by clients decoder are taken
+ * without system calls, otherwise decoder receives as many bytes
+ * as it has space for. Short receive ends reading, unless client
+ * hung up and EOF still waits behind data. Message has REPLY_HEADROOM,
+ * its payload stays in decoder block it was received into. Long
+ * message is taken in pieces as they arrive. Message should be
+ * freed by msgbuf_free.
+ * @client - pointer to an object of client struct
+ * @message - pointer where received message is stored
+ *
+ * Return: IO_DONE if message received, IO_AGAIN if socket
+ * would block, IO_CLOSED if connection closed
  */
-void* handle_client_connection(void* arg) {
-  /* Cast arg to client struct*/
-  struct client* client = (struct client*) arg;
+enum io_status recv_message(struct client* client, struct msgbuf** message) {
+  ssize_t bytes_read;
 
-  char buffer[BUFFER_SIZE];
-  int bytes_read;
-  
   while (1) {
-    char* message = recv_message(client);
-    /* Connection closed */
-    if (message == NULL) {
-      printf("SERVER: Client %s:%d disconnected\n", client->endpoint->ip, client->endpoint->port);
-      close_connection(client);
-      break;
+    switch (decoder_borrow(&client->decoder, REPLY_HEADROOM, message)) {
+      case FRAME_OK:
+        log_debug("SERVER: Received message length: %u\n", (*message)->payload_len);
+        metrics_add(METRIC_MESSAGES_IN, !(*message)->continued);
+        client->frame_at = 0;
+        return IO_DONE;
+
+      case FRAME_TOO_BIG:
+        log_warn("SERVER: Client %s sent message longer than %u bytes\n",
+                 client->endpoint.text, client->decoder.max_frame);
+        return IO_CLOSED;
+
+      case FRAME_PARTIAL:
+        break;
     }
-    
-    /* Log message */
-    printf("SERVER: Received message from client %s:%d: %s\n", client->endpoint->ip, client->endpoint->port, message);
 
-    /* Edit message */
-    char* new_message = edit_message(message);
-    send_message(client, new_message);
+    /* Short receive already emptied socket */
+    if (client->drained)
+      return IO_AGAIN;
 
-    /* Free allocated memory */
-    free(new_message);
-    free(message);
-  }
+    size_t space = decoder_space(&client->decoder);
+    uint64_t start = metrics_now();
+    bytes_read = decoder_fill(&client->decoder, client->fd);
+    metrics_record(STAGE_RECV, start);
+
+    /* Connection closed */
+    if (bytes_read == 0)
+      return IO_CLOSED;
+
+    /* Error occured */
+    if (bytes_read == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return IO_AGAIN;
+      log_warn("SERVER: Receive from client %s failed: %s\n", client->endpoint.text, strerror(errno));
+      return IO_CLOSED;
+    }
 
-  return NULL;  
+    metrics_add_bytes(METRIC_BYTES_IN, &client->bytes_in, bytes_read);
+    client->active_at = client->reactor->now;
+    client->drained = (size_t) bytes_read < space && !client->hangup;
+  }
 }
 
 /*
- * send_message - used to send message to client. First
- * sends length of the buffer, then sends the message.
- * @client - pointer to an object of client struct 
- * @buffer - message
+ * edit_message - used to add prefix "Server " to message.
+ * Prefix is written in headroom in front of payload, so
+ * payload isn't copied. Streamed frame gets prefix in front
+ * of its first chunk, other chunks pass through unchanged.
+ * @message - message from client that needs to be changed
  */
-void send_message(struct client* client, char buffer[BUFFER_SIZE]) {
-  uint32_t message_len;
-  uint32_t net_len;
-  
-  message_len = strlen(buffer);
-  net_len = htonl(message_len);
-  
-  /* Send message length */
-  if (send(client->fd, &net_len, sizeof(net_len), 0) == -1)
-    print_error("send");
-  
-  printf("SERVER: Send message length: %d\n", message_len);
-
-  /* Send new message */
-  if (send(client->fd, buffer, message_len, 0) == -1)
-    print_error("send");
-
-  printf("SERVER: Server send message %s\n", buffer);
+void edit_message(struct msgbuf* message) {
+  if (message->continued)
+    return;
+
+  msgbuf_push(message, PREFIX, PREFIX_LEN);
+  message->frame_len += PREFIX_LEN;
 }
 
 /*
- * recv_message - used to receive message from client. Receives
- * message length first, then allocates memory for message and
- * receives full message. Returned message should be freed manually.
+ * start_relay - used after first piece of message was queued
+ * to take rest of its payload away from decoder, if server
+ * relays long messages. Bytes decoder already holds are
+ * queued as continued replies, the rest is left in socket for
+ * relay_payload. Pipe of the client is created on first relay.
  * @client - pointer to an object of client struct
  *
- * Return: string (message) if successful, NULL if connection closed 
+ * Return: 1 if relay started, 0 if message stays with decoder
  */
-char* recv_message(struct client* client) {
-  uint32_t net_len;
-  uint32_t message_len;
-  ssize_t bytes_read;
-  ssize_t total_received;
-  char* message;
-  
-  /* Receive message length */
-  bytes_read = recv(client->fd, &net_len, sizeof(net_len), 0);
-  /* Error occured*/
-  if (bytes_read < 0) {
-    print_error("recv");
-  } 
-  /* Connection closed */
-  else if (bytes_read == 0) {
-    return NULL;
-  }
-  
-  /* Convert message length to Little Endian */
-  message_len = ntohl(net_len);
-  
-  printf("SERVER: Received message length: %d\n", message_len);
-
-  /* Allocate memory for message */
-  message = (char*) malloc(message_len + 1);
-  if (!message)
-    print_error("malloc");
-  
-  /* Read all message */
-  while (total_received < message_len) {
-    bytes_read = recv(client->fd, message + total_received, message_len - total_received, 0);
-    if (bytes_read < 0) {
-      free(message);
-      print_error("recv");
+int start_relay(struct client* client) {
+  struct msgbuf* held;
+
+  if (!client->reactor->server->splice || client->decoder.left < SPLICE_CHUNK_SIZE)
+    return 0;
+
+  if (client->pipe[0] == -1) {
+    /* Without pipe message is streamed through decoder */
+    if (pipe2(client->pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+      log_warn("SERVER: Pipe of client %s not created, message is streamed: %s\n",
+               client->endpoint.text, strerror(errno));
+      return 0;
     }
-    total_received += bytes_read;
+
+    /* Larger pipe moves more per splice, default size is fine too */
+    fcntl(client->pipe[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
   }
-  
-  /* Terminate message */
-  message[message_len] = '\0';
-  
-  return message;
+
+  while (client->decoder.left > 0 && decoder_pending(&client->decoder) > 0) {
+    decoder_borrow(&client->decoder, 0, &held);
+    queue_reply(client, held);
+  }
+  client->relay_left = decoder_detach(&client->decoder);
+
+  return 1;
 }
 
 /*
- * edit_message - used to add prefix "Server" to message.
- * Allocates new buffer. Return buffer should be free manually.
- * @message - message from client that needs to be changed
- * 
- * Return: string with prefix
+ * relay_payload - used to move rest of long message from
+ * clients socket back to it through pipe by splice, so payload
+ * never enters user space. Queued replies (header, prefix and
+ * bytes decoder held) are sent first to keep order. Stalled
+ * relay is watched by read deadline.
+ * @client - pointer to an object of client struct
+ *
+ * Return: IO_DONE if payload was relayed, IO_AGAIN if socket
+ * would block, IO_CLOSED if connection closed or failed
  */
-char* edit_message(char* message) {
-  char* prefix = "Server";
-  char* new_message = (char*) malloc(strlen(message) + strlen(prefix) + 2);
-  if (!new_message)
-    print_error("malloc");
+enum io_status relay_payload(struct client* client) {
+  ssize_t bytes;
+
+  if (client->replies) {
+    if (send_message(client) == IO_CLOSED)
+      return IO_CLOSED;
+    if (client->replies) {
+      track_partial_frame(client);
+      return IO_AGAIN;
+    }
+  }
+
+  while (client->relay_left || client->piped) {
+    /* Pipe is drained into socket before it is filled again */
+    if (client->piped)
+      bytes = splice(client->pipe[0], NULL, client->fd, NULL, client->piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    else
+      bytes = splice(client->fd, NULL, client->pipe[1], NULL, client->relay_left, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (bytes == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        track_partial_frame(client);
+        return IO_AGAIN;
+      }
+      log_warn("SERVER: Relay of client %s failed: %s\n", client->endpoint.text, strerror(errno));
+      return IO_CLOSED;
+    }
+
+    /* Connection closed in the middle of message */
+    if (bytes == 0)
+      return IO_CLOSED;
+
+    if (client->piped) {
+      client->piped -= bytes;
+      metrics_add_bytes(METRIC_BYTES_OUT, &client->bytes_out, bytes);
+    } else {
+      client->relay_left -= bytes;
+      client->piped += bytes;
+      metrics_add_bytes(METRIC_BYTES_IN, &client->bytes_in, bytes);
+    }
+    client->active_at = client->reactor->now;
+    client->frame_at = 0;
+  }
 
-  /* Add prefix to message */
-  snprintf(new_message, strlen(message) + strlen(prefix) + 2, "%s %s", "Server", message);
+  /* Socket was read past last receive of decoder */
+  client->drained = 0;
 
-  return new_message;
+  return IO_DONE;
 }
 
 /*
@@ -274,29 +551,161 @@ char* edit_message(char* message) {
  */
 void shutdown_connection(struct client* client) {
   shutdown(client->fd, SHUT_RDWR);
-  delete_client(client->server, client);
+  close(client->fd);
+  delete_client(client->reactor, client);
+}
+
+/*
+ * reap_zerocopy - used when socket reports error to take
+ * zerocopy completions out of its error queue. Replies whose
+ * last send completed go back to pool (TCP completes sends
+ * in order). If kernel had to copy anyway (e.g. loopback),
+ * zerocopy is turned off for the client, it only costs more
+ * than plain send then.
+ * @client - pointer to an object of client struct
+ *
+ * Return: 0 if queue held only completions, -1 if socket failed
+ */
+int reap_zerocopy(struct client* client) {
+  char control[128];
+  struct msghdr msg;
+  struct cmsghdr* cmsg;
+  int error = 0;
+  socklen_t len = sizeof(error);
+
+  while (1) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(client->fd, &msg, MSG_ERRQUEUE) == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      struct sock_extended_err* err = (struct sock_extended_err*) CMSG_DATA(cmsg);
+
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+        continue;
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        return -1;
+
+      if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && client->zerocopy) {
+        log_debug("SERVER: Kernel copied zerocopy replies of client %s, copying from now on\n",
+                  client->endpoint.text);
+        client->zerocopy = 0;
+      }
+
+      /* Sends ee_info..ee_data completed */
+      while (client->zc_pending && (int32_t) (err->ee_data - client->zc_pending->zc_id) >= 0) {
+        struct reply* reply = client->zc_pending;
+
+        client->zc_pending = reply->next;
+        client->queued -= msgbuf_length(reply->message);
+        msgbuf_free(reply->message);
+        pool_free(reply);
+      }
+      if (!client->zc_pending)
+        client->zc_pending_tail = NULL;
+    }
+  }
+
+  /* Completions don't set error of socket */
+  if (getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1 || error)
+    return -1;
+
+  return 0;
 }
 
 /*
  * close_connection - used to close connection when client
- * called shutdown. Closes clients file descriptor and
- * frees memory allocated for client; 
+ * called shutdown. Closes clients file descriptor (which
+ * also removes it from epoll) and frees memory allocated
+ * for client. Connection with zerocopy replies in flight is
+ * reset, so kernel drops its references to their buffers.
+ * @client - pointer to an object of client struct
  */
 void close_connection(struct client* client) {
+  struct linger linger = {1, 0};
+
+  if (client->zc_pending)
+    setsockopt(client->fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+
   close(client->fd);
-  delete_client(client->server, client);
+  delete_client(client->reactor, client);
+}
+
+/*
+ * free_replies - used to free list of replies.
+ * @replies - pointer to first reply of the list
+ */
+void free_replies(struct reply* replies) {
+  while (replies) {
+    struct reply* reply = replies;
+    replies = reply->next;
+    msgbuf_free(reply->message);
+    pool_free(reply);
+  }
+}
+
+/*
+ * collect_client - used as callback of registry walk to
+ * copy client into table of admin socket.
+ * @item - pointer to an object of client struct
+ * @arg - pointer to an object of admin_table struct
+ */
+static void collect_client(void* item, void* arg) {
+  struct client* client = (struct client*) item;
+  struct admin_client* row = admin_table_add((struct admin_table*) arg);
+
+  snprintf(row->endpoint, sizeof(row->endpoint), "%s", client->endpoint.text);
+  row->bytes_in = __atomic_load_n(&client->bytes_in, __ATOMIC_RELAXED);
+  row->bytes_out = __atomic_load_n(&client->bytes_out, __ATOMIC_RELAXED);
+  row->connected_at = client->connected_at;
+}
+
+/*
+ * collect_clients - used by admin socket to copy clients
+ * table of all reactors. Registries are walked one by one,
+ * each is locked only while its clients are copied.
+ * @arg - pointer to an object of server struct
+ * @clients - pointer where allocated table is stored
+ *
+ * Return: amount of clients in table
+ */
+int collect_clients(void* arg, struct admin_client** clients) {
+  struct server* server = (struct server*) arg;
+  struct admin_table table = {NULL, 0, 0};
+
+  for (int i = 0; i < server->reactors_amount; i++)
+    registry_foreach(&server->reactors[i].clients, collect_client, &table);
+
+  *clients = table.rows;
+
+  return table.amount;
 }
 
 /*
- * free_server - free allocated memory for server 
+ * free_server - free allocated memory for server
  * @server - pointer to an object of server struct
  */
 void free_server(struct server* server) {
-  for (int i = 0; i < server->clients_amount; i++) {
-    shutdown_connection(server->clients[i]);
-    free(server->clients[i]->endpoint);
-    free(server->clients[i]);
-  }
-  free(server->clients);
+  struct pool_stats stats;
+
+  stop_admin(&server->admin);
+
+  pool_get_stats(&stats);
+  log_info("SERVER: Pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+
+  for (int i = 0; i < server->reactors_amount; i++)
+    free_reactor(&server->reactors[i]);
+
+  if (server->acceptor)
+    free_acceptor(server->acceptor);
+
+  free(server->reactors);
   free(server);
 }
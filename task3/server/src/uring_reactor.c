@@ -0,0 +1,426 @@
+#include "../headers/uring_reactor.h"
+#include "../headers/server.h"
+#include "../headers/prefork.h"
+#include <poll.h>
+
+/*
+ * run_uring_reactor - used to run event loop of the reactor
+ * on io_uring. Connections are accepted by single multishot
+ * accept, data is received by multishot receives into provided
+ * buffers and replies are sent by gathered sends, so all
+ * connections share one submission queue and every loop
+ * iteration costs one system call. Waiting ends on next
+ * tick with deadlines, like epoll_wait of epoll backend.
+ * @reactor - pointer to an object of reactor struct
+ */
+void run_uring_reactor(struct reactor* reactor) {
+  struct io_uring_cqe* cqe;
+
+  uring_init(&reactor->ring, URING_ENTRIES);
+  uring_init_buffers(&reactor->ring, &reactor->buffers, URING_BUFFERS, URING_BUFFER_SIZE, 0);
+
+  reactor->accept_op.type = OP_ACCEPT;
+  reactor->accept_op.client = NULL;
+  submit_accept(reactor);
+
+  while (1) {
+    int timeout = timer_wheel_timeout(&reactor->timers, reactor->now);
+
+    /* Submit prepared requests and wait for completion */
+    if (uring_submit_timeout(&reactor->ring, 1, timeout) == -1)
+      print_error("io_uring_enter");
+
+    reactor->now = metrics_now();
+
+    while ((cqe = uring_peek_cqe(&reactor->ring)) != NULL) {
+      handle_uring_completion(reactor, cqe);
+      uring_cqe_seen(&reactor->ring);
+    }
+
+    expire_clients(reactor);
+  }
+}
+
+/*
+ * handle_uring_completion - used to handle completion
+ * of accept, receive, send or cancel request.
+ * @reactor - pointer to an object of reactor struct
+ * @cqe - pointer to completion entry
+ */
+void handle_uring_completion(struct reactor* reactor, struct io_uring_cqe* cqe) {
+  struct uring_op* op = (struct uring_op*) (uintptr_t) cqe->user_data;
+  struct client* client = op->client;
+  int more = cqe->flags & IORING_CQE_F_MORE;
+
+  switch (op->type) {
+    case OP_ACCEPT:
+      /* Channel of prefork worker is readable */
+      if (reactor->server->channel != -1) {
+        if (cqe->res >= 0)
+          receive_handoffs(reactor);
+      } else if (cqe->res >= 0) {
+        struct sockaddr_storage client_addr;
+        socklen_t client_size = sizeof(client_addr);
+
+        getpeername(cqe->res, (struct sockaddr*) &client_addr, &client_size);
+        add_client(reactor, &client_addr, cqe->res);
+      } else if (cqe->res != -EINTR && cqe->res != -ECONNABORTED) {
+        log_error("SERVER: Accept failed: %s\n", strerror(-cqe->res));
+      }
+
+      /* Multishot accept was terminated */
+      if (!more)
+        submit_accept(reactor);
+      break;
+
+    case OP_RECV:
+      if (!more) {
+        client->inflight--;
+        client->receiving = 0;
+      }
+
+      if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+        unsigned short id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+        metrics_add_bytes(METRIC_BYTES_IN, &client->bytes_in, cqe->res);
+        client->active_at = reactor->now;
+        if (!client->closing)
+          consume_messages(client, uring_take_buffer(&reactor->buffers, id, cqe->res));
+        else
+          uring_recycle_buffer(&reactor->buffers, id);
+
+        if (!client->closing)
+          submit_replies(client);
+
+        /* Stop receiving until peer takes replies (and buffers they hold) */
+        if (!client->closing && !client->paused &&
+            (client->queued >= SEND_QUEUE_HIGH || client->pinned >= URING_CLIENT_BUFFERS))
+          pause_uring_client(client);
+      }
+
+      /* Client shut down its side, it still gets replies to its messages */
+      if (cqe->res == 0 && !client->closing && (client->sending || client->replies)) {
+        client->hangup = 1;
+      }
+      /* Connection closed or failed, cancel only pauses receiving */
+      else if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)) {
+        if (!client->closing)
+          log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+        close_uring_connection(client);
+      }
+      /* Multishot receive was terminated, out of buffers it waits for replies to free some */
+      else if (!more && !client->closing && !client->paused) {
+        if (cqe->res == -ENOBUFS)
+          wait_for_buffers(client);
+        else
+          submit_recv(client);
+      }
+      break;
+
+    case OP_SEND:
+      client->inflight--;
+      metrics_record(STAGE_SEND, client->sending_started);
+
+      /* Short send means connection failed */
+      if (cqe->res < 0 || (size_t) cqe->res < client->sending_len)
+        close_uring_connection(client);
+      else {
+        metrics_add_bytes(METRIC_BYTES_OUT, &client->bytes_out, cqe->res);
+        metrics_add(METRIC_MESSAGES_OUT, client->sending_count);
+        client->active_at = reactor->now;
+      }
+
+      client->queued -= client->sending_len;
+      free_replies(client->sending);
+      client->sending = NULL;
+
+      if (!client->closing) {
+        submit_replies(client);
+
+        /* Half-closed client got all its replies */
+        if (client->hangup && !client->sending) {
+          log_info("SERVER: Client %s disconnected\n", client->endpoint.text);
+          close_uring_connection(client);
+        } else if (client->paused && client->queued <= SEND_QUEUE_LOW &&
+                   client->pinned <= URING_CLIENT_BUFFERS / 4)
+          resume_uring_client(client);
+      }
+      break;
+
+    case OP_CANCEL:
+      client->inflight--;
+      break;
+  }
+
+  /* Free client after its last request completed */
+  if (client && client->closing && client->inflight == 0)
+    close_connection(client);
+}
+
+/*
+ * submit_accept - used to prepare multishot accept request
+ * on reactors passive socket. Prefork worker waits for its
+ * channel to become readable instead.
+ * @reactor - pointer to an object of reactor struct
+ */
+void submit_accept(struct reactor* reactor) {
+  struct io_uring_sqe* sqe = uring_get_sqe(&reactor->ring);
+
+  if (reactor->server->channel != -1) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = reactor->sfd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = (uint64_t) (uintptr_t) &reactor->accept_op;
+    return;
+  }
+
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = reactor->sfd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->user_data = (uint64_t) (uintptr_t) &reactor->accept_op;
+}
+
+/*
+ * submit_recv - used to prepare multishot receive request
+ * on clients socket. Kernel selects buffer from reactors
+ * provided buffers for every chunk of data.
+ * @client - pointer to an object of client struct
+ */
+void submit_recv(struct client* client) {
+  struct reactor* reactor = client->reactor;
+  struct io_uring_sqe* sqe = uring_get_sqe(&reactor->ring);
+
+  client->recv_op.type = OP_RECV;
+  client->recv_op.client = client;
+
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = client->fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = reactor->buffers.group;
+  sqe->user_data = (uint64_t) (uintptr_t) &client->recv_op;
+
+  client->inflight++;
+  client->receiving = 1;
+}
+
+/*
+ * wait_for_buffers - used when multishot receive of client
+ * ran out of provided buffers. Receive is submitted again
+ * at once if some buffers were released meanwhile, otherwise
+ * client waits in list until next buffer is released.
+ * @client - pointer to an object of client struct
+ */
+void wait_for_buffers(struct client* client) {
+  struct reactor* reactor = client->reactor;
+
+  if (reactor->pinned < reactor->buffers.entries) {
+    submit_recv(client);
+    return;
+  }
+
+  if (client->starved)
+    return;
+
+  client->starved = 1;
+  client->next_starved = reactor->starved;
+  reactor->starved = client;
+}
+
+/*
+ * forget_starved_client - used to remove client from list
+ * of clients waiting for provided buffers.
+ * @client - pointer to an object of client struct
+ */
+void forget_starved_client(struct client* client) {
+  struct client** link = &client->reactor->starved;
+
+  while (*link != client)
+    link = &(*link)->next_starved;
+
+  *link = client->next_starved;
+  client->starved = 0;
+}
+
+/*
+ * release_uring_block - used as release callback of block
+ * holding provided buffer. Buffer goes back to kernel once
+ * decoder and all replies dropped it, and first client
+ * waiting for buffers receives again.
+ * @block - pointer to an object of rxbuf struct
+ */
+void release_uring_block(struct rxbuf* block) {
+  struct client* client = (struct client*) block->owner;
+  struct reactor* reactor = client->reactor;
+
+  client->pinned--;
+  reactor->pinned--;
+  uring_recycle_buffer(&reactor->buffers, block->id);
+
+  while (reactor->starved) {
+    struct client* starved = reactor->starved;
+
+    forget_starved_client(starved);
+    if (!starved->closing && !starved->paused && !starved->receiving) {
+      submit_recv(starved);
+      break;
+    }
+  }
+}
+
+/*
+ * pause_uring_client - used to stop receiving from client
+ * whose queued replies reached SEND_QUEUE_HIGH. Multishot
+ * receive is cancelled, data it still delivers is consumed.
+ * @client - pointer to an object of client struct
+ */
+void pause_uring_client(struct client* client) {
+  struct reactor* reactor = client->reactor;
+
+  pause_client(client);
+  if (!client->receiving)
+    return;
+
+  client->cancel_op.type = OP_CANCEL;
+  client->cancel_op.client = client;
+
+  struct io_uring_sqe* sqe = uring_get_sqe(&reactor->ring);
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->addr = (uint64_t) (uintptr_t) &client->recv_op;
+  sqe->user_data = (uint64_t) (uintptr_t) &client->cancel_op;
+
+  client->inflight++;
+}
+
+/*
+ * resume_uring_client - used to start receiving from paused
+ * client again once its replies drained to SEND_QUEUE_LOW.
+ * If cancelled receive didn't complete yet, it is submitted
+ * again on its completion.
+ * @client - pointer to an object of client struct
+ */
+void resume_uring_client(struct client* client) {
+  resume_client(client);
+
+  if (!client->receiving)
+    submit_recv(client);
+}
+
+/*
+ * submit_replies - used to submit queued replies of the
+ * client (up to REPLIES_AMOUNT) as one gathered send request.
+ * Payload is sent straight from provided buffers it was
+ * received into, they are recycled when send completes.
+ * Next replies are submitted after previous send completed,
+ * which keeps them in order.
+ * @client - pointer to an object of client struct
+ */
+void submit_replies(struct client* client) {
+  struct reactor* reactor = client->reactor;
+  int replies = 0;
+  int count = 0;
+
+  /* Previous send is in flight or nothing to send */
+  if (client->sending || !client->replies)
+    return;
+
+  /* Allocate vector on first send, idle clients don't need it */
+  if (!client->iov) {
+    client->iov = (struct iovec*) malloc(REPLIES_AMOUNT * 2 * sizeof(struct iovec));
+    if (!client->iov)
+      print_error("malloc");
+  }
+
+  /* Move replies from queue to send request */
+  client->sending = client->replies;
+  client->sending_len = 0;
+  client->sending_count = 0;
+
+  struct reply* last = client->replies;
+  for (struct reply* reply = client->replies; reply && replies < REPLIES_AMOUNT; reply = reply->next) {
+    count += msgbuf_iov(reply->message, 0, client->iov + count);
+    client->sending_len += msgbuf_length(reply->message);
+    client->sending_count += !reply->message->continued;
+    replies++;
+    last = reply;
+  }
+
+  client->replies = last->next;
+  if (!client->replies)
+    client->replies_tail = NULL;
+  last->next = NULL;
+
+  memset(&client->msg, 0, sizeof(client->msg));
+  client->msg.msg_iov = client->iov;
+  client->msg.msg_iovlen = count;
+  client->sending_started = metrics_now();
+
+  client->send_op.type = OP_SEND;
+  client->send_op.client = client;
+
+  struct io_uring_sqe* sqe = uring_get_sqe(&reactor->ring);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = client->fd;
+  sqe->addr = (uint64_t) (uintptr_t) &client->msg;
+  sqe->len = 1;
+  sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+  sqe->user_data = (uint64_t) (uintptr_t) &client->send_op;
+
+  client->inflight++;
+}
+
+/*
+ * consume_messages - used to pass received provided buffer
+ * to clients decoder and take all messages out of it. Every
+ * message (or piece of long one) is edited and queued as
+ * reply pointing into the buffer, part of next one left in
+ * decoder starts read deadline.
+ * @client - pointer to an object of client struct
+ * @block - block of received provided buffer
+ */
+void consume_messages(struct client* client, struct rxbuf* block) {
+  struct msgbuf* message;
+  enum frame_status status;
+
+  block->owner = client;
+  block->release = release_uring_block;
+  client->pinned++;
+  client->reactor->pinned++;
+  decoder_append(&client->decoder, block);
+
+  while ((status = decoder_borrow(&client->decoder, REPLY_HEADROOM, &message)) == FRAME_OK) {
+    log_debug("SERVER: Received message length: %u\n", message->payload_len);
+    log_debug("SERVER: Received message from client %s: %.*s\n", client->endpoint.text,
+              (int) message->payload_len, message->payload);
+    metrics_add(METRIC_MESSAGES_IN, !message->continued);
+    client->frame_at = 0;
+
+    uint64_t start = metrics_now();
+    edit_message(message);
+    metrics_record(STAGE_TRANSFORM, start);
+    queue_reply(client, message);
+  }
+
+  if (status == FRAME_TOO_BIG) {
+    log_warn("SERVER: Client %s sent message longer than %u bytes\n",
+             client->endpoint.text, client->decoder.max_frame);
+    close_uring_connection(client);
+    return;
+  }
+
+  track_partial_frame(client);
+}
+
+/*
+ * close_uring_connection - used to start closing of the
+ * connection. Shutdown terminates requests in flight, client
+ * is freed when last of them completes.
+ * @client - pointer to an object of client struct
+ */
+void close_uring_connection(struct client* client) {
+  if (client->closing)
+    return;
+
+  client->closing = 1;
+  shutdown(client->fd, SHUT_RDWR);
+}
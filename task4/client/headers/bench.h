@@ -0,0 +1,119 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "client.h"
+#include "../../common/headers/histogram.h"
+#include "../../common/headers/rudp.h"
+
+#define BENCH_TIMEOUT_MS 1000
+
+/* Sequence number and send time stamped at start of every payload */
+#define PROBE_SEQ_OFFSET 0
+#define PROBE_TIME_OFFSET sizeof(uint32_t)
+#define PROBE_HEADER_LEN (sizeof(uint32_t) + sizeof(uint64_t))
+
+/**
+ * Used as parameters of windowed load generation:
+ * every socket keeps up to window datagrams in flight,
+ * sends next one whenever response arrives or oldest
+ * datagram is not answered in timeout, until it has
+ * sent its messages. Sizes of messages are uniformly
+ * distributed in range min_size..max_size.
+ */
+struct bench {
+  /* Amount of sockets (one thread each) */
+  int connections;
+
+  /* Amount of messages sent by every socket */
+  int messages;
+
+  /* Amount of datagrams in flight on every socket */
+  int window;
+
+  /* Time datagram waits for response before it is lost */
+  int timeout_ms;
+
+  /* Datagrams are exchanged reliably (rudp) and probability of
+     sent datagram being dropped */
+  int reliable;
+  double loss;
+
+  /* Range of message sizes in bytes */
+  uint32_t min_size;
+  uint32_t max_size;
+
+  /* Print results as one comma separated row */
+  int csv;
+};
+
+/**
+ * Used as state of one socket of load generator.
+ * Counters and histogram are private to its thread and
+ * merged once all threads finish.
+ */
+struct bench_worker {
+  struct bench* bench;
+
+  /* Socket connected to the server */
+  struct client* client;
+
+  pthread_t thread;
+
+  /* Barrier that starts all sockets at once */
+  pthread_barrier_t* start;
+
+  /* Seed of message sizes */
+  unsigned int seed;
+
+  /* Send time of every message (indexed by sequence number),
+     0 once it is answered or lost */
+  uint64_t* sent_at;
+
+  /* Oldest message that may still be in flight and amount
+     of messages in flight */
+  uint32_t oldest;
+  int inflight;
+
+  /* Reliable mode: exchange with server and loss injected
+     into sent datagrams */
+  struct rudp_peer* peer;
+  struct rudp_loss loss;
+
+  /* Reliable mode: retransmissions on timeout and by fast
+     retransmit, smoothed round trip time */
+  unsigned long timeouts;
+  unsigned long fast_retransmits;
+  uint64_t srtt;
+
+  /* Sent, answered and lost messages, responses that came
+     after timeout of their message, sent payload bytes */
+  unsigned long sent;
+  unsigned long received;
+  unsigned long lost;
+  unsigned long late;
+  uint64_t bytes;
+
+  /* Time last message was answered or lost */
+  uint64_t finished_at;
+
+  /* Round trip times of answered messages in nanoseconds */
+  struct histogram histogram;
+};
+
+void run_bench(struct bench* bench);
+
+void* run_worker(void* arg);
+
+void close_probes(struct bench_worker* worker, char* buffer);
+
+void send_probes(struct bench_worker* worker, char* payload);
+
+void recv_probes(struct bench_worker* worker, char* buffer);
+
+void expire_probes(struct bench_worker* worker, uint64_t now);
+
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed);
+
+uint64_t now_ns(void);
+
+#endif // !BENCH_H
@@ -2,6 +2,8 @@
 #define CLIENT_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/pool.h"
 
 /*
  * Used as client for connection to inet address
@@ -13,9 +15,14 @@ struct client {
   
   /* Server file descriptor*/
   int sfd;
+
+  /* Time in milliseconds response is waited for */
+  int timeout_ms;
 };
 
-struct client* create_client(const char* ip, const int port);
+struct client* create_client(const char* ip, const int port, int timeout_ms);
+
+void connect_client(struct client* client);
 
 void run_client(struct client* client);
 
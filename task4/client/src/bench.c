@@ -0,0 +1,404 @@
+#include "../headers/bench.h"
+#include <poll.h>
+#include <time.h>
+
+/*
+ * run_bench - used to run windowed load generation.
+ * Connects all sockets, starts them at once, waits
+ * until every socket has sent its messages and
+ * prints report.
+ * @bench - pointer to an object of bench struct
+ */
+void run_bench(struct bench* bench) {
+  struct bench_worker* workers = (struct bench_worker*) calloc(bench->connections, sizeof(struct bench_worker));
+  pthread_barrier_t start;
+  uint64_t started;
+  uint64_t finished = 0;
+
+  if (!workers)
+    print_error("calloc");
+
+  if (pthread_barrier_init(&start, NULL, bench->connections + 1) != 0)
+    print_error("pthread_barrier_init");
+
+  for (int i = 0; i < bench->connections; i++) {
+    struct bench_worker* worker = &workers[i];
+
+    worker->bench = bench;
+    worker->start = &start;
+    worker->seed = time(NULL) + i;
+    worker->client = create_client(SERVER_IP, SERVER_PORT, bench->timeout_ms);
+    init_histogram(&worker->histogram);
+
+    if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0)
+      print_error("pthread_create");
+  }
+
+  /* Start measuring once all sockets are ready */
+  pthread_barrier_wait(&start);
+  started = now_ns();
+
+  /* Closing of reliable sessions is not measured */
+  for (int i = 0; i < bench->connections; i++) {
+    pthread_join(workers[i].thread, NULL);
+    if (workers[i].finished_at > finished)
+      finished = workers[i].finished_at;
+  }
+
+  report_bench(bench, workers, finished - started);
+
+  for (int i = 0; i < bench->connections; i++) {
+    close_connection(workers[i].client);
+    free_client(workers[i].client);
+  }
+
+  pthread_barrier_destroy(&start);
+  free(workers);
+}
+
+/*
+ * run_worker - used in thread to drive one socket.
+ * Keeps window of messages of random sizes in flight and
+ * waits for responses until oldest message times out.
+ * Responses are matched to messages by sequence number,
+ * so they may come in any order. In reliable mode window is
+ * also window of rudp exchange with server, lost datagrams
+ * are retransmitted.
+ * @arg - pointer to an object of bench_worker struct
+ */
+void* run_worker(void* arg) {
+  struct bench_worker* worker = (struct bench_worker*) arg;
+  struct bench* bench = worker->bench;
+  struct client* client = worker->client;
+  uint64_t timeout = (uint64_t) bench->timeout_ms * 1000000;
+  char payload[BUFFER_SIZE];
+  char buffer[RUDP_DATAGRAM_SIZE];
+  struct pollfd pfd = {client->sfd, POLLIN, 0};
+
+  memset(payload, 'x', sizeof(payload));
+
+  worker->sent_at = (uint64_t*) calloc(bench->messages, sizeof(uint64_t));
+  if (!worker->sent_at)
+    print_error("calloc");
+
+  connect_client(client);
+
+  if (bench->reliable) {
+    worker->peer = (struct rudp_peer*) malloc(sizeof(struct rudp_peer));
+    if (!worker->peer)
+      print_error("malloc");
+
+    worker->loss.rate = bench->loss;
+    worker->loss.seed = worker->seed ^ getpid();
+    init_rudp_peer(worker->peer, client->sfd, &client->serv, rand_r(&worker->seed) ^ ((uint32_t) getpid() << 16),
+                   bench->window, &worker->loss);
+  }
+
+  pthread_barrier_wait(worker->start);
+
+  while (worker->sent < (unsigned long) bench->messages || worker->inflight > 0) {
+    send_probes(worker, payload);
+    if (worker->peer)
+      rudp_flush_ack(worker->peer);
+
+    /* Sleep until response, retransmission or timeout of oldest message */
+    uint64_t deadline = worker->sent_at[worker->oldest] + timeout;
+    uint64_t now = now_ns();
+
+    if (worker->peer && worker->peer->deadline < deadline)
+      deadline = worker->peer->deadline;
+    int wait = deadline > now ? (deadline - now + 999999) / 1000000 : 0;
+
+    if (poll(&pfd, 1, wait) == -1 && errno != EINTR)
+      print_error("poll");
+
+    recv_probes(worker, buffer);
+    now = now_ns();
+    expire_probes(worker, now);
+
+    if (worker->peer && rudp_expire(worker->peer, now) == -1) {
+      log_error("CLIENT: Server stopped acknowledging datagrams\n");
+      worker->lost += worker->inflight;
+      break;
+    }
+  }
+
+  worker->finished_at = now_ns();
+
+  if (worker->peer) {
+    close_probes(worker, buffer);
+    worker->timeouts = worker->peer->timeouts;
+    worker->fast_retransmits = worker->peer->fast_retransmits;
+    worker->srtt = worker->peer->srtt;
+    free(worker->peer);
+    worker->peer = NULL;
+  }
+
+  free(worker->sent_at);
+  worker->sent_at = NULL;
+
+  return NULL;
+}
+
+/*
+ * close_probes - used to end reliable session. RUDP_FIN
+ * is retransmitted until server acknowledges it, so server
+ * gets acknowledgement of last responses and does not
+ * retransmit them to closed socket. Responses retransmitted
+ * meanwhile are acknowledged as before.
+ * @worker - pointer to an object of bench_worker struct
+ * @buffer - buffer for response
+ */
+void close_probes(struct bench_worker* worker, char* buffer) {
+  struct rudp_peer* peer = worker->peer;
+  struct pollfd pfd = {worker->client->sfd, POLLIN, 0};
+  uint64_t now = now_ns();
+  int closing = 0;
+
+  while (!closing || peer->base != peer->next) {
+    /* Window may be full of requests server did not acknowledge */
+    if (!closing)
+      closing = rudp_close(peer, now) == 0;
+    rudp_flush_ack(peer);
+
+    int wait = peer->deadline > now ? (peer->deadline - now + 999999) / 1000000 : 0;
+
+    if (poll(&pfd, 1, wait) == -1 && errno != EINTR)
+      print_error("poll");
+
+    recv_probes(worker, buffer);
+    now = now_ns();
+
+    if (rudp_expire(peer, now) == -1) {
+      log_debug("CLIENT: Server did not acknowledge end of session\n");
+      break;
+    }
+  }
+}
+
+/*
+ * send_probes - used to fill window of the socket. Every
+ * message starts with its sequence number and send time,
+ * server echoes them back behind prefix. In reliable mode
+ * filling stops early if rudp window is full.
+ * @worker - pointer to an object of bench_worker struct
+ * @payload - buffer of message payload
+ */
+void send_probes(struct bench_worker* worker, char* payload) {
+  struct bench* bench = worker->bench;
+  uint32_t range = bench->max_size - bench->min_size + 1;
+
+  while (worker->inflight < bench->window && worker->sent < (unsigned long) bench->messages) {
+    uint32_t size = bench->min_size + rand_r(&worker->seed) % range;
+    uint32_t seq = worker->sent;
+    uint64_t now = now_ns();
+
+    memcpy(payload + PROBE_SEQ_OFFSET, &seq, sizeof(seq));
+    memcpy(payload + PROBE_TIME_OFFSET, &now, sizeof(now));
+
+    if (worker->peer) {
+      struct iovec iov = {payload, size};
+
+      if (rudp_send(worker->peer, &iov, 1, now) == -1)
+        return;
+    } else if (send(worker->client->sfd, payload, size, 0) == -1) {
+      /* Refused message is not answered and times out */
+      if (errno == EINTR)
+        continue;
+      if (errno != ECONNREFUSED)
+        print_error("send");
+    }
+
+    worker->sent_at[seq] = now;
+    worker->sent++;
+    worker->inflight++;
+    worker->bytes += size;
+  }
+}
+
+/*
+ * recv_probes - used to take all responses queued in the
+ * socket without blocking. Round trip time is measured
+ * from send time echoed in response. Responses to messages
+ * that were already lost are counted as late. In reliable
+ * mode responses are taken from delivered datagrams only.
+ * @worker - pointer to an object of bench_worker struct
+ * @buffer - buffer for response
+ */
+void recv_probes(struct bench_worker* worker, char* buffer) {
+  ssize_t bytes_read;
+  char* reply;
+  size_t reply_len;
+  uint32_t seq;
+  uint64_t stamp;
+
+  while (1) {
+    bytes_read = recv(worker->client->sfd, buffer, RUDP_DATAGRAM_SIZE, MSG_DONTWAIT);
+    if (bytes_read == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      if (errno == ECONNREFUSED)
+        continue;
+      print_error("recv");
+    }
+
+    reply = buffer;
+    reply_len = bytes_read;
+    if (worker->peer && rudp_input(worker->peer, buffer, bytes_read, now_ns(), &reply, &reply_len) != 1)
+      continue;
+
+    if (reply_len < PREFIX_LEN + PROBE_HEADER_LEN)
+      continue;
+
+    memcpy(&seq, reply + PREFIX_LEN + PROBE_SEQ_OFFSET, sizeof(seq));
+    memcpy(&stamp, reply + PREFIX_LEN + PROBE_TIME_OFFSET, sizeof(stamp));
+    if (seq >= worker->sent)
+      continue;
+
+    if (worker->sent_at[seq] == 0) {
+      worker->late++;
+      continue;
+    }
+
+    worker->sent_at[seq] = 0;
+    worker->inflight--;
+    worker->received++;
+    histogram_record(&worker->histogram, now_ns() - stamp);
+  }
+}
+
+/*
+ * expire_probes - used to count messages that were not
+ * answered in timeout as lost. Messages time out in order
+ * they were sent, so only oldest ones are checked.
+ * @worker - pointer to an object of bench_worker struct
+ * @now - current time in nanoseconds
+ */
+void expire_probes(struct bench_worker* worker, uint64_t now) {
+  uint64_t timeout = (uint64_t) worker->bench->timeout_ms * 1000000;
+
+  while (worker->oldest < worker->sent) {
+    uint64_t sent_at = worker->sent_at[worker->oldest];
+
+    if (sent_at != 0) {
+      if (sent_at + timeout > now)
+        return;
+
+      worker->sent_at[worker->oldest] = 0;
+      worker->inflight--;
+      worker->lost++;
+    }
+
+    worker->oldest++;
+  }
+}
+
+/*
+ * print_rtt_histogram - used to print distribution of round
+ * trip times, one line per power of two range.
+ * @histogram - pointer to an object of histogram struct
+ */
+static void print_rtt_histogram(const struct histogram* histogram) {
+  uint64_t groups[HISTOGRAM_BUCKETS / HISTOGRAM_SUB_BUCKETS] = {0};
+  uint64_t largest = 0;
+
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    groups[i >> HISTOGRAM_SUB_BITS] += histogram->counts[i];
+
+  for (int i = 0; i < HISTOGRAM_BUCKETS / HISTOGRAM_SUB_BUCKETS; i++) {
+    if (groups[i] > largest)
+      largest = groups[i];
+  }
+
+  for (int i = 0; i < HISTOGRAM_BUCKETS / HISTOGRAM_SUB_BUCKETS; i++) {
+    if (groups[i] == 0)
+      continue;
+
+    /* First range holds values below HISTOGRAM_SUB_BUCKETS */
+    uint64_t low = i == 0 ? 0 : 1ULL << (i + HISTOGRAM_SUB_BITS - 1);
+    uint64_t high = 1ULL << (i + HISTOGRAM_SUB_BITS);
+    int width = groups[i] * 40 / largest;
+
+    printf("BENCH: rtt %10.1f - %10.1f us %10lu %.*s\n", low / 1e3, high / 1e3,
+           (unsigned long) groups[i], width > 0 ? width : 1, "########################################");
+  }
+}
+
+/*
+ * report_bench - used to merge results of all connections
+ * and print throughput, loss rate and round trip time
+ * percentiles and distribution, as text or as one comma
+ * separated row.
+ * @bench - pointer to an object of bench struct
+ * @workers - array of finished workers
+ * @elapsed - duration of load in nanoseconds
+ */
+void report_bench(struct bench* bench, struct bench_worker* workers, uint64_t elapsed) {
+  struct histogram histogram;
+  struct pool_stats stats;
+  unsigned long sent = 0, received = 0;
+  uint64_t bytes = 0;
+  unsigned long lost = 0, late = 0;
+  unsigned long timeouts = 0, fast_retransmits = 0, dropped = 0;
+  uint64_t srtt = 0;
+  double seconds = elapsed / 1e9;
+
+  init_histogram(&histogram);
+  for (int i = 0; i < bench->connections; i++) {
+    histogram_merge(&histogram, &workers[i].histogram);
+    sent += workers[i].sent;
+    received += workers[i].received;
+    bytes += workers[i].bytes;
+    lost += workers[i].lost;
+    late += workers[i].late;
+    timeouts += workers[i].timeouts;
+    fast_retransmits += workers[i].fast_retransmits;
+    dropped += workers[i].loss.dropped;
+    srtt += workers[i].srtt;
+  }
+
+  /* One row of results table */
+  if (bench->csv) {
+    printf("%d,%d,%u,%u,%d,%lu,%lu,%lu,%.3f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+           bench->connections, bench->messages, bench->min_size, bench->max_size, bench->window,
+           sent, received, lost, seconds, received / seconds, bytes / seconds / 1e6,
+           histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+           histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+    return;
+  }
+
+  printf("BENCH: %d sockets, %d messages each, %u-%u bytes, window %d, timeout %d ms\n",
+         bench->connections, bench->messages, bench->min_size, bench->max_size,
+         bench->window, bench->timeout_ms);
+  printf("BENCH: %lu sent, %lu received in %.3f s, %lu lost (%.2f%%), %lu late\n",
+         sent, received, seconds, lost, sent > 0 ? lost * 100.0 / sent : 0, late);
+  printf("BENCH: throughput %.0f msg/s, %.2f MB/s\n", received / seconds, bytes / seconds / 1e6);
+  printf("BENCH: latency us: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+         histogram_percentile(&histogram, 50) / 1e3, histogram_percentile(&histogram, 99) / 1e3,
+         histogram_percentile(&histogram, 99.9) / 1e3, histogram.max / 1e3);
+  print_rtt_histogram(&histogram);
+
+  if (bench->reliable) {
+    printf("BENCH: reliable: %lu retransmits on timeout, %lu fast retransmits, "
+           "%lu datagrams dropped by injected loss (%.1f%%), mean srtt %.1f us\n",
+           timeouts, fast_retransmits, dropped, bench->loss * 100, srtt / bench->connections / 1e3);
+  }
+
+  pool_get_stats(&stats);
+  printf("BENCH: pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+}
+
+/*
+ * now_ns - used to read monotonic clock.
+ *
+ * Return: current time in nanoseconds
+ */
+uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
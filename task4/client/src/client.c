@@ -7,9 +7,10 @@
  * client struct. 
  * @ip - ip address of the server
  * @port - port of the server
+ * @timeout_ms - time in milliseconds response is waited for
  * Return: pointer to an object of client struct
  */
-struct client* create_client(const char* ip, const int port) {
+struct client* create_client(const char* ip, const int port, int timeout_ms) {
   struct client* client = (struct client*) malloc(sizeof(struct client));
   if (!client)
     print_error("malloc");
@@ -19,6 +20,7 @@ struct client* create_client(const char* ip, const int port) {
   client->serv.sin_addr.s_addr = inet_addr(ip);
   client->serv.sin_port = htons(port);
 
+  client->timeout_ms = timeout_ms;
   client->sfd = socket(AF_INET, SOCK_DGRAM, 0);
   if (client->sfd == -1)
     print_error("socket");
@@ -26,15 +28,30 @@ struct client* create_client(const char* ip, const int port) {
   return client;
 }
 
-/* run_client - used to connect serv address
+/*
+ * connect_client - used to connect server address
  * to file descriptor client->sfd
  * @client - pointer to an object of client struct
  */
-void run_client(struct client* client) {
+void connect_client(struct client* client) {
   socklen_t server_len = sizeof(client->serv);   
    
   if (connect(client->sfd, (struct sockaddr*) &client->serv, server_len) == -1)
     print_error("connect");
+}
+
+/* run_client - used to connect serv address
+ * to file descriptor client->sfd
+ * @client - pointer to an object of client struct
+ */
+void run_client(struct client* client) {
+  struct timeval timeout = {client->timeout_ms / 1000, client->timeout_ms % 1000 * 1000};
+
+  connect_client(client);
+
+  /* Lost datagram must not block client forever */
+  if (setsockopt(client->sfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1)
+    print_error("setsockopt");
 
   /* Process user input */
   process_input(client);
@@ -43,7 +60,9 @@ void run_client(struct client* client) {
 /*
  * process_input - used to receive user input
  * from stdin. Terminates received string, calls
- * send_message and waits for server response.
+ * send_message and waits for server response until
+ * timeout. Responses that came after their timeout
+ * are dropped before next message is sent.
  * @client - pointer to an object of client struct
  */
 void process_input(struct client* client) {
@@ -51,6 +70,7 @@ void process_input(struct client* client) {
   
   /* Wait for user input */
   while (1) {
+    log_flush();
     printf("Enter message: ");
     
     /* Read user input */
@@ -58,21 +78,28 @@ void process_input(struct client* client) {
       print_error("fgets");
     buffer[strlen(buffer) - 1] = '\0';
 
+    /* Drop late responses to previous messages */
+    while (recv(client->sfd, buffer, sizeof(buffer), MSG_DONTWAIT) >= 0)
+      ;
+
     /* Send user message */
     send_message(client, buffer);
 
     /* Receive answer */
     char* message = recv_message(client);
     if (message == NULL) {
-      close_connection(client);
-      break;
+      log_warn("CLIENT: No response from %s:%d in %d ms\n",
+               inet_ntoa(client->serv.sin_addr),
+               ntohs(client->serv.sin_port),
+               client->timeout_ms);
+      continue;
     }
 
-    printf("SERVER: Server %s:%d send response: %s\n", 
-           inet_ntoa(client->serv.sin_addr), 
-           ntohs(client->serv.sin_port), 
-           message);
-    free(message);
+    log_info("SERVER: Server %s:%d send response: %s\n", 
+             inet_ntoa(client->serv.sin_addr), 
+             ntohs(client->serv.sin_port), 
+             message);
+    pool_free(message);
   }
 }
 
@@ -90,32 +117,34 @@ void send_message(struct client* client, char buffer[BUFFER_SIZE]) {
   if (bytes_send == -1)
     print_error("sendto");
 
-  printf("CLIENT: Send message to %s:%d: %s\n", 
-         inet_ntoa(client->serv.sin_addr), 
-         ntohs(client->serv.sin_port), 
-         buffer);
+  log_debug("CLIENT: Send message to %s:%d: %s\n", 
+            inet_ntoa(client->serv.sin_addr), 
+            ntohs(client->serv.sin_port), 
+            buffer);
 }
 
 /*
  * recv_message - used to receive message from server.
- * Allocates memory for buffer which should be freed manually.
+ * Allocates buffer from pool which should be freed by pool_free.
  *
- * Return: string (message) if successful, NULL if connection terminated
+ * Return: string (message) if successful, NULL if no response came in timeout
  */
 char* recv_message(struct client* client) {
   ssize_t bytes_read;
-  char* buffer = (char*) malloc(BUFFER_SIZE * sizeof(char));
+  char* buffer = (char*) pool_alloc(BUFFER_SIZE * sizeof(char));
   
   /* Receive message from server */ 
-  bytes_read = recv(client->sfd, buffer, BUFFER_SIZE, 0);
-  
-  /* Truncate message*/
-  buffer[bytes_read] = '\0';
+  bytes_read = recv(client->sfd, buffer, BUFFER_SIZE - 1, 0);
 
-  if (bytes_read == -1)
+  if (bytes_read == -1) {
+    pool_free(buffer);
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return NULL;
     print_error("recvfrom");
-  else if (bytes_read == 0)
-    return NULL;
+  }
+
+  /* Truncate message*/
+  buffer[bytes_read] = '\0';
 
   return buffer;
 }
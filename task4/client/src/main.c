@@ -1,11 +1,103 @@
 #include "../headers/client.h"
+#include "../headers/bench.h"
 
 struct client* client;
 
 void cleanup();
 
-int main(void) {
-  client = create_client(SERVER_IP, SERVER_PORT);
+/*
+ * Usage: client [-w window] [-t timeout] [-r] [-l loss] [-n sockets] [-m messages] [-s size[:max_size]] [-c]
+ * -w - amount of datagrams in flight on every
+ *      socket (1 by default)
+ * -t - time in milliseconds datagram waits for
+ *      response before it is lost (BENCH_TIMEOUT_MS
+ *      by default), also used by interactive client
+ * -r - load generator exchanges datagrams reliably:
+ *      sequence numbers, selective ACKs and
+ *      retransmissions, window up to RUDP_WINDOW_MAX / 2
+ *      (server -r)
+ * -l - percent of datagrams dropped before send in
+ *      reliable mode, to test retransmissions
+ * -n - run load generator with given amount of
+ *      sockets instead of reading stdin
+ * -m - amount of messages sent by every socket
+ * -s - size of messages in bytes, or range of
+ *      uniformly distributed sizes, at least
+ *      PROBE_HEADER_LEN
+ * -c - print results of load generator as one
+ *      comma separated row
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  struct bench bench = {0, 10000, 1, BENCH_TIMEOUT_MS, 0, 0, 64, 64, 0};
+  int opt;
+
+  while ((opt = getopt(argc, argv, "w:t:rl:n:m:s:c")) != -1) {
+    switch (opt) {
+      case 'w':
+        bench.window = atoi(optarg);
+        break;
+      case 't':
+        bench.timeout_ms = atoi(optarg);
+        break;
+      case 'r':
+        bench.reliable = 1;
+        break;
+      case 'l':
+        bench.loss = atof(optarg) / 100;
+        break;
+      case 'n':
+        bench.connections = atoi(optarg);
+        break;
+      case 'm':
+        bench.messages = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%u:%u", &bench.min_size, &bench.max_size) == 1)
+          bench.max_size = bench.min_size;
+        break;
+      case 'c':
+        bench.csv = 1;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-w window] [-t timeout] [-r] [-l loss] [-n sockets] [-m messages] "
+                "[-s size[:max_size]] [-c]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  if (bench.window < 1 || bench.timeout_ms < 1) {
+    fprintf(stderr, "Window and timeout must be positive\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Server keeps replies in window twice as large, so reply
+     waiting for retransmission doesn't stop it taking requests */
+  if (bench.reliable && bench.window > RUDP_WINDOW_MAX / 2) {
+    fprintf(stderr, "Window of reliable mode must be in range 1..%d\n", RUDP_WINDOW_MAX / 2);
+    exit(EXIT_FAILURE);
+  }
+
+  if (bench.loss < 0 || bench.loss >= 1) {
+    fprintf(stderr, "Loss must be in range 0..100 percent\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Run load generator */
+  if (bench.connections > 0) {
+    if (bench.min_size < PROBE_HEADER_LEN || bench.min_size > bench.max_size || bench.max_size > BUFFER_SIZE - 1) {
+      fprintf(stderr, "Size must be in range %lu..%d\n", PROBE_HEADER_LEN, BUFFER_SIZE - 1);
+      exit(EXIT_FAILURE);
+    }
+
+    run_bench(&bench);
+    exit(EXIT_SUCCESS);
+  }
+
+  client = create_client(SERVER_IP, SERVER_PORT, bench.timeout_ms);
   atexit(cleanup);
   run_client(client);
   exit(EXIT_SUCCESS);
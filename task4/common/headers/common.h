@@ -11,11 +11,17 @@
 #include <stdint.h>
 #include <netinet/in.h>
 #include <string.h>
+#include <errno.h>
 
 #define CLIENTS_AMOUNT 5
 #define BUFFER_SIZE 128
+#define BATCH_SIZE 64
+#define CACHE_LINE_SIZE 64
+#define PREFIX "Server "
+#define PREFIX_LEN (sizeof(PREFIX) - 1)
 #define SERVER_IP "127.0.0.1" 
 #define SERVER_PORT 8080
+#define ADMIN_SOCK_PATH "./admin_sock"
 #define print_error(msg) do {perror(msg); \
   exit(EXIT_FAILURE);} while(0)
 
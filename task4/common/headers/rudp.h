@@ -0,0 +1,159 @@
+#ifndef RUDP_H
+#define RUDP_H
+
+#include "common.h"
+#include <sys/uio.h>
+
+#define RUDP_MAGIC 0x5255
+#define RUDP_DATA 0x01
+#define RUDP_FIN 0x02
+#define RUDP_HEADER_LEN sizeof(struct rudp_header)
+
+/* Datagram carries header, prefix and payload of BUFFER_SIZE - 1 bytes */
+#define RUDP_DATAGRAM_SIZE (RUDP_HEADER_LEN + PREFIX_LEN + BUFFER_SIZE)
+
+/* Max amount of datagrams in flight, selective ACK covers all of them */
+#define RUDP_WINDOW_MAX 64
+
+/* Retransmission timeout bounds and its value before first sample */
+#define RUDP_MIN_RTO_NS (2 * 1000000ULL)
+#define RUDP_MAX_RTO_NS (500 * 1000000ULL)
+#define RUDP_INITIAL_RTO_NS (100 * 1000000ULL)
+
+/* Datagram is retransmitted once later ones are acknowledged */
+#define RUDP_DUP_THRESH 3
+
+/* Peer is given up after so many sends of one datagram */
+#define RUDP_MAX_TRIES 16
+
+/**
+ * Used as header of every datagram of reliable mode.
+ * Every datagram acknowledges what its sender received:
+ * all sequence numbers below ack, and ack + 1 + i for
+ * every bit i set in sack. Fields are in network order.
+ */
+struct rudp_header {
+  uint16_t magic;
+
+  /* RUDP_DATA if seq and payload are present, pure ACK otherwise,
+     RUDP_FIN with RUDP_DATA ends exchange and has no payload */
+  uint8_t flags;
+  uint8_t reserved;
+
+  /* Random id chosen by client, new id resets peer state */
+  uint32_t session;
+
+  uint32_t seq;
+  uint32_t ack;
+  uint64_t sack;
+} __attribute__((packed));
+
+/**
+ * Used as loss injected into sent datagrams, so
+ * retransmission can be tested on loopback.
+ */
+struct rudp_loss {
+  /* Probability of datagram being dropped (0 - 1) */
+  double rate;
+
+  unsigned int seed;
+
+  /* Amount of dropped datagrams */
+  unsigned long dropped;
+};
+
+/**
+ * Used as sent datagram kept until it is acknowledged.
+ */
+struct rudp_slot {
+  /* Datagram is waiting for acknowledgement */
+  int used;
+
+  /* Amount of sends and datagram was already sent by fast retransmit */
+  int tries;
+  int fast;
+
+  /* Time of first send and time of next retransmission */
+  uint64_t sent_at;
+  uint64_t deadline;
+
+  uint32_t len;
+  char data[RUDP_DATAGRAM_SIZE];
+};
+
+/**
+ * Used as state of reliable exchange with one peer. Sent
+ * datagrams wait in slots until peer acknowledges them and
+ * are retransmitted on timeout or once RUDP_DUP_THRESH later
+ * datagrams are acknowledged. Received datagrams are
+ * delivered once, in order they came.
+ */
+struct rudp_peer {
+  /* Address of the peer and socket to reach it */
+  struct sockaddr_in addr;
+  int sfd;
+
+  uint32_t session;
+
+  /* Oldest unacknowledged and next sequence numbers, amount of
+     datagrams allowed in flight */
+  uint32_t base;
+  uint32_t next;
+  int window;
+  struct rudp_slot slots[RUDP_WINDOW_MAX];
+
+  /* Smoothed round trip time, its variation and retransmission
+     timeout in nanoseconds */
+  uint64_t srtt;
+  uint64_t rttvar;
+  uint64_t rto;
+
+  /* Nearest retransmission (may be early), UINT64_MAX if none */
+  uint64_t deadline;
+
+  /* All sequence numbers below ack were received, bit i of
+     received stands for ack + 1 + i */
+  uint32_t ack;
+  uint64_t received;
+
+  /* Received datagram was not acknowledged yet */
+  int ack_pending;
+
+  /* Every delivered payload is answered, so payload is not taken
+     (nor acknowledged) while window is full */
+  int answers;
+
+  /* Peer ended exchange by RUDP_FIN */
+  int closed;
+
+  /* Loss injected into datagrams sent to peer */
+  struct rudp_loss* loss;
+
+  /* Datagrams retransmitted on timeout and by fast retransmit */
+  unsigned long timeouts;
+  unsigned long fast_retransmits;
+
+  /* Time datagram was last received from peer */
+  uint64_t active_at;
+
+  /* Next peer in bucket of servers peers table */
+  struct rudp_peer* next_peer;
+};
+
+void init_rudp_peer(struct rudp_peer* peer, int sfd, const struct sockaddr_in* addr,
+                    uint32_t session, int window, struct rudp_loss* loss);
+
+int rudp_send(struct rudp_peer* peer, const struct iovec* iov, int iovcnt, uint64_t now);
+
+int rudp_close(struct rudp_peer* peer, uint64_t now);
+
+int rudp_input(struct rudp_peer* peer, char* datagram, size_t len, uint64_t now,
+               char** payload, size_t* payload_len);
+
+void rudp_flush_ack(struct rudp_peer* peer);
+
+int rudp_expire(struct rudp_peer* peer, uint64_t now);
+
+int rudp_parse(const char* datagram, size_t len, struct rudp_header* header);
+
+#endif // !RUDP_H
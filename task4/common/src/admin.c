@@ -0,0 +1,316 @@
+#include "../headers/admin.h"
+
+/*
+ * write_json_string - used to write string as JSON value.
+ * @out - stream of admin connection
+ * @string - string that needs to be written
+ */
+static void write_json_string(FILE* out, const char* string) {
+  fputc('"', out);
+
+  for (; *string; string++) {
+    if (*string == '"' || *string == '\\')
+      fprintf(out, "\\%c", *string);
+    else if ((unsigned char) *string < 0x20)
+      fprintf(out, "\\u%04x", *string);
+    else
+      fputc(*string, out);
+  }
+
+  fputc('"', out);
+}
+
+/*
+ * write_text - used to write snapshot as text.
+ * @admin - pointer to an object of admin struct
+ * @out - stream of admin connection
+ * @snapshot - metrics of all threads
+ * @rates - counters per second since previous snapshot
+ * @clients - client table (NULL if server has no connections)
+ * @clients_amount - amount of rows in table
+ */
+static void write_text(struct admin* admin, FILE* out, struct metrics_snapshot* snapshot, double* rates,
+                       struct admin_client* clients, int clients_amount) {
+  uint64_t* counters = snapshot->counters;
+  uint64_t now = metrics_now();
+  struct pool_stats stats;
+
+  fprintf(out, "uptime %.3f s\n", (now - admin->started) / 1e9);
+
+  if (admin->collect_clients)
+    fprintf(out, "connections %d open, %lu accepted, %lu closed\n", clients_amount,
+            counters[METRIC_ACCEPTED], counters[METRIC_CLOSED]);
+
+  fprintf(out, "messages in %lu (%.0f/s), out %lu (%.0f/s)\n", counters[METRIC_MESSAGES_IN],
+          rates[METRIC_MESSAGES_IN], counters[METRIC_MESSAGES_OUT], rates[METRIC_MESSAGES_OUT]);
+  fprintf(out, "bytes in %lu (%.0f/s), out %lu (%.0f/s)\n", counters[METRIC_BYTES_IN],
+          rates[METRIC_BYTES_IN], counters[METRIC_BYTES_OUT], rates[METRIC_BYTES_OUT]);
+
+  fprintf(out, "%-12s %10s %10s %10s %10s %10s\n", "latency ns", "count", "p50", "p99", "p99.9", "max");
+  for (int i = 0; i < METRIC_STAGES; i++) {
+    struct histogram* latency = &snapshot->latency[i];
+
+    fprintf(out, "%-12s %10lu %10lu %10lu %10lu %10lu\n", metric_stage_names[i], latency->total,
+            histogram_percentile(latency, 50), histogram_percentile(latency, 99),
+            histogram_percentile(latency, 99.9), latency->max);
+  }
+
+  pool_get_stats(&stats);
+  fprintf(out, "pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+
+  if (!admin->collect_clients)
+    return;
+
+  fprintf(out, "%-32s %12s %12s %10s\n", "client", "bytes in", "bytes out", "age s");
+  for (int i = 0; i < clients_amount; i++)
+    fprintf(out, "%-32s %12lu %12lu %10.1f\n", clients[i].endpoint, clients[i].bytes_in,
+            clients[i].bytes_out, (now - clients[i].connected_at) / 1e9);
+}
+
+/*
+ * write_json - used to write snapshot as one JSON object.
+ * @admin - pointer to an object of admin struct
+ * @out - stream of admin connection
+ * @snapshot - metrics of all threads
+ * @rates - counters per second since previous snapshot
+ * @clients - client table (NULL if server has no connections)
+ * @clients_amount - amount of rows in table
+ */
+static void write_json(struct admin* admin, FILE* out, struct metrics_snapshot* snapshot, double* rates,
+                       struct admin_client* clients, int clients_amount) {
+  uint64_t now = metrics_now();
+  struct pool_stats stats;
+
+  fprintf(out, "{\"uptime_s\":%.3f", (now - admin->started) / 1e9);
+
+  if (admin->collect_clients)
+    fprintf(out, ",\"connections\":%d", clients_amount);
+
+  for (int i = 0; i < METRIC_COUNTERS; i++)
+    fprintf(out, ",\"%s\":%lu", metric_counter_names[i], snapshot->counters[i]);
+
+  fprintf(out, ",\"rates\":{");
+  for (int i = METRIC_MESSAGES_IN; i < METRIC_COUNTERS; i++)
+    fprintf(out, "%s\"%s\":%.0f", i == METRIC_MESSAGES_IN ? "" : ",", metric_counter_names[i], rates[i]);
+
+  fprintf(out, "},\"latency_ns\":{");
+  for (int i = 0; i < METRIC_STAGES; i++) {
+    struct histogram* latency = &snapshot->latency[i];
+
+    fprintf(out, "%s\"%s\":{\"count\":%lu,\"p50\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu}", i ? "," : "",
+            metric_stage_names[i], latency->total, histogram_percentile(latency, 50),
+            histogram_percentile(latency, 99), histogram_percentile(latency, 99.9), latency->max);
+  }
+
+  pool_get_stats(&stats);
+  fprintf(out, "},\"pool\":{\"hits\":%lu,\"misses\":%lu}", stats.hits, stats.misses);
+
+  if (admin->collect_clients) {
+    fprintf(out, ",\"clients\":[");
+    for (int i = 0; i < clients_amount; i++) {
+      fprintf(out, "%s{\"endpoint\":", i ? "," : "");
+      write_json_string(out, clients[i].endpoint);
+      fprintf(out, ",\"bytes_in\":%lu,\"bytes_out\":%lu,\"age_s\":%.3f}", clients[i].bytes_in,
+              clients[i].bytes_out, (now - clients[i].connected_at) / 1e9);
+    }
+    fprintf(out, "]");
+  }
+
+  fprintf(out, "}\n");
+}
+
+/*
+ * write_snapshot - used to collect metrics of all threads
+ * and client table and write them to admin connection.
+ * @admin - pointer to an object of admin struct
+ * @out - stream of admin connection
+ * @json - write JSON instead of text
+ */
+static void write_snapshot(struct admin* admin, FILE* out, int json) {
+  struct metrics_snapshot* snapshot = (struct metrics_snapshot*) malloc(sizeof(struct metrics_snapshot));
+  struct admin_client* clients = NULL;
+  int clients_amount = 0;
+  double rates[METRIC_COUNTERS];
+
+  if (!snapshot)
+    print_error("malloc");
+
+  metrics_get_snapshot(snapshot);
+  if (admin->collect_clients)
+    clients_amount = admin->collect_clients(admin->arg, &clients);
+
+  /* Rates since previous snapshot */
+  uint64_t now = metrics_now();
+  double seconds = (now - admin->last_time) / 1e9;
+
+  for (int i = 0; i < METRIC_COUNTERS; i++) {
+    rates[i] = seconds > 0 ? (snapshot->counters[i] - admin->last_counters[i]) / seconds : 0;
+    admin->last_counters[i] = snapshot->counters[i];
+  }
+  admin->last_time = now;
+
+  if (json)
+    write_json(admin, out, snapshot, rates, clients, clients_amount);
+  else
+    write_text(admin, out, snapshot, rates, clients, clients_amount);
+
+  free(clients);
+  free(snapshot);
+}
+
+/*
+ * handle_admin_request - used to read one command from
+ * admin connection and answer it. Reply is formatted in
+ * memory and sent with MSG_NOSIGNAL, so peer that left
+ * before reading can't kill server by SIGPIPE.
+ * @admin - pointer to an object of admin struct
+ * @fd - descriptor of admin connection
+ */
+static void handle_admin_request(struct admin* admin, int fd) {
+  struct timeval timeout = {1, 0};
+  char command[ADMIN_COMMAND_SIZE];
+  ssize_t bytes_read;
+  char* reply = NULL;
+  size_t reply_len = 0;
+  size_t sent = 0;
+
+  /* Don't let silent connection block admin thread */
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  bytes_read = recv(fd, command, sizeof(command) - 1, 0);
+  if (bytes_read == -1)
+    bytes_read = 0;
+  command[bytes_read] = '\0';
+  command[strcspn(command, "\r\n")] = '\0';
+
+  FILE* out = open_memstream(&reply, &reply_len);
+  if (!out) {
+    close(fd);
+    return;
+  }
+
+  if (command[0] == '\0' || strcmp(command, "stats") == 0)
+    write_snapshot(admin, out, 0);
+  else if (strcmp(command, "json") == 0)
+    write_snapshot(admin, out, 1);
+  else if (strncmp(command, "level ", 6) == 0 && log_parse_level(command + 6) != -1) {
+    log_set_level(log_parse_level(command + 6));
+    fprintf(out, "ok\n");
+  } else
+    fprintf(out, "unknown command, use: stats | json | level debug|info|warn|error|off\n");
+
+  fclose(out);
+
+  while (sent < reply_len) {
+    ssize_t result = send(fd, reply + sent, reply_len - sent, MSG_NOSIGNAL);
+    if (result == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    sent += result;
+  }
+
+  free(reply);
+  close(fd);
+}
+
+/*
+ * run_admin - used as routine of admin thread. Answers
+ * connections one by one. Thread can only be cancelled
+ * while it waits for connection.
+ * @arg - pointer to an object of admin struct
+ */
+static void* run_admin(void* arg) {
+  struct admin* admin = (struct admin*) arg;
+
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+  while (1) {
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    int fd = accept4(admin->sfd, NULL, NULL, SOCK_CLOEXEC);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      log_error("SERVER: Admin socket stopped accepting: %s\n", strerror(errno));
+      return NULL;
+    }
+
+    handle_admin_request(admin, fd);
+  }
+}
+
+/*
+ * admin_table_add - used to append row to client table.
+ * Table grows twice when it is full.
+ * @table - pointer to an object of admin_table struct
+ *
+ * Return: pointer to new row
+ */
+struct admin_client* admin_table_add(struct admin_table* table) {
+  if (table->amount == table->capacity) {
+    int capacity = table->capacity ? table->capacity * 2 : 64;
+    struct admin_client* rows = (struct admin_client*) realloc(table->rows, capacity * sizeof(struct admin_client));
+    if (!rows)
+      print_error("realloc");
+    table->rows = rows;
+    table->capacity = capacity;
+  }
+
+  return &table->rows[table->amount++];
+}
+
+/*
+ * start_admin - used to create admin socket and start
+ * thread that answers it. Stale socket file is replaced.
+ * @admin - pointer to an object of admin struct
+ * @path - path of admin socket
+ * @collect_clients - fills client table, NULL if server has no connections
+ * @arg - argument of collect_clients
+ */
+void start_admin(struct admin* admin, const char* path,
+                 int (*collect_clients)(void* arg, struct admin_client** clients), void* arg) {
+  memset(admin, 0, sizeof(struct admin));
+  admin->collect_clients = collect_clients;
+  admin->arg = arg;
+  admin->started = metrics_now();
+  admin->last_time = admin->started;
+
+  admin->addr.sun_family = AF_LOCAL;
+  strncpy(admin->addr.sun_path, path, sizeof(admin->addr.sun_path) - 1);
+
+  admin->sfd = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (admin->sfd == -1)
+    print_error("socket");
+
+  unlink(path);
+  if (bind(admin->sfd, (struct sockaddr*) &admin->addr, sizeof(admin->addr)) == -1)
+    print_error("bind");
+
+  if (listen(admin->sfd, 16) == -1)
+    print_error("listen");
+
+  if (pthread_create(&admin->thread, NULL, run_admin, admin) != 0)
+    print_error("pthread_create");
+
+  log_info("SERVER: Admin socket %s\n", admin->addr.sun_path);
+}
+
+/*
+ * stop_admin - used to stop admin thread, close admin
+ * socket and remove its file.
+ * @admin - pointer to an object of admin struct
+ */
+void stop_admin(struct admin* admin) {
+  if (admin->sfd == -1)
+    return;
+
+  pthread_cancel(admin->thread);
+  pthread_join(admin->thread, NULL);
+
+  close(admin->sfd);
+  unlink(admin->addr.sun_path);
+  admin->sfd = -1;
+}
@@ -0,0 +1,51 @@
+#include "../headers/msgbuf.h"
+
+/*
+ * msgbuf_alloc - used to allocate empty message buffer
+ * from pool.
+ * @headroom - bytes reserved in front of data
+ * @size - max length of data
+ *
+ * Return: pointer to an object of msgbuf struct, must be
+ * freed by msgbuf_free
+ */
+struct msgbuf* msgbuf_alloc(uint32_t headroom, uint32_t size) {
+  struct msgbuf* msgbuf = (struct msgbuf*) pool_alloc(sizeof(struct msgbuf) + headroom + size);
+
+  msgbuf->data = msgbuf->storage + headroom;
+  msgbuf->len = 0;
+  msgbuf->headroom = headroom;
+
+  return msgbuf;
+}
+
+/*
+ * msgbuf_push - used to prepend bytes to data, taking
+ * them from headroom.
+ * @msgbuf - pointer to an object of msgbuf struct
+ * @bytes - bytes that need to be prepended
+ * @len - amount of bytes (up to headroom)
+ *
+ * Return: new start of data
+ */
+char* msgbuf_push(struct msgbuf* msgbuf, const void* bytes, uint32_t len) {
+  if (len > msgbuf->headroom) {
+    fprintf(stderr, "msgbuf_push: %u bytes don't fit in headroom of %u bytes\n", len, msgbuf->headroom);
+    exit(EXIT_FAILURE);
+  }
+
+  msgbuf->data -= len;
+  msgbuf->len += len;
+  msgbuf->headroom -= len;
+  memcpy(msgbuf->data, bytes, len);
+
+  return msgbuf->data;
+}
+
+/*
+ * msgbuf_free - used to return message buffer to pool.
+ * @msgbuf - pointer to an object of msgbuf struct (may be NULL)
+ */
+void msgbuf_free(struct msgbuf* msgbuf) {
+  pool_free(msgbuf);
+}
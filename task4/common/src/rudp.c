@@ -0,0 +1,380 @@
+#include "../headers/rudp.h"
+#include <endian.h>
+
+/*
+ * rudp_sendto - used to send datagram to peer, unless
+ * injected loss drops it. Datagrams that socket refuses are
+ * taken as lost too, they are retransmitted anyway.
+ * @peer - pointer to an object of rudp_peer struct
+ * @data - datagram with header
+ * @len - length of datagram
+ */
+static void rudp_sendto(struct rudp_peer* peer, const char* data, size_t len) {
+  struct rudp_loss* loss = peer->loss;
+
+  if (loss && loss->rate > 0 && rand_r(&loss->seed) < loss->rate * RAND_MAX) {
+    loss->dropped++;
+    return;
+  }
+
+  while (sendto(peer->sfd, data, len, 0, (struct sockaddr*) &peer->addr, sizeof(peer->addr)) == -1) {
+    if (errno == EINTR)
+      continue;
+    if (errno == ECONNREFUSED || errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK)
+      return;
+    print_error("sendto");
+  }
+}
+
+/*
+ * rudp_transmit - used to (re)send datagram of the slot.
+ * Header is refreshed with current acknowledgement, so
+ * every datagram carries ACK of what peer sent.
+ * @peer - pointer to an object of rudp_peer struct
+ * @slot - pointer to slot of sent datagram
+ */
+static void rudp_transmit(struct rudp_peer* peer, struct rudp_slot* slot) {
+  struct rudp_header* header = (struct rudp_header*) slot->data;
+
+  header->ack = htonl(peer->ack);
+  header->sack = htobe64(peer->received);
+  peer->ack_pending = 0;
+
+  rudp_sendto(peer, slot->data, slot->len);
+}
+
+/*
+ * rudp_sample - used to update round trip time estimation
+ * and retransmission timeout (RFC 6298) by new sample.
+ * @peer - pointer to an object of rudp_peer struct
+ * @rtt - round trip time of datagram sent once
+ */
+static void rudp_sample(struct rudp_peer* peer, uint64_t rtt) {
+  if (peer->srtt == 0) {
+    peer->srtt = rtt;
+    peer->rttvar = rtt / 2;
+  } else {
+    uint64_t delta = peer->srtt > rtt ? peer->srtt - rtt : rtt - peer->srtt;
+
+    peer->rttvar = (3 * peer->rttvar + delta) / 4;
+    peer->srtt = (7 * peer->srtt + rtt) / 8;
+  }
+
+  peer->rto = peer->srtt + 4 * peer->rttvar;
+  if (peer->rto < RUDP_MIN_RTO_NS)
+    peer->rto = RUDP_MIN_RTO_NS;
+  if (peer->rto > RUDP_MAX_RTO_NS)
+    peer->rto = RUDP_MAX_RTO_NS;
+}
+
+/*
+ * rudp_ack - used to release datagrams acknowledged by
+ * peer and retransmit ones that RUDP_DUP_THRESH later
+ * datagrams overtook. Round trip time is sampled only from
+ * datagrams sent once (Karn's algorithm).
+ * @peer - pointer to an object of rudp_peer struct
+ * @ack - all sequence numbers below were received by peer
+ * @sack - bit i stands for ack + 1 + i received by peer
+ * @now - current time in nanoseconds
+ */
+static void rudp_ack(struct rudp_peer* peer, uint32_t ack, uint64_t sack, uint64_t now) {
+  uint32_t highest = sack ? ack + 64 - __builtin_clzll(sack) : ack - 1;
+
+  /* Acknowledgement of datagrams that were never sent */
+  if ((int32_t) (ack - peer->next) > 0)
+    return;
+
+  for (uint32_t seq = peer->base; seq != peer->next; seq++) {
+    struct rudp_slot* slot = &peer->slots[seq % RUDP_WINDOW_MAX];
+    int32_t offset = seq - ack;
+
+    if (!slot->used)
+      continue;
+    if (offset == 0 || (offset > 0 && (offset > 64 || !((sack >> (offset - 1)) & 1))))
+      continue;
+
+    if (slot->tries == 1)
+      rudp_sample(peer, now - slot->sent_at);
+    slot->used = 0;
+  }
+
+  while (peer->base != peer->next && !peer->slots[peer->base % RUDP_WINDOW_MAX].used)
+    peer->base++;
+
+  /* Datagram overtaken by later ones is taken as lost */
+  for (uint32_t seq = peer->base; seq != peer->next; seq++) {
+    struct rudp_slot* slot = &peer->slots[seq % RUDP_WINDOW_MAX];
+
+    if ((int32_t) (highest - seq) < RUDP_DUP_THRESH)
+      break;
+    if (!slot->used || slot->fast)
+      continue;
+
+    slot->fast = 1;
+    slot->tries++;
+    slot->deadline = now + peer->rto;
+    peer->fast_retransmits++;
+    rudp_transmit(peer, slot);
+  }
+}
+
+/*
+ * init_rudp_peer - used to initialize state of reliable
+ * exchange with peer.
+ * @peer - pointer to an object of rudp_peer struct
+ * @sfd - socket used to reach peer
+ * @addr - address of the peer
+ * @session - id of the exchange
+ * @window - amount of datagrams in flight (up to RUDP_WINDOW_MAX)
+ * @loss - loss injected into sent datagrams, NULL for none
+ */
+void init_rudp_peer(struct rudp_peer* peer, int sfd, const struct sockaddr_in* addr,
+                    uint32_t session, int window, struct rudp_loss* loss) {
+  memset(peer, 0, sizeof(struct rudp_peer));
+  peer->sfd = sfd;
+  peer->addr = *addr;
+  peer->session = session;
+  peer->window = window < 1 ? 1 : window > RUDP_WINDOW_MAX ? RUDP_WINDOW_MAX : window;
+  peer->loss = loss;
+  peer->rto = RUDP_INITIAL_RTO_NS;
+  peer->deadline = UINT64_MAX;
+}
+
+/*
+ * rudp_queue - used to send gathered data to peer as one
+ * datagram with given flags. Datagram is kept until peer
+ * acknowledges it.
+ * @peer - pointer to an object of rudp_peer struct
+ * @iov - parts of data
+ * @iovcnt - amount of parts
+ * @flags - flags of datagram header
+ * @now - current time in nanoseconds
+ *
+ * Return: 0 on success, -1 if window is full or data is too long
+ */
+static int rudp_queue(struct rudp_peer* peer, const struct iovec* iov, int iovcnt, uint8_t flags, uint64_t now) {
+  struct rudp_slot* slot = &peer->slots[peer->next % RUDP_WINDOW_MAX];
+  struct rudp_header* header = (struct rudp_header*) slot->data;
+  uint32_t len = RUDP_HEADER_LEN;
+
+  if (peer->next - peer->base >= (uint32_t) peer->window)
+    return -1;
+
+  for (int i = 0; i < iovcnt; i++) {
+    if (iov[i].iov_len > RUDP_DATAGRAM_SIZE - len)
+      return -1;
+    memcpy(slot->data + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+
+  header->magic = htons(RUDP_MAGIC);
+  header->flags = flags;
+  header->reserved = 0;
+  header->session = htonl(peer->session);
+  header->seq = htonl(peer->next);
+
+  slot->used = 1;
+  slot->tries = 1;
+  slot->fast = 0;
+  slot->len = len;
+  slot->sent_at = now;
+  slot->deadline = now + peer->rto;
+  if (slot->deadline < peer->deadline)
+    peer->deadline = slot->deadline;
+
+  peer->next++;
+  rudp_transmit(peer, slot);
+
+  return 0;
+}
+
+/*
+ * rudp_send - used to send gathered data to peer as one
+ * datagram. Datagram is kept until peer acknowledges it.
+ * @peer - pointer to an object of rudp_peer struct
+ * @iov - parts of data
+ * @iovcnt - amount of parts
+ * @now - current time in nanoseconds
+ *
+ * Return: 0 on success, -1 if window is full or data is too long
+ */
+int rudp_send(struct rudp_peer* peer, const struct iovec* iov, int iovcnt, uint64_t now) {
+  return rudp_queue(peer, iov, iovcnt, RUDP_DATA, now);
+}
+
+/*
+ * rudp_close - used to tell peer that exchange is over.
+ * RUDP_FIN is retransmitted like data, so once it is
+ * acknowledged peer got acknowledgement of everything
+ * received before and needs no more of it.
+ * @peer - pointer to an object of rudp_peer struct
+ * @now - current time in nanoseconds
+ *
+ * Return: 0 on success, -1 if window is full
+ */
+int rudp_close(struct rudp_peer* peer, uint64_t now) {
+  return rudp_queue(peer, NULL, 0, RUDP_DATA | RUDP_FIN, now);
+}
+
+/*
+ * rudp_parse - used to check datagram of reliable mode
+ * and read its header in host order.
+ * @datagram - received datagram
+ * @len - length of datagram
+ * @header - pointer to header to fill
+ *
+ * Return: 0 on success, -1 if datagram has no valid header
+ */
+int rudp_parse(const char* datagram, size_t len, struct rudp_header* header) {
+  if (len < RUDP_HEADER_LEN)
+    return -1;
+
+  memcpy(header, datagram, RUDP_HEADER_LEN);
+  if (ntohs(header->magic) != RUDP_MAGIC)
+    return -1;
+
+  header->magic = RUDP_MAGIC;
+  header->session = ntohl(header->session);
+  header->seq = ntohl(header->seq);
+  header->ack = ntohl(header->ack);
+  header->sack = be64toh(header->sack);
+
+  return 0;
+}
+
+/*
+ * rudp_input - used to handle datagram received from
+ * peer. Its acknowledgement releases sent datagrams, its
+ * payload is delivered unless it was delivered before or
+ * lies beyond window. Peer that answers payloads takes no
+ * payload while its own window is full. Every datagram with
+ * payload has to be acknowledged, by next sent datagram or
+ * rudp_flush_ack. RUDP_FIN marks peer closed and delivers
+ * nothing.
+ * @peer - pointer to an object of rudp_peer struct
+ * @datagram - received datagram
+ * @len - length of datagram
+ * @now - current time in nanoseconds
+ * @payload - set to payload of delivered datagram
+ * @payload_len - set to length of payload
+ *
+ * Return: 1 if payload is delivered, 0 if not, -1 if datagram is invalid
+ */
+int rudp_input(struct rudp_peer* peer, char* datagram, size_t len, uint64_t now,
+               char** payload, size_t* payload_len) {
+  struct rudp_header header;
+
+  if (rudp_parse(datagram, len, &header) == -1 || header.session != peer->session)
+    return -1;
+
+  peer->active_at = now;
+  rudp_ack(peer, header.ack, header.sack, now);
+
+  if (!(header.flags & RUDP_DATA))
+    return 0;
+
+  /* Answer could not be sent, peer retransmits payload later */
+  if (peer->answers && peer->next - peer->base >= (uint32_t) peer->window)
+    return 0;
+
+  peer->ack_pending = 1;
+
+  int32_t offset = header.seq - peer->ack;
+  if (offset < 0 || offset > 64)
+    return 0;
+
+  if (offset == 0) {
+    /* Move acknowledgement over datagrams received earlier */
+    peer->ack++;
+    while (peer->received & 1) {
+      peer->received >>= 1;
+      peer->ack++;
+    }
+    peer->received >>= 1;
+  } else {
+    uint64_t bit = 1ULL << (offset - 1);
+
+    if (peer->received & bit)
+      return 0;
+    peer->received |= bit;
+  }
+
+  if (header.flags & RUDP_FIN) {
+    peer->closed = 1;
+    return 0;
+  }
+
+  *payload = datagram + RUDP_HEADER_LEN;
+  *payload_len = len - RUDP_HEADER_LEN;
+
+  return 1;
+}
+
+/*
+ * rudp_flush_ack - used to send pure ACK if received
+ * datagrams were not acknowledged by sent ones.
+ * @peer - pointer to an object of rudp_peer struct
+ */
+void rudp_flush_ack(struct rudp_peer* peer) {
+  struct rudp_header header;
+
+  if (!peer->ack_pending)
+    return;
+
+  header.magic = htons(RUDP_MAGIC);
+  header.flags = 0;
+  header.reserved = 0;
+  header.session = htonl(peer->session);
+  header.seq = htonl(peer->next);
+  header.ack = htonl(peer->ack);
+  header.sack = htobe64(peer->received);
+  peer->ack_pending = 0;
+
+  rudp_sendto(peer, (const char*) &header, RUDP_HEADER_LEN);
+}
+
+/*
+ * rudp_expire - used to retransmit datagrams whose
+ * timeout passed. Timeout is doubled once per expiry
+ * until new sample arrives.
+ * @peer - pointer to an object of rudp_peer struct
+ * @now - current time in nanoseconds
+ *
+ * Return: 0 on success, -1 if datagram was sent RUDP_MAX_TRIES times
+ */
+int rudp_expire(struct rudp_peer* peer, uint64_t now) {
+  int fired = 0;
+
+  if (now < peer->deadline)
+    return 0;
+
+  peer->deadline = UINT64_MAX;
+
+  for (uint32_t seq = peer->base; seq != peer->next; seq++) {
+    struct rudp_slot* slot = &peer->slots[seq % RUDP_WINDOW_MAX];
+
+    if (!slot->used)
+      continue;
+
+    if (slot->deadline <= now) {
+      if (slot->tries >= RUDP_MAX_TRIES)
+        return -1;
+
+      /* Back off */
+      if (!fired) {
+        peer->rto = peer->rto * 2 > RUDP_MAX_RTO_NS ? RUDP_MAX_RTO_NS : peer->rto * 2;
+        fired = 1;
+      }
+
+      slot->tries++;
+      slot->deadline = now + peer->rto;
+      peer->timeouts++;
+      rudp_transmit(peer, slot);
+    }
+
+    if (slot->deadline < peer->deadline)
+      peer->deadline = slot->deadline;
+  }
+
+  return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef RELIABLE_H
+#define RELIABLE_H
+
+#include "../../common/headers/common.h"
+#include "../../common/headers/rudp.h"
+#include "shard.h"
+
+/* Buckets of peers table of every shard */
+#define RUDP_PEER_BUCKETS 1024
+
+/* Peer with nothing in flight is removed after so long silence */
+#define RUDP_PEER_IDLE_NS (10 * 1000000000ULL)
+
+/* Closed peer stays so long to acknowledge retransmitted RUDP_FIN */
+#define RUDP_PEER_CLOSED_NS (2 * RUDP_MAX_RTO_NS)
+
+/* Period of looking for idle peers while shard has any */
+#define RUDP_PEER_SWEEP_NS (1000000000ULL)
+
+void run_reliable_shard(struct shard* shard);
+
+int recv_datagrams(struct shard* shard);
+
+void handle_datagram(struct shard* shard, int index, uint64_t now);
+
+struct rudp_peer* find_peer(struct shard* shard, struct sockaddr_in* addr, struct rudp_header* header);
+
+void sweep_peers(struct shard* shard, uint64_t now);
+
+void free_peers(struct shard* shard);
+
+#endif // !RELIABLE_H
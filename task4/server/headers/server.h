@@ -2,28 +2,46 @@
 #define SERVER_H
 
 #include "../../common/headers/common.h"
+#include "../../common/headers/admin.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/msgbuf.h"
+#include "shard.h"
+#include "reliable.h"
 
 /**
  * Used to create server on inet adress family (AF_INET) with
- * UDP protocol. 
+ * UDP protocol. Datagrams are served by shards, one per thread.
  */
 struct server {
   /* Address of the server */
   struct sockaddr_in serv;
-  
-  /* Socket file descriptor */
-  int sfd;
+
+  /* Workers, each with its own socket */
+  struct shard* shards;
+  int shards_amount;
+
+  /* Max amount of datagrams received and sent by one call */
+  int batch_size;
+
+  /* Datagrams are exchanged reliably (rudp) and probability of
+     sent datagram being dropped */
+  int reliable;
+  double loss;
+
+  /* Socket that answers with metrics */
+  struct admin admin;
 };
 
-struct server* create_server(const char* ip, const int port);
+struct server* create_server(const char* ip, const int port, int shards_amount, int batch_size,
+                             int reliable, double loss);
 
 void run_server(struct server* server);
 
-void send_message(struct server* server, struct sockaddr_in* client, char buffer[BUFFER_SIZE]);
+void send_message(struct shard* shard, struct sockaddr_in* client, struct msgbuf* message);
   
-char* recv_message(struct server* server, struct sockaddr_in* client);
+struct msgbuf* recv_message(struct shard* shard, struct sockaddr_in* client);
 
-char* edit_message(char* message);
+void edit_message(struct msgbuf* message);
 
 void close_connection(struct server* server);
 
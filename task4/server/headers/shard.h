@@ -0,0 +1,67 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "../../common/headers/common.h"
+#include "../../common/headers/log.h"
+#include "../../common/headers/metrics.h"
+#include "../../common/headers/rudp.h"
+
+/**
+ * Used as worker that owns its own socket bound with
+ * SO_REUSEPORT to servers address. Kernel hashes client
+ * flows between shards, each shard keeps its own batch
+ * and counters, so workers share nothing.
+ */
+struct shard {
+  /* Pointer to server that owns shard */
+  struct server* server;
+
+  /* Socket file descriptor */
+  int sfd;
+
+  /* Index of shard, used as CPU number to pin thread */
+  int id;
+
+  /* Thread that runs shard */
+  pthread_t thread;
+
+  /* Preallocated headers, addresses and buffers of the batch */
+  struct mmsghdr* in_msgs;
+  struct mmsghdr* out_msgs;
+  struct iovec* in_iovs;
+  struct iovec* out_iovs;
+  struct sockaddr_in* addrs;
+  char* in_buffers;
+
+  /* Amount of received and answered datagrams */
+  unsigned long received;
+  unsigned long sent;
+
+  /* Reliable mode: table of peers, their amount, nearest time
+     they need attention and loss injected into sent datagrams */
+  struct rudp_peer** peers;
+  int peers_amount;
+  uint64_t wake_at;
+  struct rudp_loss loss;
+
+  /* Reliable mode: datagrams retransmitted to removed peers */
+  unsigned long retransmits;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+void init_shard(struct shard* shard, struct server* server, int id);
+
+void* run_shard(void* arg);
+
+void run_batch_shard(struct shard* shard);
+
+int recv_messages(struct shard* shard);
+
+void edit_messages(struct shard* shard, int amount);
+
+void send_messages(struct shard* shard, int amount);
+
+void count_replies(struct shard* shard, int first, int amount);
+
+void free_shard(struct shard* shard);
+
+#endif // !SHARD_H
@@ -4,8 +4,61 @@ struct server* server;
 
 void cleanup();
 
-int main(void) {
-  server = create_server(SERVER_IP, SERVER_PORT);
+/*
+ * Usage: server [-s shards] [-n batch] [-r] [-l loss]
+ * -s - amount of workers with their own sockets
+ *      (SO_REUSEPORT), 0 - one per CPU
+ * -n - max amount of datagrams handled by one system
+ *      call (BATCH_SIZE by default, 1 - one by one)
+ * -r - exchange datagrams reliably: sequence numbers,
+ *      selective ACKs and retransmissions (client -r)
+ * -l - percent of datagrams dropped before send in
+ *      reliable mode, to test retransmissions
+ * LOG_LEVEL environment variable sets lowest printed
+ * level: debug, info (default), warn, error or off
+ */
+int main(int argc, char** argv) {
+  int batch_size = BATCH_SIZE;
+  int shards_amount = 1;
+  int reliable = 0;
+  double loss = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:n:rl:")) != -1) {
+    switch (opt) {
+      case 's':
+        shards_amount = atoi(optarg);
+        break;
+      case 'n':
+        batch_size = atoi(optarg);
+        break;
+      case 'r':
+        reliable = 1;
+        break;
+      case 'l':
+        loss = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-s shards] [-n batch] [-r] [-l loss]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  log_init();
+
+  if (batch_size < 1)
+    batch_size = 1;
+
+  if (loss < 0 || loss >= 100) {
+    fprintf(stderr, "Loss must be in range 0..100 percent\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* One shard per CPU */
+  if (shards_amount <= 0)
+    shards_amount = sysconf(_SC_NPROCESSORS_ONLN);
+
+  server = create_server(SERVER_IP, SERVER_PORT, shards_amount, batch_size, reliable, loss / 100);
   atexit(cleanup);
   run_server(server); 
   exit(EXIT_SUCCESS);
@@ -0,0 +1,228 @@
+#include "../headers/reliable.h"
+#include "../headers/server.h"
+#include <poll.h>
+
+/*
+ * peer_bucket - used to find bucket of peers table that
+ * holds peer with given address.
+ * @addr - address of the peer
+ *
+ * Return: index of bucket
+ */
+static uint32_t peer_bucket(const struct sockaddr_in* addr) {
+  return (addr->sin_addr.s_addr ^ (addr->sin_port * 2654435761u)) % RUDP_PEER_BUCKETS;
+}
+
+/*
+ * run_reliable_shard - used to serve datagrams of reliable
+ * mode. Shard sleeps until datagrams come or until nearest
+ * retransmission of any peer, every delivered request is
+ * answered by reliable reply that also acknowledges it.
+ * @shard - pointer to an object of shard struct
+ */
+void run_reliable_shard(struct shard* shard) {
+  struct pollfd pfd = {shard->sfd, POLLIN, 0};
+
+  while (1) {
+    uint64_t now = metrics_now();
+    int wait = -1;
+
+    if (shard->wake_at != UINT64_MAX)
+      wait = shard->wake_at > now ? (shard->wake_at - now + 999999) / 1000000 : 0;
+
+    if (poll(&pfd, 1, wait) == -1 && errno != EINTR)
+      print_error("poll");
+
+    now = metrics_now();
+    int amount = recv_datagrams(shard);
+
+    for (int i = 0; i < amount; i++)
+      handle_datagram(shard, i, now);
+
+    if (now >= shard->wake_at)
+      sweep_peers(shard, now);
+  }
+}
+
+/*
+ * recv_datagrams - used to take batch of datagrams that are
+ * already queued in socket, without waiting.
+ * @shard - pointer to an object of shard struct
+ *
+ * Return: amount of received datagrams
+ */
+int recv_datagrams(struct shard* shard) {
+  int amount;
+
+  /* Reset lengths changed by previous call */
+  for (int i = 0; i < shard->server->batch_size; i++)
+    shard->in_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+
+  amount = recvmmsg(shard->sfd, shard->in_msgs, shard->server->batch_size, MSG_DONTWAIT, NULL);
+  if (amount == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return 0;
+    print_error("recvmmsg");
+  }
+
+  for (int i = 0; i < amount; i++)
+    metrics_add(METRIC_BYTES_IN, shard->in_msgs[i].msg_len);
+
+  return amount;
+}
+
+/*
+ * handle_datagram - used to pass datagram of the batch to
+ * its peer and answer delivered request with prefix and
+ * payload. Datagrams that were not answered are
+ * acknowledged at once.
+ * @shard - pointer to an object of shard struct
+ * @index - index of datagram in batch
+ * @now - current time in nanoseconds
+ */
+void handle_datagram(struct shard* shard, int index, uint64_t now) {
+  char* datagram = (char*) shard->in_iovs[index].iov_base;
+  size_t len = shard->in_msgs[index].msg_len;
+  struct rudp_header header;
+  struct rudp_peer* peer;
+  char* payload;
+  size_t payload_len;
+
+  if (rudp_parse(datagram, len, &header) == -1) {
+    log_debug("SERVER: Dropped datagram without reliable header from %s:%d\n",
+              inet_ntoa(shard->addrs[index].sin_addr), ntohs(shard->addrs[index].sin_port));
+    return;
+  }
+
+  peer = find_peer(shard, &shard->addrs[index], &header);
+  if (!peer)
+    return;
+
+  if (rudp_input(peer, datagram, len, now, &payload, &payload_len) == 1) {
+    struct iovec reply[2] = {{PREFIX, PREFIX_LEN}, {payload, payload_len}};
+
+    metrics_add(METRIC_MESSAGES_IN, 1);
+    shard->received++;
+
+    /* Window was checked by rudp_input, reply always fits */
+    uint64_t start = metrics_now();
+    rudp_send(peer, reply, 2, start);
+    metrics_record(STAGE_SEND, start);
+
+    metrics_add(METRIC_MESSAGES_OUT, 1);
+    metrics_add(METRIC_BYTES_OUT, RUDP_HEADER_LEN + PREFIX_LEN + payload_len);
+    shard->sent++;
+  }
+
+  rudp_flush_ack(peer);
+
+  if (peer->deadline < shard->wake_at)
+    shard->wake_at = peer->deadline;
+}
+
+/*
+ * find_peer - used to find peer that sent datagram. First
+ * datagram of new session adds peer, or resets peer whose
+ * client reused address.
+ * @shard - pointer to an object of shard struct
+ * @addr - address of the sender
+ * @header - header of received datagram
+ *
+ * Return: pointer to peer, NULL if datagram belongs to no session
+ */
+struct rudp_peer* find_peer(struct shard* shard, struct sockaddr_in* addr, struct rudp_header* header) {
+  uint32_t bucket = peer_bucket(addr);
+  struct rudp_peer* peer;
+  struct rudp_peer* next_peer = shard->peers[bucket];
+
+  for (peer = shard->peers[bucket]; peer; peer = peer->next_peer) {
+    if (peer->addr.sin_addr.s_addr == addr->sin_addr.s_addr && peer->addr.sin_port == addr->sin_port)
+      break;
+  }
+
+  if (peer && peer->session == header->session)
+    return peer;
+
+  /* Only first datagram opens session */
+  if (!(header->flags & RUDP_DATA) || header->seq != 0)
+    return NULL;
+
+  if (!peer) {
+    peer = (struct rudp_peer*) malloc(sizeof(struct rudp_peer));
+    if (!peer)
+      print_error("malloc");
+    shard->peers[bucket] = peer;
+    shard->peers_amount++;
+  } else {
+    shard->retransmits += peer->timeouts + peer->fast_retransmits;
+    next_peer = peer->next_peer;
+  }
+
+  init_rudp_peer(peer, shard->sfd, addr, header->session, RUDP_WINDOW_MAX, &shard->loss);
+  peer->answers = 1;
+  peer->next_peer = next_peer;
+
+  log_debug("SERVER: Peer %s:%d opened session %u\n", inet_ntoa(addr->sin_addr),
+            ntohs(addr->sin_port), header->session);
+
+  return peer;
+}
+
+/*
+ * sweep_peers - used to retransmit datagrams whose timeout
+ * passed and remove peers that stopped acknowledging,
+ * stayed idle for RUDP_PEER_IDLE_NS or closed session
+ * RUDP_PEER_CLOSED_NS ago. Finds time shard
+ * needs to wake up next.
+ * @shard - pointer to an object of shard struct
+ * @now - current time in nanoseconds
+ */
+void sweep_peers(struct shard* shard, uint64_t now) {
+  shard->wake_at = UINT64_MAX;
+
+  for (int i = 0; i < RUDP_PEER_BUCKETS; i++) {
+    struct rudp_peer** link = &shard->peers[i];
+
+    while (*link) {
+      struct rudp_peer* peer = *link;
+      int dead = rudp_expire(peer, now) == -1;
+      uint64_t idle = peer->closed ? RUDP_PEER_CLOSED_NS : RUDP_PEER_IDLE_NS;
+
+      if (dead || (peer->base == peer->next && now - peer->active_at > idle)) {
+        log_debug("SERVER: Peer %s:%d %s\n", inet_ntoa(peer->addr.sin_addr), ntohs(peer->addr.sin_port),
+                  dead ? "stopped acknowledging" : peer->closed ? "closed session" : "is idle");
+        shard->retransmits += peer->timeouts + peer->fast_retransmits;
+        shard->peers_amount--;
+        *link = peer->next_peer;
+        free(peer);
+        continue;
+      }
+
+      if (peer->deadline < shard->wake_at)
+        shard->wake_at = peer->deadline;
+      link = &peer->next_peer;
+    }
+  }
+
+  /* Look for idle peers from time to time */
+  if (shard->peers_amount > 0 && now + RUDP_PEER_SWEEP_NS < shard->wake_at)
+    shard->wake_at = now + RUDP_PEER_SWEEP_NS;
+}
+
+/*
+ * free_peers - used to free all peers of the shard.
+ * @shard - pointer to an object of shard struct
+ */
+void free_peers(struct shard* shard) {
+  for (int i = 0; i < RUDP_PEER_BUCKETS; i++) {
+    while (shard->peers[i]) {
+      struct rudp_peer* peer = shard->peers[i];
+
+      shard->retransmits += peer->timeouts + peer->fast_retransmits;
+      shard->peers[i] = peer->next_peer;
+      free(peer);
+    }
+  }
+
+  shard->peers_amount = 0;
+}
@@ -5,13 +5,20 @@
 
 /*
  * create_server - used to create an object of server
- * struct, initializes its fields.
+ * struct, initializes its fields and shards.
  * @ip - ip address of the server
  * @port - port of the server
+ * @shards_amount - amount of workers (threads)
+ * @batch_size - max amount of datagrams handled by one
+ * system call, 1 to handle datagrams one by one
+ * @reliable - exchange datagrams reliably (rudp)
+ * @loss - probability of sent datagram being dropped in
+ * reliable mode (0 - 1)
  *
  * Return: pointer to an object of server struct 
  */
-struct server* create_server(const char* ip, const int port) {
+struct server* create_server(const char* ip, const int port, int shards_amount, int batch_size,
+                             int reliable, double loss) {
   struct server* server = (struct server*) malloc(sizeof(struct server));
   if (!server)
     print_error("malloc");
@@ -21,116 +28,138 @@ struct server* create_server(const char* ip, const int port) {
   server->serv.sin_addr.s_addr = inet_addr(ip);
   server->serv.sin_port = htons(port);
 
-  /* Create a socket */
-  server->sfd = socket(AF_INET, SOCK_DGRAM, 0);
-  if (server->sfd == -1)
-    print_error("socket");
+  server->admin.sfd = -1;
+
+  /* Initialize shards, each on its own cache lines */
+  server->batch_size = batch_size;
+  server->reliable = reliable;
+  server->loss = loss;
+  server->shards_amount = shards_amount;
+  server->shards = (struct shard*) aligned_alloc(CACHE_LINE_SIZE, shards_amount * sizeof(struct shard));
+  if (!server->shards)
+    print_error("aligned_alloc");
+
+  for (int i = 0; i < shards_amount; i++)
+    init_shard(&server->shards[i], server, i);
 
   return server;
 }
 
 /*
- * run_server - used to bind server and
- * wait for data in socket.
+ * run_server - used to bind sockets of all shards,
+ * start admin socket and wait for data in them. Single shard runs in
+ * calling thread, several shards run in their own
+ * threads.
  * @server - pointer to an object of server struct
  */
 void run_server(struct server* server) {
-  struct sockaddr_in client;
-  socklen_t client_size = sizeof(client);
-
-  /* Bind Endpoint to socket */
-  if (bind(server->sfd, (struct sockaddr*) &server->serv, sizeof(server->serv)) == -1)
-    print_error("bind");
-    
-  printf("SERVER: Server %s:%d started\n", inet_ntoa(server->serv.sin_addr), ntohs(server->serv.sin_port));
-
-  /* Wait for data */
-  while (1) {
-    char* buffer = recv_message(server, &client);
-    char* reply = edit_message(buffer);
-    
-    printf("SERVER: Received message from %s:%d: %s\n", inet_ntoa(client.sin_addr), ntohs(client.sin_port), buffer);
-    send_message(server, &client, reply);
-
-    free(buffer);
-    free(reply);
+  /* Bind Endpoint to sockets */
+  for (int i = 0; i < server->shards_amount; i++) {
+    if (bind(server->shards[i].sfd, (struct sockaddr*) &server->serv, sizeof(server->serv)) == -1)
+      print_error("bind");
+  }
+
+  log_info("SERVER: Server %s:%d started with %d shard(s)%s\n", inet_ntoa(server->serv.sin_addr),
+           ntohs(server->serv.sin_port), server->shards_amount, server->reliable ? " in reliable mode" : "");
+  start_admin(&server->admin, ADMIN_SOCK_PATH, NULL, NULL);
+
+  /* Serve datagrams in current thread */
+  if (server->shards_amount == 1) {
+    run_shard(&server->shards[0]);
+    return;
   }
+
+  /* Serve datagrams in shards threads */
+  for (int i = 0; i < server->shards_amount; i++) {
+    if (pthread_create(&server->shards[i].thread, NULL, run_shard, &server->shards[i]) != 0)
+      print_error("pthread_create");
+  }
+
+  for (int i = 0; i < server->shards_amount; i++)
+    pthread_join(server->shards[i].thread, NULL);
 }
 
 /*
  * send_message - used to send message to client.
- * @server - pointer to an object of server struct
+ * @shard - pointer to an object of shard struct
  * @client - pointer to address of the client (sockaddr_in)
- * @buffer - message
+ * @message - message with prefix
  */
-void send_message(struct server* server, struct sockaddr_in* client, char buffer[BUFFER_SIZE]) {
+void send_message(struct shard* shard, struct sockaddr_in* client, struct msgbuf* message) {
   ssize_t bytes_send;
   socklen_t client_len = sizeof(*client);
 
-  bytes_send = sendto(server->sfd, buffer, strlen(buffer), 0, (struct sockaddr*) client, client_len);
+  uint64_t start = metrics_now();
+  bytes_send = sendto(shard->sfd, message->data, message->len, 0, (struct sockaddr*) client, client_len);
+  metrics_record(STAGE_SEND, start);
 
   if (bytes_send == -1)
     print_error("sendto");
+
+  metrics_add(METRIC_MESSAGES_OUT, 1);
+  metrics_add(METRIC_BYTES_OUT, bytes_send);
+
+  shard->sent++;
   
-  printf("SERVER: Send message to %s:%d: %s\n", inet_ntoa(client->sin_addr), ntohs(client->sin_port), buffer);
+  log_debug("SERVER: Send message to %s:%d: %s\n", inet_ntoa(client->sin_addr), ntohs(client->sin_port), message->data);
 }
 
 /*
  * recv_message - used to receive message from server.
- * allocates memory for message, then receives it all. Allocated
- * buffer must be freed manually.
- * @server - pointer to an object of server struct 
+ * Datagram is received behind PREFIX_LEN bytes of headroom and
+ * terminated. Message buffer must be freed by msgbuf_free.
+ * @shard - pointer to an object of shard struct 
  * @client - address of the client (sockaddr_in)
  *
- * Return: string (message) if successful, NULL if connection terminated
+ * Return: message buffer if successful, NULL if connection terminated
  */
-char* recv_message(struct server* server, struct sockaddr_in* client) {
+struct msgbuf* recv_message(struct shard* shard, struct sockaddr_in* client) {
   ssize_t bytes_read;
   socklen_t client_len;
-  char* buffer = (char*) malloc(BUFFER_SIZE * sizeof(char));
+  struct msgbuf* message = msgbuf_alloc(PREFIX_LEN, BUFFER_SIZE + 1);
   
   /* Get length of clients address */
   client_len = sizeof(*client);
   
   /* Receive message */
-  bytes_read = recvfrom(server->sfd, buffer, BUFFER_SIZE, 0, (struct sockaddr*) client, &client_len);  
+  bytes_read = recvfrom(shard->sfd, message->data, BUFFER_SIZE, 0, (struct sockaddr*) client, &client_len);  
   
-  /* Truncate message*/
-  buffer[bytes_read] = '\0';
-
   if (bytes_read == -1)
     print_error("recvfrom");
-  else if (bytes_read == 0)
+  else if (bytes_read == 0) {
+    msgbuf_free(message);
     return NULL;
+  }
+
+  /* Truncate message */
+  message->data[bytes_read] = '\0';
+  message->len = bytes_read;
+
+  metrics_add(METRIC_MESSAGES_IN, 1);
+  metrics_add(METRIC_BYTES_IN, bytes_read);
+
+  shard->received++;
 
-  return buffer;
+  return message;
 }
 
 /*
- * edit_message - used to add prefix "Server" to message.
- * Allocates new buffer. Return buffer should be free manually.
+ * edit_message - used to add prefix "Server " to message.
+ * Prefix is written in headroom in front of payload, so
+ * payload isn't copied.
  * @message - message from client that needs to be changed
- * 
- * Return: string with prefix
  */
-char* edit_message(char* message) {
-  char* prefix = "Server";
-  char* new_message = (char*) malloc(strlen(message) + strlen(prefix) + 2);
-  if (!new_message)
-    print_error("malloc");
-
-  /* Add prefix to message */
-  snprintf(new_message, strlen(message) + strlen(prefix) + 2, "%s %s", "Server", message);
-
-  return new_message;
+void edit_message(struct msgbuf* message) {
+  msgbuf_push(message, PREFIX, PREFIX_LEN);
 }
 
 /*
- * close_connection - used to close connection.
+ * close_connection - used to close sockets of all shards.
  * @server - pointer to an object of server struct
  */
 void close_connection(struct server* server) {
-  close(server->sfd);
+  for (int i = 0; i < server->shards_amount; i++)
+    close(server->shards[i].sfd);
 }
 
 /*
@@ -138,5 +167,24 @@ void close_connection(struct server* server) {
  * @server - pointer to an object of server struct
  */
 void free_server(struct server* server) {
+  struct pool_stats stats;
+
+  stop_admin(&server->admin);
+
+  pool_get_stats(&stats);
+  log_info("SERVER: Pool hits %lu, misses %lu\n", stats.hits, stats.misses);
+
+  for (int i = 0; i < server->shards_amount; i++) {
+    log_info("SERVER: Shard %d received %lu, sent %lu datagram(s)\n", i,
+             server->shards[i].received, server->shards[i].sent);
+    if (server->reliable) {
+      free_peers(&server->shards[i]);
+      log_info("SERVER: Shard %d retransmitted %lu, dropped %lu datagram(s)\n", i,
+               server->shards[i].retransmits, server->shards[i].loss.dropped);
+    }
+    free_shard(&server->shards[i]);
+  }
+
+  free(server->shards);
   free(server);
 }
@@ -0,0 +1,249 @@
+#include "../headers/shard.h"
+#include "../headers/server.h"
+#include <sched.h>
+#include <time.h>
+
+/*
+ * init_shard - used to initialize shard fields, create its
+ * socket and preallocate its batch. When server runs several
+ * shards, sockets are created with SO_REUSEPORT. In reliable
+ * mode datagrams carry header in front of payload and shard
+ * gets table of peers.
+ * @shard - pointer to an object of shard struct
+ * @server - pointer to server that owns shard
+ * @id - index of shard
+ */
+void init_shard(struct shard* shard, struct server* server, int id) {
+  int batch_size = server->batch_size;
+  size_t buffer_size = server->reliable ? RUDP_DATAGRAM_SIZE : BUFFER_SIZE;
+  int enable = 1;
+
+  shard->server = server;
+  shard->id = id;
+  shard->received = 0;
+  shard->sent = 0;
+  shard->retransmits = 0;
+
+  /* Peers are added by their first datagrams */
+  shard->peers = NULL;
+  shard->peers_amount = 0;
+  shard->wake_at = UINT64_MAX;
+  shard->loss.rate = server->loss;
+  shard->loss.seed = time(NULL) + id;
+  shard->loss.dropped = 0;
+  if (server->reliable) {
+    shard->peers = (struct rudp_peer**) calloc(RUDP_PEER_BUCKETS, sizeof(struct rudp_peer*));
+    if (!shard->peers)
+      print_error("calloc");
+  }
+
+  /* Create a socket */
+  shard->sfd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (shard->sfd == -1)
+    print_error("socket");
+
+  /* Share port between shards */
+  if (server->shards_amount > 1 &&
+      setsockopt(shard->sfd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1)
+    print_error("setsockopt");
+
+  /* Allocate batch once, it is reused by every call */
+  shard->in_msgs = (struct mmsghdr*) calloc(batch_size, sizeof(struct mmsghdr));
+  shard->out_msgs = (struct mmsghdr*) calloc(batch_size, sizeof(struct mmsghdr));
+  shard->in_iovs = (struct iovec*) calloc(batch_size, sizeof(struct iovec));
+  shard->out_iovs = (struct iovec*) calloc(batch_size * 2, sizeof(struct iovec));
+  shard->addrs = (struct sockaddr_in*) calloc(batch_size, sizeof(struct sockaddr_in));
+  shard->in_buffers = (char*) malloc(batch_size * buffer_size);
+  if (!shard->in_msgs || !shard->out_msgs || !shard->in_iovs || !shard->out_iovs ||
+      !shard->addrs || !shard->in_buffers)
+    print_error("malloc");
+
+  /* Incoming datagrams land in their own buffer, reply is prefix
+     followed by the same buffer and goes back to sender */
+  for (int i = 0; i < batch_size; i++) {
+    shard->in_iovs[i].iov_base = shard->in_buffers + i * buffer_size;
+    shard->in_iovs[i].iov_len = buffer_size;
+    shard->in_msgs[i].msg_hdr.msg_iov = &shard->in_iovs[i];
+    shard->in_msgs[i].msg_hdr.msg_iovlen = 1;
+    shard->in_msgs[i].msg_hdr.msg_name = &shard->addrs[i];
+
+    shard->out_iovs[i * 2].iov_base = PREFIX;
+    shard->out_iovs[i * 2].iov_len = PREFIX_LEN;
+    shard->out_iovs[i * 2 + 1].iov_base = shard->in_iovs[i].iov_base;
+    shard->out_msgs[i].msg_hdr.msg_iov = &shard->out_iovs[i * 2];
+    shard->out_msgs[i].msg_hdr.msg_iovlen = 2;
+    shard->out_msgs[i].msg_hdr.msg_name = &shard->addrs[i];
+  }
+}
+
+/*
+ * run_shard - used as thread function that serves datagrams
+ * of the shard in batches, or one by one if batch size is 1,
+ * or reliably in reliable mode.
+ * Thread is pinned to CPU with index of the shard when server
+ * runs several shards.
+ * @arg - pointer to an object of shard struct
+ */
+void* run_shard(void* arg) {
+  struct shard* shard = (struct shard*) arg;
+  struct sockaddr_in client;
+
+  /* Pin shard to its CPU */
+  if (shard->server->shards_amount > 1) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(shard->id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+
+  if (shard->server->reliable) {
+    run_reliable_shard(shard);
+    return NULL;
+  }
+
+  if (shard->server->batch_size > 1) {
+    run_batch_shard(shard);
+    return NULL;
+  }
+
+  /* Wait for data */
+  while (1) {
+    struct msgbuf* message = recv_message(shard, &client);
+    if (!message)
+      continue;
+
+    log_debug("SERVER: Received message from %s:%d: %s\n", inet_ntoa(client.sin_addr), ntohs(client.sin_port), message->data);
+    uint64_t start = metrics_now();
+    edit_message(message);
+    metrics_record(STAGE_TRANSFORM, start);
+    send_message(shard, &client, message);
+
+    msgbuf_free(message);
+  }
+
+  return NULL;
+}
+
+/*
+ * run_batch_shard - used to receive, edit and answer
+ * datagrams in batches. Each iteration costs one recvmmsg
+ * and one sendmmsg call and no allocations.
+ * @shard - pointer to an object of shard struct
+ */
+void run_batch_shard(struct shard* shard) {
+  while (1) {
+    int amount = recv_messages(shard);
+
+    uint64_t start = metrics_now();
+    edit_messages(shard, amount);
+    metrics_record(STAGE_TRANSFORM, start);
+    send_messages(shard, amount);
+
+    log_debug("SERVER: Shard %d answered %d datagram(s)\n", shard->id, amount);
+  }
+}
+
+/*
+ * recv_messages - used to receive batch of datagrams into
+ * preallocated buffers. Waits for first datagram only, then
+ * takes whatever else is already queued.
+ * @shard - pointer to an object of shard struct
+ *
+ * Return: amount of received datagrams
+ */
+int recv_messages(struct shard* shard) {
+  int amount;
+
+  /* Reset lengths changed by previous call */
+  for (int i = 0; i < shard->server->batch_size; i++)
+    shard->in_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+
+  do {
+    amount = recvmmsg(shard->sfd, shard->in_msgs, shard->server->batch_size, MSG_WAITFORONE, NULL);
+  } while (amount == -1 && errno == EINTR);
+
+  if (amount == -1)
+    print_error("recvmmsg");
+
+  metrics_add(METRIC_MESSAGES_IN, amount);
+  for (int i = 0; i < amount; i++)
+    metrics_add(METRIC_BYTES_IN, shard->in_msgs[i].msg_len);
+
+  shard->received += amount;
+
+  return amount;
+}
+
+/*
+ * edit_messages - used to add prefix "Server " to received
+ * datagrams. Reply gathers static prefix and received
+ * payload, so nothing is copied.
+ * @shard - pointer to an object of shard struct
+ * @amount - amount of received datagrams
+ */
+void edit_messages(struct shard* shard, int amount) {
+  for (int i = 0; i < amount; i++) {
+    shard->out_iovs[i * 2 + 1].iov_len = shard->in_msgs[i].msg_len;
+    shard->out_msgs[i].msg_hdr.msg_namelen = shard->in_msgs[i].msg_hdr.msg_namelen;
+  }
+}
+
+/*
+ * send_messages - used to send replies of the batch with
+ * as few sendmmsg calls as possible. Reply that can't be
+ * delivered is skipped, so one bad reply doesn't stop
+ * the shard.
+ * @shard - pointer to an object of shard struct
+ * @amount - amount of replies
+ */
+void send_messages(struct shard* shard, int amount) {
+  int sent = 0;
+
+  while (sent < amount) {
+    uint64_t start = metrics_now();
+    int result = sendmmsg(shard->sfd, shard->out_msgs + sent, amount - sent, 0);
+    metrics_record(STAGE_SEND, start);
+    if (result == -1) {
+      if (errno == EINTR)
+        continue;
+
+      /* Client is unreachable or reply is refused, drop it */
+      log_warn("SERVER: Reply to %s:%d dropped: %s\n", inet_ntoa(shard->addrs[sent].sin_addr),
+               ntohs(shard->addrs[sent].sin_port), strerror(errno));
+      sent++;
+      continue;
+    }
+
+    count_replies(shard, sent, result);
+    shard->sent += result;
+    sent += result;
+  }
+}
+
+/*
+ * count_replies - used to count sent replies and their
+ * bytes in metrics.
+ * @shard - pointer to an object of shard struct
+ * @first - index of first sent reply
+ * @amount - amount of sent replies
+ */
+void count_replies(struct shard* shard, int first, int amount) {
+  metrics_add(METRIC_MESSAGES_OUT, amount);
+  for (int i = first; i < first + amount; i++)
+    metrics_add(METRIC_BYTES_OUT, PREFIX_LEN + shard->out_iovs[i * 2 + 1].iov_len);
+}
+
+/*
+ * free_shard - used to free batch of the shard. Shard
+ * struct itself is owned by server.
+ * @shard - pointer to an object of shard struct
+ */
+void free_shard(struct shard* shard) {
+  free(shard->in_msgs);
+  free(shard->out_msgs);
+  free(shard->in_iovs);
+  free(shard->out_iovs);
+  free(shard->addrs);
+  free(shard->in_buffers);
+  free(shard->peers);
+}